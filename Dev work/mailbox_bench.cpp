@@ -0,0 +1,172 @@
+// Contention benchmark for LatestMailbox against a mutex-protected shared_ptr.
+//
+// g++ -O2 -std=c++17 -pthread -I../include -o mailbox_bench mailbox_bench.cpp
+// ./mailbox_bench [readers] [seconds] [frame_interval_us]
+//
+// One writer publishes a ref-counted frame every frame_interval_us (0 = as
+// fast as possible), the readers take the latest frame in a tight loop. The
+// number that matters is the writer's worst case: it stands in for the
+// streaming thread and must never wait on a reader.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "LatestMailbox.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Frame {
+    std::atomic<int> refs{1};
+    uint64_t id = 0;
+    unsigned char pixels[64];
+};
+
+static std::atomic<uint64_t> frames_freed{0};
+
+static void unref(Frame* frame) {
+    if (frame && frame->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete frame;
+        frames_freed.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+struct FrameTraits {
+    static Frame* acquire(Frame* frame) {
+        if (frame) frame->refs.fetch_add(1, std::memory_order_relaxed);
+        return frame;
+    }
+    static void release(Frame*& frame) {
+        unref(frame);
+        frame = nullptr;
+    }
+    static Frame* empty() { return nullptr; }
+};
+
+struct Latency {
+    std::vector<uint32_t> samples_ns;
+
+    void add(Clock::duration d) {
+        samples_ns.push_back((uint32_t)std::min<int64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(d).count(), UINT32_MAX));
+    }
+
+    void print(const char* label) {
+        if (samples_ns.empty()) {
+            printf("  %-22s no samples\n", label);
+            return;
+        }
+        std::sort(samples_ns.begin(), samples_ns.end());
+        auto at = [this](double q) { return samples_ns[(size_t)(q * (samples_ns.size() - 1))]; };
+        printf("  %-22s n=%-10zu p50 %6u ns  p99 %6u ns  p99.9 %7u ns  max %8u ns\n",
+               label, samples_ns.size(), at(0.5), at(0.99), at(0.999), samples_ns.back());
+    }
+};
+
+struct Result {
+    Latency publish;
+    Latency take;
+    uint64_t reads = 0;
+    uint64_t stale = 0; // reader saw an older frame than one it already had
+};
+
+template <typename Publish, typename Take>
+static Result run(int readers, double seconds, int interval_us, Publish publish, Take take) {
+    Result result;
+    std::atomic<bool> running{true};
+    std::vector<Result> per_reader(readers);
+    std::vector<std::thread> threads;
+
+    for (int r = 0; r < readers; ++r) {
+        threads.emplace_back([&, r]() {
+            Result& mine = per_reader[r];
+            uint64_t last = 0;
+            uint64_t n = 0;
+            while (running.load(std::memory_order_relaxed)) {
+                bool timed = (n++ % 64) == 0;
+                auto begin = timed ? Clock::now() : Clock::time_point();
+                Frame* frame = take();
+                if (timed) mine.take.add(Clock::now() - begin);
+                if (frame) {
+                    if (frame->id < last) mine.stale++;
+                    last = frame->id;
+                    mine.reads++;
+                    unref(frame);
+                }
+            }
+        });
+    }
+
+    auto end = Clock::now() + std::chrono::duration<double>(seconds);
+    uint64_t id = 0;
+    while (Clock::now() < end) {
+        Frame* frame = new Frame;
+        frame->id = ++id;
+        auto begin = Clock::now();
+        publish(frame);
+        result.publish.add(Clock::now() - begin);
+        unref(frame);
+        if (interval_us > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(interval_us));
+        }
+    }
+    running = false;
+    for (auto& t : threads) t.join();
+
+    for (auto& r : per_reader) {
+        result.take.samples_ns.insert(result.take.samples_ns.end(), r.take.samples_ns.begin(), r.take.samples_ns.end());
+        result.reads += r.reads;
+        result.stale += r.stale;
+    }
+    return result;
+}
+
+int main(int argc, char** argv) {
+    int readers = argc > 1 ? atoi(argv[1]) : 4;
+    double seconds = argc > 2 ? atof(argv[2]) : 3.0;
+    int interval_us = argc > 3 ? atoi(argv[3]) : 0;
+    printf("%d readers, %.1f s, frame every %d us, %u hardware threads\n",
+           readers, seconds, interval_us, std::thread::hardware_concurrency());
+
+    {
+        auto mailbox = std::make_unique<LatestMailbox<Frame*, 8, FrameTraits>>();
+        Result r = run(readers, seconds, interval_us,
+            [&](Frame* f) { mailbox->publish(f); },
+            [&]() -> Frame* {
+                Frame* f = nullptr;
+                uint64_t seq = 0;
+                return mailbox->take(f, seq) ? f : nullptr;
+            });
+        printf("LatestMailbox<8 slots>: %llu reads, %llu stale, %llu writer drops, %llu reader retries\n",
+               (unsigned long long)r.reads, (unsigned long long)r.stale,
+               (unsigned long long)mailbox->drops(), (unsigned long long)mailbox->reader_retries());
+        r.publish.print("publish (writer)");
+        r.take.print("take (reader)");
+    }
+
+    {
+        std::mutex mutex;
+        std::shared_ptr<Frame> latest;
+        auto deleter = [](Frame* f) { unref(f); };
+        Result r = run(readers, seconds, interval_us,
+            [&](Frame* f) {
+                std::shared_ptr<Frame> next(FrameTraits::acquire(f), deleter);
+                std::lock_guard<std::mutex> lock(mutex);
+                latest.swap(next);
+            },
+            [&]() -> Frame* {
+                std::lock_guard<std::mutex> lock(mutex);
+                return FrameTraits::acquire(latest.get());
+            });
+        printf("mutex + shared_ptr:     %llu reads, %llu stale\n",
+               (unsigned long long)r.reads, (unsigned long long)r.stale);
+        r.publish.print("publish (writer)");
+        r.take.print("take (reader)");
+    }
+    return 0;
+}
@@ -0,0 +1,67 @@
+#ifndef CAMERACAPS_H_
+#define CAMERACAPS_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct CameraIdentity {
+    uint16_t vendor_id = 0;
+    uint16_t product_id = 0;
+    uint16_t bcd_device = 0;    // firmware revision; a change forces a re-probe
+    std::string serial;
+    std::string card;
+    std::string bus_info;
+
+    bool same_device(const CameraIdentity& other) const;
+    std::string key() const;    // "VID-PID-serial"
+};
+
+struct CameraMode {
+    uint32_t fourcc = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<std::pair<uint32_t, uint32_t>> intervals;  // numerator/denominator, seconds per frame
+};
+
+struct CameraControl {
+    uint32_t id = 0;
+    uint32_t type = 0;
+    int32_t minimum = 0;
+    int32_t maximum = 0;
+    int32_t step = 1;
+    int32_t default_value = 0;
+    std::string name;
+};
+
+// Everything the app needs to know about a camera: formats, sizes, frame
+// intervals and controls. Probing a UVC camera is slow, so the result is cached
+// on disk keyed by USB VID:PID and serial and reused until the device changes.
+class CameraCapabilities {
+public:
+    CameraIdentity identity;
+    std::vector<CameraMode> modes;
+    std::vector<CameraControl> controls;
+
+    static CameraIdentity identify(const std::string& device);
+    static CameraCapabilities load_or_probe(const std::string& device);
+
+    bool probe(const std::string& device);
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+
+    // Best raw mode at this size (highest frame rate), nullptr if none.
+    const CameraMode* find_mode(uint32_t width, uint32_t height) const;
+    // Fully fixed caps string for a mode, e.g. video/x-raw,format=YUY2,...
+    // at its highest frame rate, or its lowest with lowest_rate.
+    static std::string caps_string(const CameraMode& mode, bool lowest_rate = false);
+    const CameraControl* find_control(uint32_t id) const;
+
+    // Per-user cache directory ($XDG_CACHE_HOME/mivo), created on first use
+    static std::string cache_dir();
+
+private:
+    static std::string cache_path(const CameraIdentity& identity);
+};
+
+#endif // CAMERACAPS_H_
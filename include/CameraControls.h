@@ -0,0 +1,30 @@
+#ifndef CAMERACONTROLS_H_
+#define CAMERACONTROLS_H_
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "CameraCaps.h"
+
+// V4L2 control access with a persistent file descriptor. Values are clamped
+// and snapped to the ranges recorded in the capability cache.
+class CameraControls {
+public:
+    CameraControls(const std::string& device, const CameraCapabilities& caps);
+    ~CameraControls();
+
+    bool set(uint32_t id, int32_t value);
+    bool get(uint32_t id, int32_t& value);
+    bool has(uint32_t id) const { return caps.find_control(id) != nullptr; }
+
+private:
+    bool open_device();
+
+    std::string device;
+    const CameraCapabilities& caps;
+    std::mutex mutex;
+    int fd = -1;
+};
+
+#endif // CAMERACONTROLS_H_
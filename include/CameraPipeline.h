@@ -0,0 +1,130 @@
+#ifndef CAMERAPIPELINE_H_
+#define CAMERAPIPELINE_H_
+
+#include <gst/gst.h>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Config.h"
+#include "CameraCaps.h"
+#include "CameraControls.h"
+#include "CaptureSource.h"
+#include "CaptureSweep.h"
+#include "EncoderTuner.h"
+#include "FlatField.h"
+#include "FrameIntegrity.h"
+#include "FrameMailbox.h"
+#include "HdrCapture.h"
+#include "Metrics.h"
+#include "MotionTrigger.h"
+#include "RawCapture.h"
+#include "Timelapse.h"
+#include "Recorder.h"
+#include "Watchdog.h"
+
+// Everything between the camera and the tee, and what hangs off the tee
+// without a screen: recording, raw capture, the frame mailbox, the watchdog.
+// No GTK here, so the same pipeline runs in the window and headless; the
+// window adds its display branch to tee() before start().
+//
+//   source_bin ! tee ! [recorder] [display branch, added by the window]
+class CameraPipeline {
+public:
+    explicit CameraPipeline(const AppConfig& config);
+    ~CameraPipeline();
+
+    CameraPipeline(const CameraPipeline&) = delete;
+    CameraPipeline& operator=(const CameraPipeline&) = delete;
+
+    bool valid() const { return pipeline && tee_element; }
+
+    // Goes to PLAYING, then starts recording, the watchdog and the sweep.
+    void start();
+    void play();
+    void pause();
+    // NULL and back to PLAYING, for property changes that need renegotiation;
+    // while_stopped runs in NULL. The recording and the timelapse are closed
+    // first and continue in new files.
+    void restart(const std::function<void()>& while_stopped = nullptr);
+    void change_resolution(int width, int height);
+
+    bool start_recording();
+    void stop_recording();
+    bool recording() const { return recorder_ && recorder_->recording(); }
+
+    // With a display branch the sink reports fps/latency; without one they
+    // are measured where frames enter the tee.
+    void set_measure_at_capture(bool enabled) { measure_at_capture = enabled; }
+
+    // Messages the pipeline doesn't handle itself. The sync hook runs on the
+    // posting thread; return GST_BUS_DROP if the message was consumed.
+    std::function<GstBusSyncReply(GstMessage*)> sync_hook;
+    std::function<void(GstMessage*)> message_hook;
+
+    GstElement* element() const { return pipeline; }
+    GstElement* tee() const { return tee_element; }
+    CameraSource& source() { return *camera_source; }
+    CameraControls& controls() { return *camera_controls; }
+    const CameraCapabilities& capabilities() const { return camera_caps; }
+    PipelineMetrics& metrics() { return metrics_; }
+    FrameIntegrity& integrity() { return integrity_; }
+    FrameMailbox& mailbox() { return *frame_mailbox; }
+    Recorder* recorder() { return recorder_.get(); }
+    Timelapse* timelapse() { return timelapse_.get(); }
+    FlatField* flat_field() { return flat_field_.get(); }
+    HdrCapture& hdr() { return *hdr_; }
+
+private:
+    void install_trace_probes();
+    void trace_element(GstElement* element);
+    const char* thread_role(GstElement* owner);
+    static GstBusSyncReply on_bus_sync(GstBus* bus, GstMessage* message, gpointer user_data);
+    static gboolean on_bus_message(GstBus* bus, GstMessage* message, gpointer user_data);
+    static GstPadProbeReturn on_capture_buffer(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+    static void on_element_added(GstBin* bin, GstBin* sub_bin, GstElement* element, gpointer user_data);
+    static GstPadProbeReturn on_trace_sink_pad(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+    static GstPadProbeReturn on_trace_src_pad(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+
+    AppConfig config;
+    CameraCapabilities camera_caps;
+    std::unique_ptr<CameraControls> camera_controls;
+    PipelineMetrics metrics_;
+    FrameIntegrity integrity_;
+
+    GstElement *pipeline = nullptr;
+    GstElement *tee_element = nullptr;   // splits capture into display and recording
+    guint bus_watch_id = 0;
+    std::atomic<bool> measure_at_capture{true};
+
+    CaptureOptions capture_options;
+    std::unique_ptr<CameraSource> camera_source;
+    std::unique_ptr<FrameMailbox> frame_mailbox; // latest full frame, for slow consumers
+    std::unique_ptr<RawCapture> raw_capture;
+    std::unique_ptr<Recorder> recorder_;
+    std::unique_ptr<EncoderTuner> encoder_tuner;
+    std::unique_ptr<MotionTrigger> motion_trigger;
+    std::unique_ptr<Timelapse> timelapse_;
+    std::unique_ptr<FlatField> flat_field_;
+    std::unique_ptr<HdrCapture> hdr_; // drives exposure controls, reads the mailbox
+    std::unique_ptr<CaptureSweep> capture_sweep;
+    std::unique_ptr<PipelineWatchdog> watchdog;
+
+    // Per-element buffer probes, only installed when tracing
+    struct TracePoint {
+        const char* element;
+        bool has_src = false;
+        bool span = false; // sink and src run on the same streaming thread
+        std::mutex lock;
+        std::deque<std::pair<GstClockTime, uint64_t>> begins; // by buffer PTS, oldest first
+    };
+    std::mutex trace_mutex;
+    std::vector<std::unique_ptr<TracePoint>> trace_points;
+};
+
+#endif // CAMERAPIPELINE_H_
@@ -0,0 +1,77 @@
+#ifndef CAPTURESOURCE_H_
+#define CAPTURESOURCE_H_
+
+#include <gst/gst.h>
+#include <cstdint>
+#include <string>
+
+// v4l2src io-mode values
+enum class IoMode {
+    Auto = 0,
+    Mmap = 2,
+    Userptr = 3,
+    DmabufImport = 5,
+};
+
+// Fault injection for the fake test source, e.g. "stall:3000:2000" (after 3 s,
+// stop delivering for 2 s), "error:3000" (after 3 s, fail with a flow error:
+// basesrc posts an ERROR and sends EOS) or "eos:3000" (after 3 s, end the
+// stream with EOS and no error, as an unplugged camera can).
+struct FaultPlan {
+    enum class Kind { None, Stall, Error, Eos } kind = Kind::None;
+    int after_ms = 0;
+    int duration_ms = 0;
+
+    static FaultPlan parse(const std::string& spec);
+};
+
+struct CaptureOptions {
+    std::string device = "/dev/video0";
+    IoMode io_mode = IoMode::Auto;
+    int buffers = 0;            // driver buffers to request, 0 = driver/pipeline default
+    bool fake = false;          // live videotestsrc instead of the camera
+    FaultPlan faults;           // only used by the fake source
+};
+
+IoMode parse_io_mode(const std::string& name);
+const char* io_mode_name(IoMode mode);
+
+// Applies the options to a v4l2src in NULL state. The buffer count is enforced
+// by raising the minimum in the downstream allocation answer, which is what
+// v4l2src sizes its driver queue from.
+void configure_capture_source(GstElement* source, const CaptureOptions& options);
+
+// The capture end of the pipeline (source ! capsfilter) wrapped in a bin with a
+// ghost src pad. The inner elements can be torn down and rebuilt while the
+// rest of the pipeline keeps running; probes on src_pad() survive a rebuild.
+class CameraSource {
+public:
+    explicit CameraSource(const CaptureOptions& options);
+    ~CameraSource();
+
+    GstElement* bin() const { return element; }
+    GstPad* src_pad() const { return ghost; }
+    GstElement* capture_element() const { return source; }
+
+    void set_caps(GstCaps* caps);
+    void set_options(const CaptureOptions& options);  // pipeline must be in NULL
+    bool rebuild();
+    bool owns(GstObject* object) const;
+
+private:
+    bool build();
+    static GstPadProbeReturn on_fake_buffer(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+
+    CaptureOptions options;
+    GstElement* element = nullptr;
+    GstElement* source = nullptr;
+    GstElement* capsfilter = nullptr;
+    GstPad* ghost = nullptr;
+    GstCaps* caps = nullptr;
+
+    // Fake source fault schedule, relative to the first buffer of each build
+    uint64_t fake_start_ns = 0;
+    bool fake_failed = false;
+};
+
+#endif // CAPTURESOURCE_H_
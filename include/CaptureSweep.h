@@ -0,0 +1,66 @@
+#ifndef CAPTURESWEEP_H_
+#define CAPTURESWEEP_H_
+
+#include <gst/gst.h>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "CaptureSource.h"
+#include "FrameIntegrity.h"
+#include "Metrics.h"
+
+// Runs the live pipeline once per io-mode / buffer-count combination, measures
+// capture-to-display latency and drop rate for each, then keeps the best one.
+// Driven from the GLib main loop so the UI stays responsive meanwhile.
+class CaptureSweep {
+public:
+    // Restarts the pipeline, running its argument while it is in NULL
+    using Restart = std::function<void(const std::function<void()>&)>;
+
+    CaptureSweep(Restart restart, CameraSource& source, const CaptureOptions& base,
+                 const PipelineMetrics& metrics, const FrameIntegrity& integrity, int seconds_per_setting);
+    ~CaptureSweep();
+
+    bool finished() const { return current >= results.size(); }
+
+private:
+    struct Result {
+        CaptureOptions options;
+        bool started = false;
+        uint64_t frames = 0;
+        uint64_t dropped = 0;
+        double latency_sum = 0;
+        int latency_samples = 0;
+
+        double drop_rate() const { return frames ? double(dropped) / (frames + dropped) : 1.0; }
+        double latency() const { return latency_samples ? latency_sum / latency_samples : 0; }
+    };
+
+    static constexpr int warmup_ms = 1000;
+    static constexpr int sample_ms = 250;
+
+    static gboolean on_tick(gpointer user_data);
+    bool tick();
+    void apply(const CaptureOptions& options);
+    void begin_measurement();
+    void report();
+
+    Restart restart;
+    CameraSource& source;
+    const PipelineMetrics& metrics;
+    const FrameIntegrity& integrity;
+    int seconds_per_setting;
+
+    std::vector<Result> results;
+    size_t current = 0;
+    bool measuring = false;
+    std::chrono::steady_clock::time_point phase_start;
+    uint64_t start_captured = 0;
+    uint64_t start_lost = 0;
+    uint64_t start_late = 0;
+    guint timer_id = 0;
+};
+
+#endif // CAPTURESWEEP_H_
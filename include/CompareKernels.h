@@ -0,0 +1,24 @@
+#ifndef COMPAREKERNELS_H_
+#define COMPAREKERNELS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// Image comparison kernels for the A/B reference view. SSE2 on x86-64, NEON
+// on ARM, scalar elsewhere; all give identical results.
+
+// Sum of (a - b)^2 over n bytes.
+uint64_t sum_squared_diff(const uint8_t* a, const uint8_t* b, size_t n);
+
+// PSNR in dB from a sum of squared differences over n samples; 99 when equal.
+double psnr_from_ssd(uint64_t ssd, size_t n);
+
+// Mean SSIM over the non-overlapping 8x8 blocks of two width x height
+// single-channel images (rows packed, stride = width). 1 = identical.
+double mean_ssim(const uint8_t* a, const uint8_t* b, int width, int height);
+
+// dst = min(255, |dst - ref| << gain_shift) per byte, for a row of BGRx
+// pixels; the fourth byte of each pixel is set to 0xFF (opaque).
+void diff_bgrx_row(uint8_t* dst, const uint8_t* ref, int pixels, int gain_shift);
+
+#endif // COMPAREKERNELS_H_
@@ -0,0 +1,91 @@
+#ifndef CONFIG_H_
+#define CONFIG_H_
+
+#include <string>
+
+// Runtime options, read from MIVO_* environment variables at startup.
+struct AppConfig {
+    std::string device = "/dev/video0"; // MIVO_DEVICE
+    std::string io_mode = "auto";   // MIVO_IO_MODE: auto, mmap, userptr or dmabuf-import
+    int capture_buffers = 0;        // MIVO_CAPTURE_BUFFERS: driver buffers, 0 = default
+    int capture_sweep_seconds = 0;  // MIVO_CAPTURE_SWEEP: measure every io-mode/buffer setting for N s each
+
+    int watchdog_stall_ms = 2000;   // MIVO_WATCHDOG_MS: rebuild the source after this long without frames, 0 = off
+    bool fake_source = false;       // MIVO_FAKE_SOURCE: live test pattern instead of the camera
+    std::string fake_faults;        // MIVO_FAKE_FAULTS: e.g. "stall:3000:2000", "error:3000" or "eos:3000"
+
+    std::string thread_cpus;        // MIVO_THREAD_CPUS: e.g. "capture=2,render=3,ui=0,keypad=1"
+    std::string thread_priorities;  // MIVO_THREAD_PRIO: e.g. "capture=fifo:50,render=nice:-5"
+    int thread_report_seconds = 0;  // MIVO_THREAD_REPORT: print per-thread CPU time every N s
+
+    bool headless = false;          // MIVO_HEADLESS or --headless: no window, keypad and socket only
+    std::string control_socket = "/tmp/mivo.sock"; // MIVO_CONTROL_SOCKET: headless command socket
+
+    bool display_scale = true;      // MIVO_DISPLAY_SCALE: scale the display branch to the window (0 = full-res path)
+    std::string display_mode = "balanced"; // MIVO_DISPLAY_MODE: low-latency, balanced or smooth
+
+    bool hud = false;               // MIVO_HUD: draw the stats overlay on the video
+    std::string scope = "off";      // MIVO_SCOPE: off, histogram or waveform, drawn by the HUD overlay
+    std::string exposure_warning = "off"; // MIVO_EXPOSURE_WARNING: off, zebra or false-colour
+    int scope_every = 3;            // MIVO_SCOPE_EVERY: analyse one frame in N
+    int zebra_percent = 95;         // MIVO_ZEBRA_LEVEL: stripe where any channel reaches this
+    int scope_threads = 2;          // MIVO_SCOPE_THREADS: workers besides the display thread
+    std::string reference_path;     // MIVO_REFERENCE: image the Compare view and score are against
+    std::string trace_path;         // MIVO_TRACE: write a Chrome trace JSON here on exit
+
+    std::string record_dir;         // MIVO_RECORD_DIR: record continuously into this directory
+    int segment_seconds = 60;       // MIVO_SEGMENT_SECONDS
+    int record_quota_mb = 2048;     // MIVO_RECORD_QUOTA_MB: disk budget for segments
+    int record_bitrate_kbps = 4000; // MIVO_RECORD_BITRATE
+    bool record_adaptive = true;    // MIVO_RECORD_ADAPTIVE: tune the encoder to the CPU load
+    int record_bitrate_min_kbps = 1000; // MIVO_RECORD_BITRATE_MIN
+    int record_bitrate_max_kbps = 8000; // MIVO_RECORD_BITRATE_MAX
+    int record_threads = 2;         // MIVO_RECORD_THREADS: starting x264 threads, 0 = automatic
+    int record_max_threads = 4;     // MIVO_RECORD_MAX_THREADS
+
+    std::string captures_dir = ".";  // MIVO_CAPTURES_DIR: snapshots shown in the gallery (with record_dir)
+    int gallery_cache_mb = 64;      // MIVO_GALLERY_CACHE_MB: decoded thumbnail budget
+
+    bool motion_record = false;     // MIVO_MOTION: record only while something moves (needs MIVO_RECORD_DIR)
+    int motion_threshold = 25;      // MIVO_MOTION_THRESHOLD: luma change per cell, 0-255
+    double motion_area = 0.5;       // MIVO_MOTION_AREA: percent of cells that must change
+    int motion_fps = 5;             // MIVO_MOTION_FPS: frames analysed per second
+    int motion_preroll = 3;         // MIVO_MOTION_PREROLL: seconds kept from before the motion
+    int motion_postroll = 5;        // MIVO_MOTION_POSTROLL: seconds recorded after it stops
+
+    int timelapse_seconds = 0;      // MIVO_TIMELAPSE: keep one frame every N s, 0 = off
+    std::string timelapse_dir = "timelapse"; // MIVO_TIMELAPSE_DIR
+    bool timelapse_images = false;  // MIVO_TIMELAPSE_IMAGES: JPEG sequence instead of a video
+    int timelapse_fps = 25;         // MIVO_TIMELAPSE_FPS: playback rate of the video
+
+    bool flat_field = false;        // MIVO_FLAT_FIELD: apply the stored flat-field (vignetting) map
+    int flat_threads = 2;           // MIVO_FLAT_THREADS: workers besides the streaming thread
+    int flat_frames = 16;           // MIVO_FLAT_FRAMES: frames averaged when calibrating
+    std::string flat_dir;           // MIVO_FLAT_DIR: where maps are kept, empty = camera cache directory
+
+    double lens_k1 = 0;             // MIVO_LENS_K1: radial distortion, < 0 for barrel; 0 and 0 = off
+    double lens_k2 = 0;             // MIVO_LENS_K2
+    int lens_threads = 2;           // MIVO_LENS_THREADS: workers besides the display thread
+
+    bool stabilize = false;         // MIVO_STABILIZE: steady the zoomed view within the zoom margin
+    double stabilize_smoothing = 0.9; // MIVO_STABILIZE_SMOOTHING: 0..1, higher holds the view stiller
+
+    double mosaic_scale = 0.5;      // MIVO_MOSAIC_SCALE: mosaic canvas pixels per frame pixel
+
+    int hdr_frames = 3;             // MIVO_HDR_FRAMES: exposures per HDR capture
+    double hdr_stops = 2;           // MIVO_HDR_STOPS: EV between them
+    int hdr_budget_ms = 2000;       // MIVO_HDR_BUDGET_MS: target time from command to file
+    int hdr_threads = 2;            // MIVO_HDR_THREADS: fusion workers besides the capture thread
+
+    std::string raw_capture_path;   // MIVO_RAW_CAPTURE: lossless frame store file
+    int raw_capture_frames = 300;   // MIVO_RAW_FRAMES: slots preallocated in the store
+
+    static AppConfig from_env();
+};
+
+bool env_bool(const char* name, bool fallback);
+int env_int(const char* name, int fallback);
+double env_double(const char* name, double fallback);
+std::string env_string(const char* name, const std::string& fallback);
+
+#endif // CONFIG_H_
@@ -0,0 +1,39 @@
+#ifndef CONTROLSOCKET_H_
+#define CONTROLSOCKET_H_
+
+#include <glib.h>
+#include <functional>
+#include <map>
+#include <string>
+
+// Line-based command socket (AF_UNIX, SOCK_STREAM) served from the GLib main
+// loop. Each line received is passed to the handler and its return value is
+// written back, newline-terminated:
+//
+//   echo status | socat - UNIX-CONNECT:/tmp/mivo.sock
+class ControlSocket {
+public:
+    using Handler = std::function<std::string(const std::string& command)>;
+
+    ControlSocket(const std::string& path, Handler handler);
+    ~ControlSocket();
+
+    bool listening() const { return listen_fd >= 0; }
+
+private:
+    static gboolean on_accept(gint fd, GIOCondition condition, gpointer user_data);
+    static gboolean on_client(gint fd, GIOCondition condition, gpointer user_data);
+    void close_client(int fd);
+
+    std::string path;
+    Handler handler;
+    int listen_fd = -1;
+    guint listen_source = 0;
+    struct Client {
+        guint source = 0;
+        std::string pending; // bytes after the last newline
+    };
+    std::map<int, Client> clients;
+};
+
+#endif // CONTROLSOCKET_H_
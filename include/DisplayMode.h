@@ -0,0 +1,32 @@
+#ifndef DISPLAYMODE_H_
+#define DISPLAYMODE_H_
+
+#include <gst/gst.h>
+#include <string>
+#include <vector>
+
+// Named trade-offs between latency and smooth pacing for the display branch.
+// A mode sets the display queue, the sink's clock sync and its QoS together,
+// because each only makes sense with the others:
+//
+//   low-latency  no clock sync, so no QoS either; the 1-buffer leaky queue
+//                drops whatever the sink hasn't taken: show the newest frame now
+//   balanced     clock sync with QoS dropping frames later than 20 ms
+//   smooth       clock sync, deeper queue, nothing dropped: even pacing
+struct DisplayMode {
+    const char* name;
+    bool sync;               // sink waits for each frame's running time
+    bool qos;                // sink reports lateness upstream and drops late frames (needs sync)
+    gint64 max_lateness_ns;  // -1 = render however late (needs sync)
+    guint queue_buffers;     // display queue depth
+    bool leaky;              // queue drops the oldest frame when full
+};
+
+const std::vector<DisplayMode>& display_modes();
+// Index into display_modes(), or -1.
+int find_display_mode(const std::string& name);
+
+// Safe while PLAYING; the properties are read per buffer.
+void apply_display_mode(const DisplayMode& mode, GstElement* queue, GstElement* sink);
+
+#endif // DISPLAYMODE_H_
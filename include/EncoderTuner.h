@@ -0,0 +1,55 @@
+#ifndef ENCODERTUNER_H_
+#define ENCODERTUNER_H_
+
+#include <glib.h>
+#include <chrono>
+#include <cstdint>
+
+#include "Metrics.h"
+#include "Recorder.h"
+
+struct EncoderBounds {
+    int min_bitrate_kbps = 1000;
+    int max_bitrate_kbps = 8000;
+    int fastest_preset = 1;     // ultrafast
+    int slowest_preset = 5;     // fast
+    int max_threads = 4;
+};
+
+// Periodically checks how well the recording encoder keeps up and adjusts
+// threads, speed preset and bitrate within the configured bounds. Display
+// drops always win: any sign of pressure makes the encoder cheaper, first by
+// bitrate (applied live), then by preset; threads are only added while the
+// machine has idle CPU, since under contention they make things worse.
+class EncoderTuner {
+public:
+    EncoderTuner(Recorder& recorder, const PipelineMetrics& metrics, const EncoderBounds& bounds);
+    ~EncoderTuner();
+
+private:
+    static constexpr int interval_seconds = 2;
+    static constexpr int calm_intervals_before_upgrade = 5;
+    static constexpr int restart_holdoff_seconds = 30;
+    static constexpr double idle_for_threads = 0.25; // of all CPUs, over the interval
+
+    static gboolean on_tick(gpointer user_data);
+    void evaluate();
+    bool can_restart() const;
+    double idle_fraction();
+    void restart_with(int preset, int threads, const char* reason);
+
+    Recorder& recorder;
+    const PipelineMetrics& metrics;
+    EncoderBounds bounds;
+    guint timer_id = 0;
+
+    uint64_t last_offered = 0;
+    uint64_t last_encoded = 0;
+    uint64_t last_display_dropped = 0;
+    int calm_intervals = 0;
+    uint64_t last_cpu_total = 0;
+    uint64_t last_cpu_idle = 0;
+    std::chrono::steady_clock::time_point last_restart;
+};
+
+#endif // ENCODERTUNER_H_
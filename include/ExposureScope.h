@@ -0,0 +1,82 @@
+#ifndef EXPOSURESCOPE_H_
+#define EXPOSURESCOPE_H_
+
+#include <cairomm/cairomm.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ScopeKernels.h"
+#include "ThreadPool.h"
+
+enum class ScopeView { Off, Histogram, Waveform };
+enum class ExposureWarning { Off, Zebra, FalseColour };
+
+struct ScopeSettings {
+    int every = 3;            // analyse one frame in this many
+    uint8_t zebra_level = 242; // any channel at or above this is striped (95%)
+    int threads = 2;          // workers besides the streaming thread
+};
+
+// Exposure feedback drawn by the HUD overlay, on the display frame itself.
+// Every Nth frame is analysed into an RGB/luma histogram or a waveform, with
+// the frame split into row bands that each fill their own partial counts
+// (merged afterwards, so the workers never share a counter); the result is
+// rendered into a small cached surface that every frame just blits. Zebra
+// stripes or false colour are painted into every frame, also in bands.
+class ExposureScope {
+public:
+    explicit ExposureScope(const ScopeSettings& settings);
+
+    void set_view(ScopeView view) { view_ = view; }
+    ScopeView view() const { return view_; }
+    void set_warning(ExposureWarning warning) { warning_ = warning; }
+    ExposureWarning warning() const { return warning_; }
+
+    static ScopeView parse_view(const std::string& name);
+    static ExposureWarning parse_warning(const std::string& name);
+    static const char* name(ScopeView view);
+    static const char* name(ExposureWarning warning);
+
+    // Streaming thread, from the HUD's buffer probe, before the HUD text.
+    // measure() analyses the frame as it arrived; anything that replaces
+    // pixels (the reference comparison) goes between it and draw(), which
+    // paints the warnings over the first live_width columns (-1: all) and
+    // then the scope.
+    void measure(cairo_t* cr);
+    void draw(cairo_t* cr, int live_width = -1);
+
+    // Average cost per displayed frame
+    double cost_ms() const { return average_ms.load(std::memory_order_relaxed); }
+
+private:
+    static cairo_surface_t* frame_surface(cairo_t* cr);
+    void analyse(const uint8_t* data, int stride, int width, int height, bool waveform);
+    void render_histogram();
+    void render_waveform();
+
+    static constexpr int scope_width = scope_waveform_width;
+    static constexpr int scope_height = 128;
+
+    ScopeSettings settings;
+    std::atomic<ScopeView> view_{ScopeView::Off};
+    std::atomic<ExposureWarning> warning_{ExposureWarning::Off};
+    std::atomic<double> average_ms{0};
+
+    // Streaming thread only
+    uint64_t frame_count = 0;
+    double measure_ms = 0;          // this frame's share spent in measure()
+    ScopeView rendered_view = ScopeView::Off;
+    std::vector<ScopeHistogram> partial_histograms; // one per band
+    std::vector<std::vector<uint32_t>> partial_waveforms;
+    ScopeHistogram histogram;
+    std::vector<uint32_t> waveform;
+    uint64_t samples = 0;
+    Cairo::RefPtr<Cairo::ImageSurface> surface;
+    uint32_t palette[256];
+
+    ThreadPool pool;
+};
+
+#endif // EXPOSURESCOPE_H_
@@ -0,0 +1,100 @@
+#ifndef FLATFIELD_H_
+#define FLATFIELD_H_
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FrameMailbox.h"
+#include "MotionKernels.h"
+#include "ThreadPool.h"
+
+// A flat-field map as stored on disk: one Q8.8 gain per step x step block.
+// Vignetting is smooth, so 1080p fits in ~64 KB; the per-pixel map is
+// interpolated from it when loaded.
+struct GainGrid {
+    int width = 0, height = 0;      // frame size it was calibrated at
+    int step = 8;
+    int columns = 0, rows = 0;
+    std::vector<uint16_t> gains;    // columns x rows, Q8.8
+
+    // From the mean luma of each block of an evenly lit, empty field: every
+    // block is scaled to the frame average, after a 3x3 blur against noise.
+    static GainGrid from_cells(const std::vector<float>& cells, int columns, int rows, int width, int height, int step);
+    // Bilinear, one gain per pixel (width x height)
+    std::vector<uint16_t> expand() const;
+
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+};
+
+struct FlatFieldSettings {
+    std::string directory;          // maps are stored here, one per resolution
+    std::string camera_key;         // and per camera
+    bool enabled = false;
+    int threads = 2;                // workers besides the streaming thread
+    int calibration_frames = 16;
+};
+
+// Flat-field (vignetting) correction in place on the capture pad, ahead of
+// the tee, so display, recording and snapshots all get the corrected frame.
+// Each frame is split into row bands across a small pool; the streaming
+// thread takes a band itself. Only luma is scaled (Planar, YUY2, UYVY).
+class FlatField {
+public:
+    FlatField(GstPad* capture_pad, FrameMailbox& mailbox, const FlatFieldSettings& settings);
+    ~FlatField();
+
+    void set_enabled(bool enabled);
+    bool enabled() const { return active.load(); }
+
+    // Averages the next calibration_frames uncorrected frames into a new map
+    // for the current resolution, saves it and starts using it. Runs on its
+    // own thread; false if a calibration is already running.
+    bool calibrate();
+    bool calibrating() const { return calibration_running.load(); }
+
+    double apply_ms() const { return last_apply_ms.load(std::memory_order_relaxed); }
+    uint64_t frames_copied() const { return copied_frames.load(std::memory_order_relaxed); }
+
+private:
+    struct PixelGains {
+        int width = 0, height = 0;
+        std::vector<uint16_t> gains;
+    };
+
+    std::string map_path(int width, int height) const;
+    void load_map(int width, int height);
+    void run_calibration();
+    void apply(GstVideoFrame* frame, const PixelGains& map);
+
+    static bool luma_layout(const GstVideoInfo* info, LumaLayout* layout);
+    static GstPadProbeReturn on_capture(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+
+    GstPad* capture_pad;
+    gulong probe_id = 0;
+    FrameMailbox& mailbox;
+    FlatFieldSettings settings;
+
+    std::atomic<bool> active{false};
+    std::atomic<bool> suspended{false};   // while calibrating
+    std::shared_ptr<const PixelGains> map; // std::atomic_load / atomic_store only
+    std::atomic<double> last_apply_ms{0};
+    std::atomic<uint64_t> copied_frames{0}; // buffers that were not ours to write
+
+    // Streaming thread only
+    GstVideoInfo video_info;
+    bool have_info = false;
+    LumaLayout layout = LumaLayout::Planar;
+
+    std::atomic<bool> calibration_running{false};
+    std::thread calibration;
+    ThreadPool pool;                    // last: workers stop before the rest goes
+};
+
+#endif // FLATFIELD_H_
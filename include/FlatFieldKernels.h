@@ -0,0 +1,18 @@
+#ifndef FLATFIELDKERNELS_H_
+#define FLATFIELDKERNELS_H_
+
+#include <cstdint>
+
+#include "MotionKernels.h"
+
+// Gains are unsigned Q8.8 (256 = 1.0) and must stay below 4.0 (1024), which
+// keeps every intermediate inside a signed 16-bit lane.
+static const uint16_t flat_gain_one = 256;
+static const uint16_t flat_gain_max = 1023;
+
+// Scales the luma samples of one row in place: y = min(255, y * gain >> 8),
+// one gain per pixel. Chroma is left alone. Planar, YUYV and UYVY only.
+// SSE2 on x86-64, NEON on ARM, scalar elsewhere; all give identical results.
+void apply_gain_row(uint8_t* row, const uint16_t* gain, int width, LumaLayout layout);
+
+#endif // FLATFIELDKERNELS_H_
@@ -0,0 +1,15 @@
+#ifndef FRAMECONVERT_H_
+#define FRAMECONVERT_H_
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <opencv2/core.hpp>
+
+// Packed RGB copy of a mapped raw frame: YUY2, UYVY, NV12, I420, GRAY8 and
+// the 3/4-byte RGB family. False for other formats.
+bool frame_to_rgb(const GstVideoFrame& frame, cv::Mat& rgb);
+
+// Same for a sample from the mailbox; MJPEG samples are decoded.
+bool sample_to_rgb(GstSample* sample, cv::Mat& rgb);
+
+#endif // FRAMECONVERT_H_
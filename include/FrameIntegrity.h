@@ -0,0 +1,42 @@
+#ifndef FRAMEINTEGRITY_H_
+#define FRAMEINTEGRITY_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Tracks v4l2 frame sequence numbers and timestamps at two points: where
+// buffers leave the capture source and where they reach the display. Frames
+// missing at the source were lost by the camera/driver ("sensor" drops);
+// frames captured but never displayed were dropped inside the pipeline.
+class FrameIntegrity {
+public:
+    // Capture thread, once per buffer. Timestamps in ns, 0 if unknown.
+    void on_capture(uint64_t sequence, uint64_t timestamp_ns);
+    // Display thread, once per buffer, with the same sequence number.
+    void on_display(uint64_t sequence);
+
+    std::atomic<uint64_t> captured{0};
+    std::atomic<uint64_t> sensor_drops{0};      // gaps in sequence or timestamps at the source
+    std::atomic<uint64_t> duplicates{0};        // repeated sequence or timestamp
+    std::atomic<uint64_t> pipeline_drops{0};    // captured but never displayed
+    std::atomic<uint64_t> displayed{0};
+
+private:
+    static constexpr size_t history = 1024;
+
+    // Sequence numbers recently seen at the source, indexed by sequence % history
+    std::atomic<uint64_t> seen[history] = {};
+
+    // Capture-thread state
+    bool have_capture = false;
+    uint64_t last_sequence = 0;
+    uint64_t last_timestamp = 0;
+    double frame_interval_ns = 0;
+
+    // Display-thread state
+    bool have_display = false;
+    uint64_t last_displayed = 0;
+};
+
+#endif // FRAMEINTEGRITY_H_
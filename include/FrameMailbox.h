@@ -0,0 +1,67 @@
+#ifndef FRAMEMAILBOX_H_
+#define FRAMEMAILBOX_H_
+
+#include <gst/gst.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+#include "LatestMailbox.h"
+
+template <>
+struct MailboxTraits<GstSample*> {
+    static GstSample* acquire(GstSample* sample) { return sample ? gst_sample_ref(sample) : nullptr; }
+    static void release(GstSample*& sample) {
+        if (sample) {
+            gst_sample_unref(sample);
+            sample = nullptr;
+        }
+    }
+    static GstSample* empty() { return nullptr; }
+};
+
+// Latest frame of the live pipeline for consumers that can't keep up with it
+// (thumbnails, analysers, UI). A pad probe publishes every buffer with its
+// caps; readers take a reference to whatever is newest and never block the
+// streaming thread.
+class FrameMailbox {
+public:
+    // Room for up to six readers taking at the same moment
+    using Mailbox = LatestMailbox<GstSample*, 8>;
+
+    explicit FrameMailbox(GstPad* pad);
+    ~FrameMailbox();
+
+    // New reference to the newest frame after *sequence (nullptr if none);
+    // *sequence is advanced to it. Release with gst_sample_unref.
+    GstSample* take(uint64_t* sequence = nullptr);
+    // take(), but blocks up to timeout_ms for a frame newer than *sequence.
+    // The streaming thread only signals while someone is waiting.
+    GstSample* wait(uint64_t* sequence, int timeout_ms);
+
+    uint64_t frames() const { return mailbox.sequence(); }
+    uint64_t drops() const { return mailbox.drops(); }
+
+    // Set while the camera's exposure is being stepped (HDR bracket) and until
+    // it has settled back. Analysers that compare frames over time (motion,
+    // stabilization, mosaic) skip frames while disturbed() and start their
+    // reference over; *seen is the caller's count of brackets already seen.
+    void set_bracketing(bool on);
+    bool disturbed(uint64_t* seen) const;
+
+private:
+    static GstPadProbeReturn on_data(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+
+    GstPad* pad;
+    gulong probe_id = 0;
+    GstCaps* caps = nullptr; // streaming thread only
+    Mailbox mailbox;
+    std::mutex wait_mutex;
+    std::condition_variable arrived;
+    std::atomic<int> waiters{0};
+    std::atomic<bool> bracketing{false};
+    std::atomic<uint64_t> brackets{0};
+};
+
+#endif // FRAMEMAILBOX_H_
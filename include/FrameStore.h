@@ -0,0 +1,142 @@
+#ifndef FRAMESTORE_H_
+#define FRAMESTORE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Lossless frame container, laid out for memory mapping:
+//
+//   [header, 4 KiB][index: capacity x IndexEntry][slots: capacity x slot_size]
+//
+// Slots are fixed-size and page aligned, so frame i lives at a known offset and
+// both writing and random-access reading are O(1).
+namespace framestore {
+
+constexpr uint64_t magic = 0x314d5246'4f56494dull; // "MIVOFRM1"
+constexpr uint32_t version = 1;
+constexpr size_t header_size = 4096;
+constexpr size_t alignment = 4096;
+
+struct Header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t fourcc;
+    uint64_t slot_size;
+    uint64_t capacity;
+    uint64_t frame_count;       // published after the frame's index entry
+    uint64_t index_offset;
+    uint64_t data_offset;
+    uint64_t dropped_queue_full;
+    uint64_t dropped_store_full;
+};
+
+struct IndexEntry {
+    uint64_t timestamp_ns;
+    uint64_t sequence;
+    uint32_t fourcc;
+    uint32_t size;
+    uint64_t offset;
+};
+
+static_assert(sizeof(Header) <= header_size, "header must fit its page");
+static_assert(sizeof(IndexEntry) == 32, "index entries are packed to 32 bytes");
+
+} // namespace framestore
+
+// Appends frames from the streaming thread without touching the disk there:
+// submit() only queues a reference, a writer thread copies into the mapping
+// in batches and flushes them asynchronously.
+//
+// A store holds one frame format. When the size or format changes, the file
+// is closed and the frames continue in <stem>_1<ext>, <stem>_2<ext>, ...,
+// each with slots sized for its own frames.
+class FrameStoreWriter {
+public:
+    struct Frame {
+        const uint8_t* data;
+        size_t size;
+        uint32_t width;
+        uint32_t height;
+        uint32_t fourcc;
+        uint64_t timestamp_ns;
+        uint64_t sequence;
+        std::function<void()> release;  // called once the bytes have been copied
+    };
+
+    FrameStoreWriter(const std::string& path, uint64_t capacity, size_t queue_depth = 8);
+    ~FrameStoreWriter();
+
+    bool submit(Frame&& frame);         // never blocks on I/O; false if dropped
+    void close();
+
+    uint64_t frames_written() const { return written; }
+    uint64_t frames_dropped() const { return dropped_queue_full + dropped_store_full; }
+
+private:
+    static constexpr size_t batch_size = 4;
+
+    void run();
+    bool create(const Frame& first);
+    void finish();
+    bool fits(const Frame& frame) const;
+    std::string part_path() const;
+    void store(Frame& frame);
+    void flush(uint64_t first_frame, uint64_t count);
+
+    std::string path;
+    uint64_t capacity;
+    size_t queue_depth;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Frame> queue;
+    bool closing = false;
+    std::thread worker;
+
+    int fd = -1;
+    uint8_t* map = nullptr;
+    size_t map_size = 0;
+    framestore::Header* header = nullptr;
+    unsigned part = 0;                  // files started after a format change
+    uint64_t count = 0;                 // frames in the current file
+    std::atomic<uint64_t> written{0};   // over all files
+    std::atomic<uint64_t> dropped_queue_full{0};
+    std::atomic<uint64_t> dropped_store_full{0};
+};
+
+// Read-only, random access view of a frame store.
+class FrameStoreReader {
+public:
+    struct FrameRef {
+        const uint8_t* data;
+        size_t size;
+        uint32_t fourcc;
+        uint64_t timestamp_ns;
+        uint64_t sequence;
+    };
+
+    explicit FrameStoreReader(const std::string& path);   // throws std::runtime_error
+    ~FrameStoreReader();
+    FrameStoreReader(const FrameStoreReader&) = delete;
+    FrameStoreReader& operator=(const FrameStoreReader&) = delete;
+
+    const framestore::Header& info() const { return *header; }
+    uint64_t size() const;                 // never more than the capacity
+    FrameRef frame(uint64_t i) const;      // throws std::out_of_range, or std::runtime_error if corrupt
+
+private:
+    int fd = -1;
+    const uint8_t* map = nullptr;
+    size_t map_size = 0;
+    const framestore::Header* header = nullptr;
+};
+
+#endif // FRAMESTORE_H_
@@ -0,0 +1,80 @@
+#ifndef GALLERYWINDOW_H_
+#define GALLERYWINDOW_H_
+
+#include <gtkmm.h>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "LruCache.h"
+#include "Thumbnail.h"
+#include "ThreadPool.h"
+
+// Browser for snapshots and recordings. The listing is cheap (names and
+// mtimes); thumbnails are decoded on a worker pool only for the items on
+// screen and kept in a byte-bounded LRU cache, so thousands of captures
+// scroll without stalling the UI or growing without limit.
+class GalleryWindow : public Gtk::Window {
+public:
+    GalleryWindow(const std::vector<std::string>& directories, std::size_t cache_bytes);
+    ~GalleryWindow() override;
+
+    // Re-scan the directories, newest first.
+    void refresh();
+
+private:
+    struct Columns : public Gtk::TreeModel::ColumnRecord {
+        Gtk::TreeModelColumn<Glib::RefPtr<Gdk::Pixbuf>> thumbnail;
+        Gtk::TreeModelColumn<Glib::ustring> name;
+        Gtk::TreeModelColumn<std::string> path;
+        Columns() { add(thumbnail); add(name); add(path); }
+    };
+
+    struct Decoded {
+        std::string path;
+        bool skipped; // scrolled out of view before it started
+        bool ok;
+        Thumbnail thumbnail;
+    };
+
+    void request_visible();
+    void on_decoded();
+    void on_evicted(const std::string& path);
+    void on_item_activated(const Gtk::TreeModel::Path& path);
+    void set_row_thumbnail(const std::string& path, const Glib::RefPtr<Gdk::Pixbuf>& pixbuf);
+
+    static constexpr int thumb_size = 160;
+
+    std::vector<std::string> directories;
+    Columns columns;
+    Glib::RefPtr<Gtk::ListStore> store;
+    Gtk::ScrolledWindow scroller;
+    Gtk::IconView icons;
+    Glib::RefPtr<Gdk::Pixbuf> placeholder;
+    std::map<std::string, Gtk::TreeModel::iterator> rows;
+
+    LruCache<std::string, Glib::RefPtr<Gdk::Pixbuf>> cache;  // UI thread only
+    std::set<std::string> in_flight;                          // UI thread only
+    std::set<std::string> failed;                             // UI thread only, until the next refresh
+    std::map<std::string, std::pair<time_t, off_t>> scanned;  // mtime and size at the last refresh
+
+    // Bumped whenever the visible range moves; queued decodes for an older
+    // generation that have scrolled out of view are skipped
+    std::atomic<uint64_t> generation{0};
+    std::mutex visible_mutex;
+    std::set<std::string> visible;
+
+    Glib::Dispatcher decoded_signal;
+    std::mutex decoded_mutex;
+    std::vector<Decoded> decoded;
+
+    // Last, so the workers are joined before anything they touch goes away
+    ThreadPool pool;
+};
+
+#endif // GALLERYWINDOW_H_
@@ -0,0 +1,65 @@
+#ifndef HDRCAPTURE_H_
+#define HDRCAPTURE_H_
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "CameraControls.h"
+#include "FrameMailbox.h"
+#include "ThreadPool.h"
+
+struct HdrSettings {
+    std::string directory = "captures";
+    int frames = 3;         // exposures in the bracket, centred on the current one
+    double stops = 2;       // EV between neighbouring exposures
+    int settle_frames = 3;  // frames skipped after each exposure change (UVC applies it late)
+    int budget_ms = 2000;   // bracket + align + fuse; fusion resolution drops to fit
+    int threads = 2;        // fusion workers besides the capture thread
+};
+
+// Still capture with extended dynamic range for specular highlights. On its
+// own thread: switches the camera to manual exposure, steps the exposure
+// time through the bracket, takes a settled frame from the mailbox at each
+// step and restores the previous exposure, so the live view only sees a
+// brief flicker. The frames are aligned (median threshold bitmaps, which
+// don't care about exposure) and fused with Mertens exposure fusion, the
+// per-exposure weight maps and pyramids built in parallel on the pool. No
+// radiance map or tone curve is needed. The fusion cost per megapixel is
+// remembered so the next capture can be fused at a lower resolution if the
+// full one would overrun the budget.
+class HdrCapture {
+public:
+    HdrCapture(CameraControls& controls, FrameMailbox& mailbox, const HdrSettings& settings);
+    ~HdrCapture();
+
+    HdrCapture(const HdrCapture&) = delete;
+    HdrCapture& operator=(const HdrCapture&) = delete;
+
+    // Starts a capture written to <directory>/hdr_<time>.jpg; false if one is
+    // already running.
+    bool capture();
+    bool busy() const { return running.load(); }
+
+private:
+    void run();
+    bool bracket(std::vector<cv::Mat>& frames);
+    bool take_settled(cv::Mat& rgb);
+    cv::Mat fuse(const std::vector<cv::Mat>& images);
+
+    CameraControls& controls;
+    FrameMailbox& mailbox;
+    HdrSettings settings;
+
+    std::atomic<bool> running{false};
+    std::atomic<bool> aborting{false};
+    double fuse_ms_per_megapixel = 0; // capture thread only; 0 until measured
+
+    ThreadPool pool;
+    std::thread worker;
+};
+
+#endif // HDRCAPTURE_H_
@@ -0,0 +1,53 @@
+#ifndef HEADLESSSTATION_H_
+#define HEADLESSSTATION_H_
+
+#include <glib.h>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "CameraPipeline.h"
+#include "Config.h"
+#include "ControlSocket.h"
+#include "KeyPad.h"
+#include "Mosaic.h"
+#include "ReferenceCompare.h"
+#include "ThreadPool.h"
+
+// Recording-only station: the capture/record/analysis pipeline without GTK,
+// a window or a video sink, driven from the keypad and a control socket.
+//
+// Keypad: 1 = start/stop recording, 2 = pause/play, 3 = snapshot, 4 = status.
+// Socket commands: status, record start|stop, snapshot, pause, play,
+// flat on|off|calibrate, mosaic start|stop, hdr, compare <image>|off, quit.
+class HeadlessStation {
+public:
+    explicit HeadlessStation(const AppConfig& config);
+    ~HeadlessStation();
+
+    // Runs until "quit", SIGINT or SIGTERM. Returns the process exit code.
+    int run();
+
+private:
+    std::string handle_command(const std::string& command);
+    void handle_button_press(int button);
+    std::string snapshot();
+    std::string stop_mosaic();
+    std::string status();
+    void init_keypad();
+    static gboolean on_quit_signal(gpointer user_data);
+
+    AppConfig config;
+    GMainLoop *loop = nullptr;
+    std::unique_ptr<CameraPipeline> camera;
+    std::unique_ptr<ControlSocket> control;
+    FT232HHandler *keypad = nullptr;
+    std::thread keypad_init_thread;
+    bool paused = false;
+    std::unique_ptr<Mosaic> mosaic; // between "mosaic start" and "mosaic stop"
+    std::unique_ptr<ReferenceCompare> compare; // scores only, nothing is displayed
+
+    ThreadPool snapshots{1, "snapshot"}; // JPEG encodes stay off the main loop
+};
+
+#endif // HEADLESSSTATION_H_
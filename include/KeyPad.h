@@ -19,6 +19,7 @@ public:
     std::atomic<bool> running;
     std::thread gpio_thread;
     std::function<void(int)> callback;
+    std::function<void()> thread_init; // runs first thing on gpio_thread
 
 
 
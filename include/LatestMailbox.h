@@ -0,0 +1,126 @@
+#ifndef LATESTMAILBOX_H_
+#define LATESTMAILBOX_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Reference handling for values held in a LatestMailbox. Specialise for
+// ref-counted handles (GstSample*, GstBuffer*, ...); the default copies.
+template <typename T>
+struct MailboxTraits {
+    static T acquire(const T& value) { return value; }
+    static void release(T&) {}
+    static T empty() { return T(); }
+};
+
+// Single-writer, multi-reader "latest value" slot.
+//
+// The writer never waits: it fills a slot that is neither the published one
+// nor pinned by a reader, then publishes it with one atomic store. Readers
+// pin the published slot with a counter, take their own reference and unpin,
+// so they never hold anything the writer needs. With Slots >= readers + 2 a
+// free slot always exists; if not (more concurrent readers than that), the
+// value is dropped and counted rather than waited for.
+//
+// Superseded values are released on the next publish unless a reader has
+// their slot pinned at that moment, so only the latest value stays held
+// (for GstSample that is a camera buffer kept from the driver's pool).
+template <typename T, std::size_t Slots = 4, typename Traits = MailboxTraits<T>>
+class LatestMailbox {
+    static_assert(Slots >= 3, "need at least three slots");
+
+public:
+    LatestMailbox() {
+        for (auto& slot : slots) {
+            slot.value = Traits::empty();
+        }
+    }
+
+    ~LatestMailbox() {
+        for (auto& slot : slots) {
+            Traits::release(slot.value);
+        }
+    }
+
+    LatestMailbox(const LatestMailbox&) = delete;
+    LatestMailbox& operator=(const LatestMailbox&) = delete;
+
+    // Writer side. Takes its own reference to value.
+    bool publish(const T& value) {
+        std::size_t current = latest.load(std::memory_order_relaxed);
+        for (std::size_t i = 1; i < Slots; ++i) {
+            std::size_t index = (current + i) % Slots;
+            Slot& slot = slots[index];
+            if (slot.readers.load(std::memory_order_seq_cst) != 0) {
+                continue;
+            }
+            // Not published and unpinned: a reader that pins it from here on
+            // sees latest != index on its recheck and backs off.
+            Traits::release(slot.value);
+            slot.value = Traits::acquire(value);
+            slot.sequence = next_sequence;
+            latest.store(index, std::memory_order_seq_cst);
+            published.store(next_sequence, std::memory_order_release);
+            ++next_sequence;
+            // A reader pinning one of these from here on sees latest moved on
+            // and backs off without touching the value
+            for (std::size_t other = 0; other < Slots; ++other) {
+                if (other != index && slots[other].readers.load(std::memory_order_seq_cst) == 0) {
+                    Traits::release(slots[other].value);
+                }
+            }
+            return true;
+        }
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Reader side. Returns a new reference to the latest value (caller
+    // releases it) and its sequence number, or false if nothing newer than
+    // after_sequence has been published.
+    bool take(T& out, uint64_t& sequence, uint64_t after_sequence = 0) {
+        if (published.load(std::memory_order_acquire) <= after_sequence) {
+            return false;
+        }
+        for (;;) {
+            std::size_t index = latest.load(std::memory_order_seq_cst);
+            Slot& slot = slots[index];
+            slot.readers.fetch_add(1, std::memory_order_seq_cst);
+            if (latest.load(std::memory_order_seq_cst) != index) {
+                // Recycled between load and pin; try the new one
+                slot.readers.fetch_sub(1, std::memory_order_release);
+                retries.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            bool newer = slot.sequence > after_sequence;
+            if (newer) {
+                out = Traits::acquire(slot.value);
+                sequence = slot.sequence;
+            }
+            slot.readers.fetch_sub(1, std::memory_order_release);
+            return newer;
+        }
+    }
+
+    uint64_t sequence() const { return published.load(std::memory_order_acquire); }
+    uint64_t drops() const { return dropped.load(std::memory_order_relaxed); }
+    uint64_t reader_retries() const { return retries.load(std::memory_order_relaxed); }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint32_t> readers{0};
+        uint64_t sequence = 0;
+        T value;
+    };
+
+    std::array<Slot, Slots> slots;
+    alignas(64) std::atomic<std::size_t> latest{0};
+    std::atomic<uint64_t> published{0};
+    uint64_t next_sequence = 1; // writer only
+    alignas(64) std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> retries{0};
+};
+
+#endif // LATESTMAILBOX_H_
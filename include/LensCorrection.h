@@ -0,0 +1,60 @@
+#ifndef LENSCORRECTION_H_
+#define LENSCORRECTION_H_
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "LensRemap.h"
+#include "LruCache.h"
+#include "ThreadPool.h"
+
+// Undistortion for the display branch. A probe on the pad ahead of videocrop
+// replaces each frame with a remapped one from a buffer pool; the zoom crop is
+// part of the remap table, so videocrop stays at zero and the frame is
+// resampled once, at capture size, and scaled on the GPU by the sink.
+//
+// Tables are built once per resolution, zoom and lens model, kept on disk
+// (they load several times faster than they are computed) and the recent
+// ones in memory, so cycling the zoom doesn't rebuild them.
+class LensCorrection {
+public:
+    LensCorrection(GstPad* pad, const LensModel& lens, const std::string& cache_dir, int threads);
+    ~LensCorrection();
+
+    // From the UI thread; the table switches on the next frame.
+    void set_crop(const ViewCrop& crop);
+    double remap_ms() const { return last_remap_ms.load(std::memory_order_relaxed); }
+
+private:
+    bool prepare(const GstVideoInfo& info);
+    std::shared_ptr<const RemapTable> table_for(int width, int height, const ViewCrop& crop);
+    void remap(const GstVideoFrame* in, GstVideoFrame* out, const RemapTable& table);
+
+    static GstPadProbeReturn on_data(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+
+    GstPad* pad;
+    gulong probe_id = 0;
+    LensModel lens;
+    std::string cache_dir;
+
+    std::mutex crop_mutex;
+    ViewCrop crop;
+    std::atomic<bool> crop_changed{true};
+    std::atomic<double> last_remap_ms{0};
+
+    // Streaming thread only
+    GstVideoInfo video_info;
+    bool have_info = false;
+    bool warned_format = false;
+    GstBufferPool* buffer_pool = nullptr;
+    std::shared_ptr<const RemapTable> table;
+    LruCache<std::string, std::shared_ptr<const RemapTable>> tables{64u << 20};
+
+    ThreadPool pool;                    // last: workers stop before the rest goes
+};
+
+#endif // LENSCORRECTION_H_
@@ -0,0 +1,64 @@
+#ifndef LENSREMAP_H_
+#define LENSREMAP_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Radial (Brown) lens model on coordinates normalised to the half-diagonal:
+// distorted = undistorted * (1 + k1 r^2 + k2 r^4). Barrel distortion has
+// k1 < 0.
+struct LensModel {
+    double k1 = 0;
+    double k2 = 0;
+
+    bool identity() const { return k1 == 0 && k2 == 0; }
+};
+
+// The zoom crop, in source pixels from each edge (as videocrop takes it)
+struct ViewCrop {
+    int left = 0, top = 0, right = 0, bottom = 0;
+};
+
+// For every output pixel, where to sample the source: x and y interleaved as
+// unsigned Q12.4 (1/16 pixel, frames up to 4095 wide), 4 bytes per pixel.
+// The zoom crop and the undistortion are folded into one table, so each
+// displayed pixel is resampled once.
+struct RemapTable {
+    static const uint32_t outside = 0xFFFFFFFFu; // sample falls off the frame
+
+    int width = 0, height = 0;      // source size, and output size
+    ViewCrop crop;
+    LensModel lens;
+    std::vector<uint32_t> entries;  // width x height, x in the low half
+
+    // The output keeps the frame's shape: the crop is widened on one axis if
+    // needed so the picture is never stretched.
+    static RemapTable build(int width, int height, const ViewCrop& crop, const LensModel& lens);
+    bool matches(int width, int height, const ViewCrop& crop, const LensModel& lens) const;
+
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+};
+
+// A rectangle of output to fill, [x0, x1) x [y0, y1). Tiles of a few dozen
+// rows keep the matching source region in cache.
+struct RemapTile {
+    int x0, y0, x1, y1;
+};
+
+// 8-bit single-channel plane at table resolution, bilinear
+void remap_plane(const RemapTable& table, const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride,
+                 const RemapTile& tile, uint8_t fill);
+
+// Packed 4:2:2 (YUY2, UYVY, ...): luma bilinear, chroma pairs nearest.
+// luma_offset is 0 for YUY2 and 1 for UYVY.
+void remap_packed422(const RemapTable& table, const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride,
+                     const RemapTile& tile, int luma_offset);
+
+// Subsampled plane (4:2:0 chroma; pixel_bytes 2 for NV12's UV pairs), nearest
+// sample taken from the table entry of the pixel's top-left luma position.
+void remap_chroma(const RemapTable& table, const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride,
+                  const RemapTile& tile, int pixel_bytes, uint8_t fill);
+
+#endif // LENSREMAP_H_
@@ -0,0 +1,96 @@
+#ifndef LRUCACHE_H_
+#define LRUCACHE_H_
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+// Least-recently-used map bounded by a byte budget rather than an entry
+// count, so a few large entries can't blow the memory limit. Not thread-safe:
+// keep it on one thread.
+template <typename Key, typename Value>
+class LruCache {
+public:
+    using EvictFn = std::function<void(const Key&)>;
+
+    explicit LruCache(std::size_t budget_bytes) : budget(budget_bytes) {}
+
+    void set_evict_callback(EvictFn fn) { on_evict = std::move(fn); }
+
+    // Returns nullptr on a miss; a hit becomes the most recent entry.
+    Value* get(const Key& key) {
+        auto it = index.find(key);
+        if (it == index.end()) {
+            return nullptr;
+        }
+        entries.splice(entries.begin(), entries, it->second);
+        return &it->second->value;
+    }
+
+    bool contains(const Key& key) const { return index.count(key) != 0; }
+
+    void put(const Key& key, Value value, std::size_t bytes) {
+        auto it = index.find(key);
+        if (it != index.end()) {
+            used -= it->second->bytes;
+            entries.erase(it->second);
+            index.erase(it);
+        }
+        entries.push_front({key, std::move(value), bytes});
+        index[key] = entries.begin();
+        used += bytes;
+        trim();
+    }
+
+    // Drops an entry without calling the evict callback
+    bool erase(const Key& key) {
+        auto it = index.find(key);
+        if (it == index.end()) {
+            return false;
+        }
+        used -= it->second->bytes;
+        entries.erase(it->second);
+        index.erase(it);
+        return true;
+    }
+
+    void clear() {
+        entries.clear();
+        index.clear();
+        used = 0;
+    }
+
+    std::size_t bytes() const { return used; }
+    std::size_t size() const { return index.size(); }
+
+private:
+    struct Entry {
+        Key key;
+        Value value;
+        std::size_t bytes;
+    };
+
+    void trim() {
+        // The newest entry is kept even if it alone exceeds the budget
+        while (used > budget && entries.size() > 1) {
+            Entry& oldest = entries.back();
+            used -= oldest.bytes;
+            Key key = oldest.key;
+            index.erase(key);
+            entries.pop_back();
+            if (on_evict) {
+                on_evict(key);
+            }
+        }
+    }
+
+    std::size_t budget;
+    std::size_t used = 0;
+    std::list<Entry> entries; // most recent first
+    std::unordered_map<Key, typename std::list<Entry>::iterator> index;
+    EvictFn on_evict;
+};
+
+#endif // LRUCACHE_H_
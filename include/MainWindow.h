@@ -4,6 +4,7 @@
 #include <gtkmm.h>
 #include <cairomm/cairomm.h>
 #include <mutex>
+#include <condition_variable>
 #include <thread>
 #include <opencv2/opencv.hpp>
 #include <iostream>
@@ -12,6 +13,7 @@
 #include <gdk/gdkx.h> // For GDK_WINDOW_XID
 #endif
 #include <gst/gst.h>
+#include <gst/video/video.h>
 #include <gst/video/videooverlay.h>
 
 #include <linux/videodev2.h>
@@ -19,6 +21,21 @@
 #include <sys/ioctl.h>
 
 #include"KeyPad.h"
+#include "StartupProfiler.h"
+#include "Config.h"
+#include "StatsOverlay.h"
+#include "ExposureScope.h"
+#include "ReferenceCompare.h"
+#include "Tracer.h"
+#include "ThreadPolicy.h"
+#include "GalleryWindow.h"
+#include "CameraPipeline.h"
+#include "ResourceUsage.h"
+#include "DisplayMode.h"
+#include "LensCorrection.h"
+#include "Stabilizer.h"
+#include "MosaicWindow.h"
+#include <memory>
 
 class CustomDrawingArea : public Gtk::DrawingArea {
 public:
@@ -53,36 +70,89 @@ public:
     MainWindow();
     virtual ~MainWindow();
 
-    FT232HHandler* gpio_handler;
+    FT232HHandler* gpio_handler = nullptr;
 
 protected:
 
     Gtk::Box m_VBox;
     Gtk::Box m_ButtonBox; // Horizontal box for buttons
     Gtk::DrawingArea m_DrawingArea;
-    Gtk::Button m_Button1, m_Button2, m_Button3, m_Button4;
+    Gtk::Button m_Button1, m_Button2, m_Button3, m_Button4, m_Button5, m_Button6, m_Button7, m_Button8, m_Button9, m_Button10, m_Button11, m_Button12, m_Button13;
     
-    GstElement *pipeline = nullptr;
-    GstElement *source = nullptr;
-    GstElement *capsfilter = nullptr;
+    std::unique_ptr<CameraPipeline> camera;
+    GstElement *pipeline = nullptr;      // owned by camera
+    GstElement *tee = nullptr;           // owned by camera; the display branch hangs off it
+    GstElement *display_queue = nullptr;
     GstElement *jpegdec = nullptr;
     // jpegdec = gst_element_factory_make("jpegdec", "jpegdec");
     GstElement *convert = nullptr;
     GstElement *crop = nullptr;
+    GstElement *scale = nullptr;      // display branch only, when MIVO_DISPLAY_SCALE is on
+    GstElement *scale_caps = nullptr; // sized to the drawing area
+    GstElement *hud_caps = nullptr; // ahead of the sink, only when the HUD is enabled
     GstElement *sink = nullptr;
+    std::unique_ptr<LensCorrection> lens; // ahead of the crop, when a lens model is set
+    std::unique_ptr<Stabilizer> stabilizer; // moves the crop; needs the mailbox, so goes before camera
+
+    AppConfig config = AppConfig::from_env();
+    StatsOverlay hud;
+    bool hud_rgb_caps = false;  // hud_caps asks for BGRx
+    GstVideoInfo hud_info;      // streaming thread only
+    bool hud_rgb = false;       // the frames reaching the HUD are BGRx
+    std::unique_ptr<ExposureScope> scope; // with the HUD overlay
+    std::unique_ptr<ReferenceCompare> compare; // with the HUD overlay; reads the mailbox
+    std::unique_ptr<GalleryWindow> gallery;       // created on first open
+    std::unique_ptr<Mosaic> mosaic;               // while the Mosaic button is on
+    std::unique_ptr<MosaicWindow> mosaic_window;  // shows mosaic's preview
+    std::thread mosaic_saver;                     // renders and encodes the finished mosaic
+
+    // FTDI open runs here while GStreamer and the window are set up
+    std::thread gpio_init_thread;
+
+    // Window handle handed to the sink once the drawing area is realized
+    std::mutex overlay_mutex;
+    std::condition_variable overlay_cv;
+    guintptr window_handle = 0;
+
+    bool display_size_pending = false;
+    int display_width = -1, display_height = -1; // current scaler target, 0 = unscaled
 
     int zoom_level = 0; // Initial zoom level
     bool awb_enabled = true; // Auto White Balance state
+    double awb_temperature_k = -1; // Last estimated colour temperature
+
+    std::atomic<int> display_mode{0}; // index into display_modes()
+    std::unique_ptr<LatencyHistogram[]> mode_latency{new LatencyHistogram[display_modes().size()]};
 
     void on_play();
     void on_pause();
     void on_zoom();
     void on_awb();
+    void on_gallery();
+    void on_display_mode();
+    void on_flat_field();
+    void on_flat_calibrate();
+    void on_mosaic();
+    void on_hdr();
+    void on_scope();
+    void on_exposure_warning();
+    void on_compare();
+    void report_display_latency(int mode);
     void apply_zoom();
     void on_drawing_area_realized();
+    void schedule_display_size();
+    void update_display_size();
     double awb_temperature(const std::string& imagePath);
     bool set_video_overlay();   
-    void change_resolution(int width, int height);
+    void init_gpio();
+    GstBusSyncReply on_sync_message(GstMessage* message);
+    void on_pipeline_message(GstMessage* message);
+    static GstPadProbeReturn on_first_frame(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+    static GstPadProbeReturn on_sink_buffer(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+    static GstPadProbeReturn on_hud_buffer(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+    void draw_hud(cairo_t* cr);
+    void update_hud_format();
+    bool update_hud();
 
     void add_button(Gtk::Button& button, const Glib::ustring& label, int id);
     void handle_button_press(int button);
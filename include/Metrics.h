@@ -0,0 +1,45 @@
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Live pipeline counters. Written from streaming threads, read from the UI.
+class PipelineMetrics {
+public:
+    std::atomic<uint64_t> frames_rendered{0};
+    std::atomic<uint64_t> frames_dropped{0};   // reported by sink QoS
+    std::atomic<double> fps{0};
+    std::atomic<double> latency_ms{0};         // capture timestamp to sink
+
+    // Called by the sink thread for every buffer it is about to render.
+    void on_frame_rendered(double frame_latency_ms);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point window_start = Clock::now();
+    uint64_t window_frames = 0;
+    double latency_sum = 0;
+};
+
+// Per-frame latency distribution, 1 ms bins up to one second. Lock-free to
+// add to from the sink thread; percentiles are read occasionally.
+class LatencyHistogram {
+public:
+    static constexpr int bins = 1000;
+
+    void add(double ms);
+    void reset();
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    double mean() const;
+    double percentile(double q) const;
+
+private:
+    std::atomic<uint32_t> counts[bins] = {};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> sum_us{0};
+};
+
+#endif // METRICS_H_
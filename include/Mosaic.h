@@ -0,0 +1,94 @@
+#ifndef MOSAIC_H_
+#define MOSAIC_H_
+
+#include <gst/gst.h>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FrameMailbox.h"
+#include "MosaicCanvas.h"
+
+struct MosaicSettings {
+    double scale = 0.5;           // canvas pixels per frame pixel
+    int downsample = 8;           // registration grid, multiple of 8; 1080p registers at 240x135
+    double min_response = 0.08;   // weaker phase correlation peaks don't place the frame
+    double redundant = 0.02;      // frames changing fewer cells than this are skipped unregistered
+    int preview_side = 640;       // long side of the live preview
+};
+
+// Live mosaic of a slide panned under the objective. A worker takes frames
+// from the mailbox and registers each one against the canvas built so far,
+// not just the previous frame, so errors don't pile up along the pan: phase
+// correlation on downsampled luma between the frame and the canvas around
+// the predicted position, then a running-average blend into a tiled canvas
+// that only allocates the area actually covered. Frames that barely differ
+// from the last placed one (the stage is still) are skipped before any
+// registration or colour conversion. A small preview is re-rendered twice a
+// second for the UI.
+class Mosaic {
+public:
+    Mosaic(FrameMailbox& mailbox, const MosaicSettings& settings);
+    ~Mosaic();
+
+    Mosaic(const Mosaic&) = delete;
+    Mosaic& operator=(const Mosaic&) = delete;
+
+    // Stops taking frames; the canvas stays for save().
+    void stop();
+
+    // Copies the preview (packed RGB) if it changed since *version.
+    bool preview(std::vector<uint8_t>& rgb, int* width, int* height, uint64_t* version);
+
+    // Writes the full-resolution canvas as <directory>/mosaic_<time>.jpg.
+    // Blocking (the whole canvas is rendered and encoded); returns the path,
+    // or an empty string on failure.
+    std::string save(const std::string& directory);
+
+    uint64_t frames_placed() const { return placed.load(); }
+    uint64_t frames_skipped() const { return skipped.load(); }
+    uint64_t frames_lost() const { return lost.load(); }
+
+private:
+    void run();
+    bool analyse(GstSample* sample, GstVideoInfo* info);
+    bool register_frame(int* x, int* y);
+    bool place(GstSample* sample, GstVideoInfo* info, int x, int y);
+    void update_preview();
+
+    FrameMailbox& mailbox;
+    MosaicSettings settings;
+    int step = 4; // canvas pixels per registration cell, settings.scale * downsample rounded
+
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> placed{0}, skipped{0}, lost{0};
+
+    std::mutex canvas_mutex; // worker blends, save() renders
+    MosaicCanvas canvas;
+
+    std::mutex preview_mutex;
+    std::vector<uint8_t> preview_rgb;
+    int preview_width = 0, preview_height = 0;
+    uint64_t preview_version = 0;
+
+    // Worker thread only
+    std::vector<uint8_t> luma, last_luma, region, painted;
+    std::vector<float> window;
+    int cells_width = 0, cells_height = 0;
+    int frame_width = 0, frame_height = 0;
+    bool have_position = false;
+    int position_x = 0, position_y = 0; // canvas position of the last placed frame
+    int velocity_x = 0, velocity_y = 0;
+    bool warned_format = false;
+    bool warned_lost = false;
+    uint64_t processed = 0;         // per-frame cost, reported by stop()
+    double total_ms = 0;
+    double max_ms = 0;
+
+    std::thread thread;
+};
+
+#endif // MOSAIC_H_
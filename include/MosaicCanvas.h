@@ -0,0 +1,56 @@
+#ifndef MOSAICCANVAS_H_
+#define MOSAICCANVAS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Unbounded RGB canvas made of fixed-size tiles that are only allocated when
+// something is drawn on them, so a long, winding pan costs memory for the
+// area covered, not for its bounding box. Coordinates may be negative.
+// Not thread-safe.
+class MosaicCanvas {
+public:
+    static const int tile_size = 256;
+
+    struct Bounds {
+        int x0 = 0, y0 = 0, x1 = 0, y1 = 0; // [x0, x1) x [y0, y1)
+        bool empty() const { return x1 <= x0 || y1 <= y0; }
+    };
+
+    // Blends a packed RGB image with its top-left corner at (x, y): a running
+    // average over the last few frames to cover each pixel, so noise and small
+    // registration errors even out instead of leaving seams.
+    void blend(const uint8_t* rgb, int stride, int width, int height, int x, int y);
+
+    // Luma of the canvas every `step` pixels from (x, y) into a width x height
+    // grid; unpainted cells read 0 and, if given, are 0 in `painted` (1
+    // otherwise). Returns the fraction that was painted.
+    double sample_luma(int x, int y, int step, int width, int height, uint8_t* out,
+                       uint8_t* painted = nullptr) const;
+
+    // The painted area scaled (nearest) to fit max_side, or full size with
+    // max_side 0. Unpainted parts are black.
+    void render(int max_side, std::vector<uint8_t>& rgb, int& width, int& height) const;
+
+    Bounds bounds() const { return extent; }
+    std::size_t tile_count() const { return tiles.size(); }
+    std::size_t bytes() const { return tiles.size() * sizeof(Tile); }
+
+private:
+    struct Tile {
+        uint8_t rgb[tile_size * tile_size * 3];
+        uint8_t weight[tile_size * tile_size]; // frames averaged so far, capped
+    };
+
+    static uint64_t key(int tx, int ty) { return (uint64_t)(uint32_t)tx << 32 | (uint32_t)ty; }
+    Tile* tile_at(int tx, int ty, bool create);
+    const Tile* tile_at(int tx, int ty) const;
+
+    std::unordered_map<uint64_t, std::unique_ptr<Tile>> tiles;
+    Bounds extent;
+};
+
+#endif // MOSAICCANVAS_H_
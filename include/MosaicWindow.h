@@ -0,0 +1,31 @@
+#ifndef MOSAICWINDOW_H_
+#define MOSAICWINDOW_H_
+
+#include <gtkmm.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "Mosaic.h"
+
+// Live preview of a mosaic being built. Polls the mosaic's low-resolution
+// preview twice a second; the full-resolution canvas is only rendered when
+// it is saved.
+class MosaicWindow : public Gtk::Window {
+public:
+    explicit MosaicWindow(Mosaic& mosaic);
+    ~MosaicWindow() override;
+
+private:
+    bool on_refresh();
+
+    Mosaic& mosaic;
+    Gtk::Box box;
+    Gtk::Image image;
+    Gtk::Label status;
+    sigc::connection refresh_timer;
+    std::vector<uint8_t> rgb;
+    uint64_t version = 0;
+};
+
+#endif // MOSAICWINDOW_H_
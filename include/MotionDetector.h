@@ -0,0 +1,58 @@
+#ifndef MOTIONDETECTOR_H_
+#define MOTIONDETECTOR_H_
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "FrameMailbox.h"
+#include "MotionKernels.h"
+
+// Where the luma is in frames of this format, for the downsample kernel.
+// False for formats it can't read (MJPEG, 10-bit, ...).
+bool find_luma_layout(const GstVideoInfo* info, LumaLayout* layout);
+
+struct MotionSettings {
+    int analysis_fps = 5;          // frames analysed per second, whatever the camera rate
+    int downsample = 8;            // 1080p becomes 240x135 luma cells
+    int pixel_threshold = 25;      // luma change for a cell to count as changed
+    double area_percent = 0.5;     // changed cells needed to call it motion
+};
+
+// Frame differencing on heavily downsampled luma against a running-average
+// background. Frames come from the FrameMailbox on its own thread, so the
+// streaming thread is never touched; its own CPU time is tracked and logged.
+class MotionDetector {
+public:
+    MotionDetector(FrameMailbox& mailbox, const MotionSettings& settings);
+    ~MotionDetector();
+
+    bool motion() const { return in_motion.load(std::memory_order_relaxed); }
+    double changed_percent() const { return changed.load(std::memory_order_relaxed); }
+    // Detector thread CPU time as a share of one core, since start
+    double cpu_percent() const;
+
+private:
+    void run();
+    bool analyse(GstSample* sample);
+
+    FrameMailbox& mailbox;
+    MotionSettings settings;
+    std::atomic<bool> running{true};
+    std::atomic<bool> in_motion{false};
+    std::atomic<double> changed{0};
+    std::atomic<double> cpu_seconds{0};
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+
+    std::vector<uint8_t> current;
+    std::vector<uint8_t> background;
+    int cells_width = 0, cells_height = 0;
+    bool warned_format = false;
+    std::thread thread;
+};
+
+#endif // MOTIONDETECTOR_H_
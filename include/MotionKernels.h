@@ -0,0 +1,31 @@
+#ifndef MOTIONKERNELS_H_
+#define MOTIONKERNELS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// Byte kernels for motion detection on downsampled luma. SSE2 on x86-64,
+// NEON on ARM, scalar elsewhere; all give identical results.
+
+// Where the luma bytes are in a row of the source frame.
+enum class LumaLayout {
+    Planar,  // GRAY8, I420, NV12, ...: Y plane, one byte per pixel
+    YUYV,    // YUY2: Y at even bytes
+    UYVY,    // Y at odd bytes
+    Packed4, // RGBx/BGRx/xRGB...: green (byte 1) stands in for luma
+};
+
+// Averages factor x 1 luma samples per output pixel, reading one row in
+// every `factor` rows. out is (width / factor) x (height / factor). Multiples
+// of 8 take the SIMD path; any other factor >= 1 is summed per sample.
+void downsample_luma(const uint8_t* data, int stride, int width, int height, LumaLayout layout, int factor,
+                     uint8_t* out);
+
+// Number of positions where |a - b| > threshold.
+size_t count_diff_above(const uint8_t* a, const uint8_t* b, size_t n, uint8_t threshold);
+
+// background = (3 * background + current) / 4, rounded: a slow running average
+// so gradual light changes are absorbed and sudden ones stand out.
+void blend_background(uint8_t* background, const uint8_t* current, size_t n);
+
+#endif // MOTIONKERNELS_H_
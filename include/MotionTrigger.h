@@ -0,0 +1,37 @@
+#ifndef MOTIONTRIGGER_H_
+#define MOTIONTRIGGER_H_
+
+#include <glib.h>
+#include <chrono>
+#include <memory>
+
+#include "FrameMailbox.h"
+#include "MotionDetector.h"
+#include "Recorder.h"
+
+// Records only while something moves: keeps the recorder armed (gated, with
+// pre-roll), opens the gate on motion and stops post_roll seconds after the
+// last motion, then re-arms for the next event. Runs on the main loop.
+class MotionTrigger {
+public:
+    MotionTrigger(Recorder& recorder, FrameMailbox& mailbox, const MotionSettings& settings, int post_roll_seconds);
+    ~MotionTrigger();
+
+    bool motion() const { return detector->motion(); }
+
+private:
+    static gboolean on_tick(gpointer user_data);
+    void tick();
+
+    enum class State { Arming, Armed, Recording, Stopping };
+
+    Recorder& recorder;
+    std::unique_ptr<MotionDetector> detector;
+    std::chrono::seconds post_roll;
+    State state = State::Arming;
+    std::chrono::steady_clock::time_point last_motion;
+    std::chrono::steady_clock::time_point event_start;
+    guint tick_id = 0;
+};
+
+#endif // MOTIONTRIGGER_H_
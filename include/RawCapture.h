@@ -0,0 +1,53 @@
+#ifndef RAWCAPTURE_H_
+#define RAWCAPTURE_H_
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "FrameStore.h"
+
+// Bit-exact recording: every buffer on the tapped pad is copied into one of a
+// few preallocated staging buffers and handed to a FrameStoreWriter. The
+// camera's buffer is unmapped and released before the probe returns, so a
+// slow disk never holds driver buffers and in-place work downstream (flat
+// field) still gets them unshared. Raw video only; MJPEG is not stored.
+class RawCapture {
+public:
+    RawCapture(GstPad* pad, const std::string& path, uint64_t capacity);
+    ~RawCapture();
+
+    uint64_t frames_written() const { return writer->frames_written(); }
+    uint64_t frames_dropped() const { return writer->frames_dropped() + dropped_staging; }
+
+private:
+    static constexpr size_t staging_depth = 4; // frames waiting for the writer
+
+    static GstPadProbeReturn on_data(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+    void set_caps(GstCaps* caps);
+    void on_buffer(GstBuffer* buffer);
+    std::vector<uint8_t>* take_staging(size_t size);
+    void return_staging(std::vector<uint8_t>* staging);
+
+    GstPad* pad;
+    gulong probe_id = 0;
+    std::unique_ptr<FrameStoreWriter> writer;
+    uint64_t next_sequence = 0;
+
+    GstVideoInfo video;             // streaming thread only
+    bool have_video = false;
+    bool warned_format = false;
+
+    std::mutex staging_mutex;
+    std::vector<std::unique_ptr<std::vector<uint8_t>>> free_staging;
+    size_t staging_size = 0;        // buffers of another size are dropped on return
+    size_t staging_out = 0;         // with the writer
+    std::atomic<uint64_t> dropped_staging{0};
+};
+
+#endif // RAWCAPTURE_H_
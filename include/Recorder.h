@@ -0,0 +1,94 @@
+#ifndef RECORDER_H_
+#define RECORDER_H_
+
+#include <gst/gst.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "FrameIntegrity.h"
+
+struct RecorderSettings {
+    std::string directory;              // segments are written here
+    int segment_seconds = 60;
+    uint64_t quota_bytes = 2048ull << 20; // oldest segments are deleted beyond this
+    int bitrate_kbps = 4000;
+    int speed_preset = 3;               // x264enc speed-preset, 3 = veryfast
+    int threads = 0;                    // x264enc threads, 0 = automatic
+    int preroll_seconds = 0;            // > 0: start gated, keeping this much encoded video
+};
+
+// Continuous recording branch hung off the capture tee. Video is cut into
+// fixed-duration fragmented MP4 segments: each fragment is self-contained, so
+// a segment stays playable up to its last fragment even if the process is
+// killed mid-write.
+class Recorder {
+public:
+    Recorder(GstElement* pipeline, GstElement* tee, const RecorderSettings& settings);
+    ~Recorder();
+
+    bool start();
+    void stop();                         // asynchronous; finished by handle_message()
+    void stop_blocking(GstClockTime timeout);
+    bool recording() const { return bin != nullptr; }
+
+    // Gated recording (preroll_seconds > 0): the branch encodes continuously
+    // but holds the output in a leaky queue of preroll_seconds plus one GOP.
+    // open_gate() writes from the oldest keyframe still held, so a recording
+    // starts up to preroll_seconds before the trigger. stop() ends it.
+    void open_gate();
+    bool gate_open() const { return gate_probe == 0; }
+
+    // Encoder load, sampled by EncoderTuner
+    std::atomic<uint64_t> frames_offered{0};   // reached the recording queue
+    std::atomic<uint64_t> frames_encoded{0};   // left the encoder
+    double queue_fill() const;                 // 0..1 of the queue's time budget
+    const RecorderSettings& current_settings() const { return settings; }
+
+    // Bitrate changes apply live; preset and thread changes restart the branch,
+    // which closes the current segment early.
+    void set_bitrate(int kbps);
+    void reconfigure(int speed_preset, int threads);
+
+    // Per-segment drop counts are appended to integrity.csv next to the segments.
+    void set_integrity(const FrameIntegrity* integrity) { this->integrity = integrity; }
+
+    // Feed bus messages here; returns true if the message belonged to the recorder.
+    bool handle_message(GstMessage* message);
+
+private:
+    GstElement* build_branch();
+    void teardown();
+    void enforce_quota(uint64_t incoming_bytes);
+    void log_integrity(const char* location);
+
+    static gchar* on_format_location(GstElement* splitmux, guint fragment_id, gpointer user_data);
+    static GstPadProbeReturn on_tee_pad_idle(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+    static GstPadProbeReturn on_gate_blocked(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+    static GstPadProbeReturn on_until_keyframe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+    static GstPadProbeReturn on_count_buffer(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+
+    GstElement* pipeline;
+    GstElement* tee;
+    RecorderSettings settings;
+
+    GstElement* bin = nullptr;
+    GstElement* splitmux = nullptr;
+    GstElement* queue = nullptr;
+    GstElement* encoder = nullptr;
+    GstElement* preroll = nullptr;       // encoded-video queue in front of the muxer, gated mode only
+    gulong gate_probe = 0;
+    bool restart_pending = false;
+    GstPad* tee_pad = nullptr;
+    std::atomic<bool> stopping{false};
+    std::string session;
+    std::atomic<unsigned> next_segment{0}; // never restarts, unlike splitmuxsink's fragment_id
+
+    const FrameIntegrity* integrity = nullptr;
+    uint64_t logged_captured = 0;
+    uint64_t logged_sensor = 0;
+    uint64_t logged_pipeline = 0;
+    uint64_t logged_duplicates = 0;
+};
+
+#endif // RECORDER_H_
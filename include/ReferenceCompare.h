@@ -0,0 +1,99 @@
+#ifndef REFERENCECOMPARE_H_
+#define REFERENCECOMPARE_H_
+
+#include <gst/gst.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "FrameMailbox.h"
+#include "LensRemap.h"
+#include "LruCache.h"
+#include "MotionKernels.h"
+
+enum class CompareMode { Off, Split, Difference };
+
+// A/B comparison of the live image against a stored reference, for QA.
+//
+// The reference is decoded once. A worker scores every new mailbox frame
+// against it while a mode is on: PSNR and SSIM on 1/8-scale luma, the
+// reference's luma prepared once per capture size with the same kernel the
+// live frame goes through. For the display the worker also converts the
+// reference to BGRx at the displayed size and zoom (recent ones kept in an
+// LRU cache), so apply() on the display thread is only a row copy (split:
+// reference on the right half) or one SIMD absolute-difference pass.
+class ReferenceCompare {
+public:
+    explicit ReferenceCompare(FrameMailbox& mailbox);
+    ~ReferenceCompare();
+
+    ReferenceCompare(const ReferenceCompare&) = delete;
+    ReferenceCompare& operator=(const ReferenceCompare&) = delete;
+
+    // Any format OpenCV reads; false if it can't be read.
+    bool load(const std::string& path);
+    bool loaded() const;
+
+    void set_mode(CompareMode mode) { mode_ = mode; }
+    CompareMode mode() const { return mode_; }
+    static const char* name(CompareMode mode);
+
+    // Zoom crop in capture pixels, so the displayed reference shows the
+    // same part of the field as the live view. From the UI thread.
+    void set_view(const ViewCrop& view);
+
+    // Display thread, on a BGRx frame. Frames pass unchanged (false) until
+    // the reference for this size and zoom is ready. In split mode the left
+    // width / 2 columns stay live.
+    bool apply(uint8_t* bgrx, int stride, int width, int height);
+
+    bool scored() const { return scored_frames.load() > 0; }
+    double psnr() const { return psnr_db.load(std::memory_order_relaxed); }
+    double ssim() const { return ssim_value.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    void score(GstSample* sample);
+    void prepare_display();
+
+    FrameMailbox& mailbox;
+    std::atomic<CompareMode> mode_{CompareMode::Off};
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> scored_frames{0};
+    std::atomic<double> psnr_db{0};
+    std::atomic<double> ssim_value{0};
+
+    mutable std::mutex reference_mutex;
+    std::shared_ptr<const cv::Mat> reference; // RGB, as loaded
+    uint64_t reference_id = 0;                // bumped by load()
+    uint64_t generation = 0;                  // bumped by load() and set_view()
+    ViewCrop view;
+
+    // Display request and result
+    std::mutex display_mutex;
+    int wanted_width = 0, wanted_height = 0;
+    std::shared_ptr<const cv::Mat> ready; // BGRx at ready_width x ready_height
+    int ready_width = 0, ready_height = 0;
+    uint64_t ready_generation = 0;
+
+    // Worker thread only
+    int capture_width = 0, capture_height = 0;
+    uint64_t luma_reference = 0;
+    int luma_width = 0, luma_height = 0;
+    LumaLayout luma_layout = LumaLayout::Planar;
+    bool luma_limited = false;
+    std::vector<uint8_t> reference_luma, live_luma;
+    LruCache<std::string, std::shared_ptr<const cv::Mat>> display_cache{64u << 20};
+    uint64_t cache_reference = 0;
+    bool warned_format = false;
+
+    std::thread thread;
+};
+
+#endif // REFERENCECOMPARE_H_
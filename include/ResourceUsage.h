@@ -0,0 +1,21 @@
+#ifndef RESOURCEUSAGE_H_
+#define RESOURCEUSAGE_H_
+
+#include <string>
+
+// Whole-process CPU and memory since launch, from getrusage and
+// /proc/self/status. Used to compare the GUI and headless builds.
+struct ResourceUsage {
+    double wall_s = 0;
+    double cpu_s = 0;         // user + system
+    long rss_kb = 0;          // current resident set
+    long peak_rss_kb = 0;
+    int threads = 0;
+
+    static ResourceUsage sample();
+    std::string summary() const;
+};
+
+void print_resource_usage(const std::string& label);
+
+#endif // RESOURCEUSAGE_H_
@@ -0,0 +1,43 @@
+#ifndef SCOPEKERNELS_H_
+#define SCOPEKERNELS_H_
+
+#include <cstdint>
+
+// Pixel kernels for the exposure scope, on the BGRx (cairo RGB24/ARGB32)
+// frames the HUD overlay draws on. Rows are [first_row, last_row) so a
+// frame can be split into bands across threads.
+
+struct ScopeHistogram {
+    uint32_t red[256], green[256], blue[256], luma[256];
+
+    void clear();
+    void add(const ScopeHistogram& other);
+};
+
+// Waveform monitor grid: counts[level * scope_waveform_width + column], the
+// frame's columns binned to scope_waveform_width, luma to scope_waveform_levels.
+static const int scope_waveform_width = 256;
+static const int scope_waveform_levels = 64;
+
+// BT.709 luma from 8-bit RGB, weights summing to 256.
+inline uint8_t scope_luma(uint8_t r, uint8_t g, uint8_t b) {
+    return (uint8_t)((54 * r + 183 * g + 19 * b) >> 8);
+}
+
+// Adds every other pixel of every other row to histogram (and to waveform
+// if not null), which is plenty for a histogram and a quarter of the work.
+// Four partial histograms take alternate pixels so consecutive increments
+// never wait on the same counter.
+void accumulate_scope(const uint8_t* bgrx, int stride, int width, int first_row, int last_row,
+                      ScopeHistogram& histogram, uint32_t* waveform);
+
+// Diagonal zebra stripes (every other 8-pixel band blacked out) over pixels
+// with any channel at or above level. phase moves the stripes.
+// SSE2 on x86-64, NEON on ARM, scalar elsewhere; all give identical results.
+void apply_zebra(uint8_t* bgrx, int stride, int width, int first_row, int last_row, uint8_t level, int phase);
+
+// Replaces every pixel with palette[luma], palette entries being BGRx words.
+void apply_false_colour(uint8_t* bgrx, int stride, int width, int first_row, int last_row,
+                        const uint32_t* palette);
+
+#endif // SCOPEKERNELS_H_
@@ -0,0 +1,16 @@
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+#include <gst/gst.h>
+#include <string>
+
+// Writes a frame to <directory>/mivo_<timestamp>.jpg. MJPEG frames are
+// written as they are; raw frames are encoded with gst_video_convert_sample.
+// Blocking (tens of ms for 1080p), so call it off the UI/streaming threads.
+// Returns the path, or an empty string on failure.
+std::string save_snapshot(GstSample* sample, const std::string& directory);
+
+// <directory>/<prefix>_<local time to the millisecond>.jpg
+std::string capture_path(const std::string& directory, const char* prefix);
+
+#endif // SNAPSHOT_H_
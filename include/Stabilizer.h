@@ -0,0 +1,74 @@
+#ifndef STABILIZER_H_
+#define STABILIZER_H_
+
+#include <gst/gst.h>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "FrameMailbox.h"
+#include "LensRemap.h"
+
+struct StabilizerSettings {
+    int downsample = 8;         // multiple of 8; 1080p is analysed at 240x135
+    double smoothing = 0.9;     // 0..1, how slowly the smoothed path follows the camera
+    double min_response = 0.05; // phase correlation peaks below this are ignored
+};
+
+// Electronic stabilization for the zoomed view. A worker takes the newest
+// frame from the mailbox as soon as it arrives, measures the global shift
+// against the previous one by phase correlation on downsampled luma, and
+// low-pass filters the accumulated camera path. The crop window then follows
+// the shake (raw path minus smoothed path), limited to the zoom margin, so the
+// picture holds still while deliberate pans come through. The new offset
+// applies to the next frame through videocrop: one frame of latency when the
+// analysis keeps up, which at 1/8 scale it does comfortably (phase
+// correlation still resolves well under a pixel there).
+class Stabilizer {
+public:
+    Stabilizer(FrameMailbox& mailbox, GstElement* crop, const StabilizerSettings& settings);
+    ~Stabilizer();
+
+    // The zoom crop to move around, from the UI thread. Resets the path.
+    void set_view(const ViewCrop& view);
+    void set_enabled(bool enabled);
+    bool enabled() const { return active.load(); }
+
+    double analyse_ms() const { return last_analyse_ms.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    bool measure(GstSample* sample, double* dx, double* dy);
+    void apply(int offset_x, int offset_y);
+
+    FrameMailbox& mailbox;
+    GstElement* crop;
+    StabilizerSettings settings;
+
+    std::atomic<bool> running{true};
+    std::atomic<bool> active{true};
+    std::atomic<double> last_analyse_ms{0};
+
+    std::mutex view_mutex;
+    ViewCrop view;
+    bool view_changed = true;
+
+    // Worker thread only
+    std::vector<uint8_t> luma;
+    std::vector<float> previous;
+    std::vector<float> window;
+    int cells_width = 0, cells_height = 0;
+    double raw_x = 0, raw_y = 0;
+    double smooth_x = 0, smooth_y = 0;
+    int applied_x = 0, applied_y = 0;
+    bool warned_format = false;
+    uint64_t analysed = 0;          // per-frame cost, reported on exit
+    double total_analyse_ms = 0;
+    double max_analyse_ms = 0;
+
+    std::thread thread;
+};
+
+#endif // STABILIZER_H_
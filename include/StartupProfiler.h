@@ -0,0 +1,52 @@
+#ifndef STARTUPPROFILER_H_
+#define STARTUPPROFILER_H_
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Records how long each startup phase takes, from process start to the first
+// frame reaching the video sink. Phases may be recorded from any thread.
+class StartupProfiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr double first_frame_target_ms = 500.0;
+
+    static StartupProfiler& instance();
+
+    // Scoped phase: measures from construction to destruction.
+    class Phase {
+    public:
+        explicit Phase(const std::string& name);
+        ~Phase();
+
+    private:
+        std::string name;
+        Clock::time_point begin;
+    };
+
+    void record(const std::string& name, Clock::time_point begin, Clock::time_point end);
+    void mark_first_frame();
+    double elapsed_ms() const;
+    void report();
+
+private:
+    StartupProfiler();
+
+    struct Entry {
+        std::string name;
+        double start_ms;
+        double duration_ms;
+        std::string thread;
+    };
+
+    Clock::time_point origin;
+    std::mutex mutex;
+    std::vector<Entry> entries;
+    double first_frame_ms = -1;
+    bool reported = false;
+};
+
+#endif // STARTUPPROFILER_H_
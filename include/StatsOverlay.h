@@ -0,0 +1,53 @@
+#ifndef STATSOVERLAY_H_
+#define STATSOVERLAY_H_
+
+#include <cairomm/cairomm.h>
+#include <gst/video/video.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// On-video stats HUD. The text is rendered into a small cached surface that is
+// only redrawn when the displayed values change. On an RGB frame it is
+// blitted in place; otherwise the same surface goes out as an overlay
+// composition that the sink blends, so the frame itself is never touched.
+class StatsOverlay {
+public:
+    struct Values {
+        double fps = 0;
+        double latency_ms = 0;
+        uint64_t dropped = 0;          // late frames dropped by the sink
+        uint64_t sensor_drops = 0;     // missing in the v4l2 sequence
+        uint64_t pipeline_drops = 0;   // captured but never displayed
+        int zoom_level = 0;
+        bool awb_enabled = true;
+        double temperature_k = -1;  // negative until AWB has been estimated
+        std::string display_mode;
+        std::string scope;          // empty when the scope and warnings are off
+        std::string compare;        // empty unless comparing against a reference
+    };
+
+    ~StatsOverlay();
+
+    void update(const Values& values);   // UI thread
+    void draw(cairo_t* cr);              // streaming thread, once per frame
+    // Streaming thread: a new reference to the cached composition, or nullptr
+    // when there is nothing to show. Rebuilt only when the text changes.
+    GstVideoOverlayComposition* composition();
+
+private:
+    static constexpr int width = 230;
+    static constexpr int line_height = 18;
+
+    std::vector<std::string> format(const Values& values) const;
+    void render();
+
+    std::mutex mutex;
+    std::vector<std::string> lines;
+    bool dirty = false;
+    Cairo::RefPtr<Cairo::ImageSurface> surface;
+    GstVideoOverlayComposition* cached = nullptr; // of surface, until the next render()
+};
+
+#endif // STATSOVERLAY_H_
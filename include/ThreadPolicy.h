@@ -0,0 +1,63 @@
+#ifndef THREADPOLICY_H_
+#define THREADPOLICY_H_
+
+#include <chrono>
+#include <map>
+#include <sched.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Names the app's threads by role (capture, display, render, ui, keypad, ...)
+// and applies per-role CPU pinning and scheduling from the configuration:
+//
+//   MIVO_THREAD_CPUS="capture=2,render=3,ui=0,keypad=1"
+//   MIVO_THREAD_PRIO="capture=fifo:50,render=nice:-5"
+//
+// Real-time and negative nice values need CAP_SYS_NICE; without it the
+// failure is logged once and the thread keeps its default policy.
+//
+// Threads inherit their creator's affinity and scheduling, so an adopted
+// thread whose role has no rule is put back to the process defaults, and
+// priorities are set with SCHED_RESET_ON_FORK so threads started from a
+// prioritised one (GStreamer, x264, pool workers) don't get them.
+class ThreadPolicy {
+public:
+    static ThreadPolicy& instance();
+
+    void configure(const std::string& cpus, const std::string& priorities);
+
+    // From inside the thread: rename it and apply its role's rule. The main
+    // thread keeps its name, which is the process name.
+    void adopt_current(const std::string& role);
+    // Threads we cannot run code in (e.g. the GL render thread), found by comm.
+    bool adopt_by_name(const std::string& role, const std::string& comm);
+
+    // Per-thread CPU usage since the previous report.
+    void report();
+
+private:
+    struct Rule {
+        int cpu = -1;
+        enum class Kind { None, Fifo, Nice } kind = Kind::None;
+        int value = 0;
+    };
+    struct Tracked {
+        std::string role;
+        unsigned long long last_ticks = 0;
+    };
+
+    ThreadPolicy() = default;
+    void apply(const std::string& role, int tid);
+    static unsigned long long cpu_ticks(int tid);
+
+    std::mutex mutex;
+    std::map<std::string, Rule> rules;
+    std::map<int, Tracked> threads;     // by tid
+    std::chrono::steady_clock::time_point last_report = std::chrono::steady_clock::now();
+    bool warned_permission = false;
+    cpu_set_t default_cpus;             // the process's affinity before any rule
+    int default_nice = 0;
+};
+
+#endif // THREADPOLICY_H_
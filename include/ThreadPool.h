@@ -0,0 +1,47 @@
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Fixed set of background workers for work that must stay off the UI and
+// streaming threads (thumbnail decodes, analysis). Workers take the most
+// recently submitted task first: for on-screen work the newest request is
+// the one the user is looking at.
+class ThreadPool {
+public:
+    // threads == 0 picks hardware threads - 1 (at least one). Workers adopt
+    // the given ThreadPolicy role so they can be pinned away from capture.
+    explicit ThreadPool(std::size_t threads = 0, const std::string& role = "pool");
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+    // Runs body(0) .. body(count - 1) on the workers and the calling thread,
+    // returning when all are done. For splitting one frame into row bands.
+    void parallel_for(std::size_t count, const std::function<void(std::size_t)>& body);
+    // Drops tasks that have not started yet.
+    void clear();
+
+    std::size_t size() const { return workers.size(); }
+    std::size_t pending();
+
+private:
+    void run(const std::string& role);
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::function<void()>> tasks;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+};
+
+#endif // THREADPOOL_H_
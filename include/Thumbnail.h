@@ -0,0 +1,27 @@
+#ifndef THUMBNAIL_H_
+#define THUMBNAIL_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Packed RGB thumbnail, fitted inside max_side x max_side.
+struct Thumbnail {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> rgb; // width * 3 bytes per row
+
+    std::size_t bytes() const { return rgb.size(); }
+};
+
+// JPEGs are decoded with libjpeg's DCT scaling (1/2, 1/4, 1/8), so only about
+// as many pixels as the thumbnail needs are ever produced. Videos use their
+// first decodable frame. Returns false if the file can't be decoded.
+bool load_thumbnail(const std::string& path, int max_side, Thumbnail& out);
+bool load_jpeg_thumbnail(const std::string& path, int max_side, Thumbnail& out);
+bool load_video_thumbnail(const std::string& path, int max_side, Thumbnail& out);
+
+bool is_image_file(const std::string& path);
+bool is_video_file(const std::string& path);
+
+#endif // THUMBNAIL_H_
@@ -0,0 +1,66 @@
+#ifndef TIMELAPSE_H_
+#define TIMELAPSE_H_
+
+#include <gst/gst.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+struct TimelapseSettings {
+    std::string directory;          // output goes here
+    int interval_seconds = 10;      // one frame kept per interval
+    bool images = false;            // JPEG sequence instead of a video
+    int playback_fps = 25;          // frame rate of the timelapse video
+};
+
+// Keeps one frame per interval and writes it to an H.264 video (fragmented
+// MP4, crash-safe like the recorder) or a JPEG sequence.
+//
+// The other frames are dropped by a probe on the capture pad, ahead of the tee,
+// so nothing downstream (conversion, crop, display, encoder) ever sees them.
+// Frames are picked by wall time rather than PTS, which restarts when the
+// watchdog rebuilds the source.
+class Timelapse {
+public:
+    Timelapse(GstElement* pipeline, GstElement* tee, GstPad* capture_pad, const TimelapseSettings& settings);
+    ~Timelapse();
+
+    bool start();
+    // Detaches the branch and waits for the file to be finalised.
+    void stop_blocking(GstClockTime timeout);
+
+    // Around a pipeline restart, which would otherwise reopen (and truncate)
+    // the file: finish_file() closes it, next_file() attaches a new branch
+    // with a new name. The frame schedule carries on.
+    void finish_file(GstClockTime timeout);
+    bool next_file();
+
+    uint64_t frames_kept() const { return kept.load(); }
+    uint64_t frames_dropped() const { return dropped.load(); }
+
+private:
+    GstElement* build_branch();
+    bool attach_branch();
+    void teardown();
+
+    static GstPadProbeReturn on_capture_buffer(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+    static GstPadProbeReturn on_branch_buffer(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+    static GstPadProbeReturn on_tee_pad_idle(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+
+    GstElement* pipeline;
+    GstElement* tee;
+    GstPad* capture_pad;
+    TimelapseSettings settings;
+
+    GstElement* bin = nullptr;
+    GstPad* tee_pad = nullptr;
+    gulong capture_probe = 0;
+    unsigned files = 0;             // branches built; numbers names within one stamp
+
+    int64_t next_due_us = 0;        // streaming thread only
+    uint64_t written = 0;           // branch streaming thread only; per file
+    std::atomic<uint64_t> kept{0};
+    std::atomic<uint64_t> dropped{0};
+};
+
+#endif // TIMELAPSE_H_
@@ -0,0 +1,85 @@
+#ifndef TRACER_H_
+#define TRACER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+// Low-overhead timeline recorder. Each thread appends to its own fixed-size
+// ring, so recording never takes a lock; dump() writes everything out as a
+// Chrome trace JSON file (chrome://tracing, ui.perfetto.dev).
+class Tracer {
+public:
+    static Tracer& instance();
+
+    // Tracing stays off (and every call is a single branch) until enabled.
+    void enable(const std::string& output_path);
+    bool enabled() const { return active.load(std::memory_order_relaxed); }
+
+    // Names and categories must outlive the tracer; use intern() for strings
+    // built at runtime.
+    const char* intern(const std::string& text);
+
+    uint64_t now_us() const;
+    void complete(const char* category, const char* name, uint64_t begin_us, uint64_t end_us);
+    void instant(const char* category, const char* name);
+
+    bool dump();
+
+private:
+    Tracer();
+
+    struct Event {
+        const char* category;
+        const char* name;
+        uint64_t ts_us;
+        uint64_t dur_us;
+        char phase;
+    };
+
+    static constexpr size_t ring_size = 16384;
+
+    struct ThreadRing {
+        int tid;
+        std::string name;
+        std::unique_ptr<Event[]> events{new Event[ring_size]};
+        std::atomic<uint64_t> head{0};
+    };
+
+    ThreadRing* ring();
+    void push(const Event& event);
+
+    std::atomic<bool> active{false};
+    std::string path;
+    std::chrono::steady_clock::time_point origin;
+
+    std::mutex mutex;   // guards registration and interning, never recording
+    std::vector<std::unique_ptr<ThreadRing>> rings;
+    std::set<std::string> strings;
+};
+
+// Records a complete ('X') event covering its own lifetime.
+class TraceSpan {
+public:
+    TraceSpan(const char* category, const char* name)
+        : category(category), name(name),
+          begin(Tracer::instance().enabled() ? Tracer::instance().now_us() : 0) {}
+
+    ~TraceSpan() {
+        if (begin) {
+            Tracer::instance().complete(category, name, begin, Tracer::instance().now_us());
+        }
+    }
+
+private:
+    const char* category;
+    const char* name;
+    uint64_t begin;
+};
+
+#endif // TRACER_H_
@@ -0,0 +1,56 @@
+#ifndef WATCHDOG_H_
+#define WATCHDOG_H_
+
+#include <gst/gst.h>
+#include <atomic>
+#include <cstdint>
+
+#include "CaptureSource.h"
+
+// Restarts the capture source when it stops delivering buffers for too long
+// or posts an ERROR. Only the source bin is rebuilt; display and recording
+// branches keep running. A failing source also sends EOS, which would end
+// the recorder and timelapse files for good, so EOS is held back at the
+// source bin while the watchdog runs. Retries back off exponentially.
+class PipelineWatchdog {
+public:
+    PipelineWatchdog(GstElement* pipeline, CameraSource& source, int stall_ms);
+    ~PipelineWatchdog();
+
+    // Feed bus messages here; returns true for source errors it took over.
+    bool handle_message(GstMessage* message);
+
+    std::atomic<uint64_t> recoveries{0};
+    std::atomic<double> last_recovery_ms{0};
+
+private:
+    static constexpr int check_interval_ms = 100;
+    static constexpr int initial_backoff_ms = 100;
+    static constexpr int max_backoff_ms = 5000;
+
+    static int64_t now_ms();
+    static gboolean on_check(gpointer user_data);
+    static gboolean on_retry(gpointer user_data);
+    static GstPadProbeReturn on_buffer(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+    static GstPadProbeReturn on_source_eos(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+
+    void check();
+    void fault(const char* reason);
+    void retry();
+
+    GstElement* pipeline;
+    CameraSource& source;
+    int stall_ms;
+    gulong probe_id = 0;
+    gulong eos_probe_id = 0;
+    guint check_id = 0;
+    guint retry_id = 0;
+
+    std::atomic<int64_t> last_buffer_ms{0};
+    int64_t armed_since_ms = 0;     // start of the current PLAYING period
+    int64_t fault_ms = 0;           // 0 while healthy
+    int backoff_ms = initial_backoff_ms;
+    int attempts = 0;
+};
+
+#endif // WATCHDOG_H_
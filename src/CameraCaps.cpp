@@ -0,0 +1,345 @@
+#include "CameraCaps.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <linux/videodev2.h>
+#include <sstream>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char cache_magic[8] = {'M', 'I', 'V', 'O', 'C', 'A', 'P', '1'};
+static const uint32_t cache_version = 1;
+
+bool CameraIdentity::same_device(const CameraIdentity& other) const {
+    return vendor_id == other.vendor_id && product_id == other.product_id &&
+           bcd_device == other.bcd_device && serial == other.serial && card == other.card;
+}
+
+std::string CameraIdentity::key() const {
+    char ids[16];
+    std::snprintf(ids, sizeof(ids), "%04x-%04x", vendor_id, product_id);
+    return std::string(ids) + "-" + (serial.empty() ? "noserial" : serial);
+}
+
+static std::string read_sysfs(const std::string& path) {
+    std::ifstream in(path);
+    std::string value;
+    std::getline(in, value);
+    return value;
+}
+
+// The USB descriptor fields live two levels up from the video4linux node:
+// /sys/class/video4linux/videoN/device is the UVC interface, its parent the device.
+CameraIdentity CameraCapabilities::identify(const std::string& device) {
+    CameraIdentity identity;
+    std::string node = device.substr(device.find_last_of('/') + 1);
+    std::string usb = "/sys/class/video4linux/" + node + "/device/../";
+
+    identity.vendor_id = std::strtoul(read_sysfs(usb + "idVendor").c_str(), nullptr, 16);
+    identity.product_id = std::strtoul(read_sysfs(usb + "idProduct").c_str(), nullptr, 16);
+    identity.bcd_device = std::strtoul(read_sysfs(usb + "bcdDevice").c_str(), nullptr, 16);
+    identity.serial = read_sysfs(usb + "serial");
+
+    int fd = open(device.c_str(), O_RDWR | O_NONBLOCK);
+    if (fd >= 0) {
+        struct v4l2_capability cap = {};
+        if (ioctl(fd, VIDIOC_QUERYCAP, &cap) == 0) {
+            identity.card = reinterpret_cast<const char*>(cap.card);
+            identity.bus_info = reinterpret_cast<const char*>(cap.bus_info);
+        }
+        close(fd);
+    }
+    return identity;
+}
+
+static void probe_intervals(int fd, CameraMode& mode) {
+    struct v4l2_frmivalenum ival = {};
+    ival.pixel_format = mode.fourcc;
+    ival.width = mode.width;
+    ival.height = mode.height;
+    for (ival.index = 0; ioctl(fd, VIDIOC_ENUM_FRAMEINTERVALS, &ival) == 0; ival.index++) {
+        if (ival.type == V4L2_FRMIVAL_TYPE_DISCRETE) {
+            mode.intervals.emplace_back(ival.discrete.numerator, ival.discrete.denominator);
+        } else {
+            // Continuous/stepwise: the two ends are enough to pick a rate
+            mode.intervals.emplace_back(ival.stepwise.min.numerator, ival.stepwise.min.denominator);
+            mode.intervals.emplace_back(ival.stepwise.max.numerator, ival.stepwise.max.denominator);
+            break;
+        }
+    }
+}
+
+bool CameraCapabilities::probe(const std::string& device) {
+    identity = identify(device);
+    modes.clear();
+    controls.clear();
+
+    int fd = open(device.c_str(), O_RDWR | O_NONBLOCK);
+    if (fd < 0) {
+        perror("Failed to open video device");
+        return false;
+    }
+
+    struct v4l2_fmtdesc fmt = {};
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    for (fmt.index = 0; ioctl(fd, VIDIOC_ENUM_FMT, &fmt) == 0; fmt.index++) {
+        struct v4l2_frmsizeenum size = {};
+        size.pixel_format = fmt.pixelformat;
+        for (size.index = 0; ioctl(fd, VIDIOC_ENUM_FRAMESIZES, &size) == 0; size.index++) {
+            if (size.type == V4L2_FRMSIZE_TYPE_DISCRETE) {
+                CameraMode mode;
+                mode.fourcc = fmt.pixelformat;
+                mode.width = size.discrete.width;
+                mode.height = size.discrete.height;
+                probe_intervals(fd, mode);
+                modes.push_back(mode);
+            } else {
+                for (auto wh : {std::make_pair(size.stepwise.min_width, size.stepwise.min_height),
+                                std::make_pair(size.stepwise.max_width, size.stepwise.max_height)}) {
+                    CameraMode mode;
+                    mode.fourcc = fmt.pixelformat;
+                    mode.width = wh.first;
+                    mode.height = wh.second;
+                    probe_intervals(fd, mode);
+                    modes.push_back(mode);
+                }
+                break;
+            }
+        }
+    }
+
+    struct v4l2_queryctrl query = {};
+    query.id = V4L2_CTRL_FLAG_NEXT_CTRL;
+    while (ioctl(fd, VIDIOC_QUERYCTRL, &query) == 0) {
+        if (!(query.flags & V4L2_CTRL_FLAG_DISABLED) && query.type != V4L2_CTRL_TYPE_CTRL_CLASS) {
+            CameraControl control;
+            control.id = query.id;
+            control.type = query.type;
+            control.minimum = query.minimum;
+            control.maximum = query.maximum;
+            control.step = query.step ? query.step : 1;
+            control.default_value = query.default_value;
+            control.name = reinterpret_cast<const char*>(query.name);
+            controls.push_back(control);
+        }
+        query.id |= V4L2_CTRL_FLAG_NEXT_CTRL;
+    }
+    close(fd);
+
+    std::cout << "Probed " << identity.card << " (" << identity.key() << "): " << modes.size()
+              << " modes, " << controls.size() << " controls" << std::endl;
+    return !modes.empty();
+}
+
+static void write_u32(std::ostream& out, uint32_t v) { out.write(reinterpret_cast<const char*>(&v), sizeof(v)); }
+static void write_i32(std::ostream& out, int32_t v) { out.write(reinterpret_cast<const char*>(&v), sizeof(v)); }
+static void write_str(std::ostream& out, const std::string& s) {
+    write_u32(out, s.size());
+    out.write(s.data(), s.size());
+}
+static bool read_u32(std::istream& in, uint32_t& v) { return bool(in.read(reinterpret_cast<char*>(&v), sizeof(v))); }
+static bool read_i32(std::istream& in, int32_t& v) { return bool(in.read(reinterpret_cast<char*>(&v), sizeof(v))); }
+static bool read_str(std::istream& in, std::string& s) {
+    uint32_t n;
+    if (!read_u32(in, n) || n > 4096) {
+        return false;
+    }
+    s.resize(n);
+    return bool(in.read(&s[0], n));
+}
+
+// Written to a temporary file and renamed, so a crash never leaves a torn cache.
+bool CameraCapabilities::save(const std::string& path) const {
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+        out.write(cache_magic, sizeof(cache_magic));
+        write_u32(out, cache_version);
+        write_u32(out, identity.vendor_id);
+        write_u32(out, identity.product_id);
+        write_u32(out, identity.bcd_device);
+        write_str(out, identity.serial);
+        write_str(out, identity.card);
+        write_str(out, identity.bus_info);
+
+        write_u32(out, modes.size());
+        for (const auto& mode : modes) {
+            write_u32(out, mode.fourcc);
+            write_u32(out, mode.width);
+            write_u32(out, mode.height);
+            write_u32(out, mode.intervals.size());
+            for (const auto& ival : mode.intervals) {
+                write_u32(out, ival.first);
+                write_u32(out, ival.second);
+            }
+        }
+        write_u32(out, controls.size());
+        for (const auto& control : controls) {
+            write_u32(out, control.id);
+            write_u32(out, control.type);
+            write_i32(out, control.minimum);
+            write_i32(out, control.maximum);
+            write_i32(out, control.step);
+            write_i32(out, control.default_value);
+            write_str(out, control.name);
+        }
+        if (!out) {
+            return false;
+        }
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+bool CameraCapabilities::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[sizeof(cache_magic)];
+    uint32_t version, v;
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, cache_magic, sizeof(magic)) != 0 ||
+        !read_u32(in, version) || version != cache_version) {
+        return false;
+    }
+
+    CameraCapabilities loaded;
+    if (!read_u32(in, v)) return false;
+    loaded.identity.vendor_id = v;
+    if (!read_u32(in, v)) return false;
+    loaded.identity.product_id = v;
+    if (!read_u32(in, v)) return false;
+    loaded.identity.bcd_device = v;
+    if (!read_str(in, loaded.identity.serial) || !read_str(in, loaded.identity.card) ||
+        !read_str(in, loaded.identity.bus_info)) {
+        return false;
+    }
+
+    uint32_t count;
+    if (!read_u32(in, count)) return false;
+    for (uint32_t i = 0; i < count; ++i) {
+        CameraMode mode;
+        uint32_t intervals;
+        if (!read_u32(in, mode.fourcc) || !read_u32(in, mode.width) || !read_u32(in, mode.height) ||
+            !read_u32(in, intervals)) {
+            return false;
+        }
+        for (uint32_t j = 0; j < intervals; ++j) {
+            uint32_t num, den;
+            if (!read_u32(in, num) || !read_u32(in, den)) return false;
+            mode.intervals.emplace_back(num, den);
+        }
+        loaded.modes.push_back(mode);
+    }
+    if (!read_u32(in, count)) return false;
+    for (uint32_t i = 0; i < count; ++i) {
+        CameraControl control;
+        if (!read_u32(in, control.id) || !read_u32(in, control.type) || !read_i32(in, control.minimum) ||
+            !read_i32(in, control.maximum) || !read_i32(in, control.step) ||
+            !read_i32(in, control.default_value) || !read_str(in, control.name)) {
+            return false;
+        }
+        loaded.controls.push_back(control);
+    }
+    *this = std::move(loaded);
+    return true;
+}
+
+std::string CameraCapabilities::cache_dir() {
+    std::string dir;
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME")) {
+        dir = std::string(xdg) + "/mivo";
+    } else if (const char* home = std::getenv("HOME")) {
+        dir = std::string(home) + "/.cache/mivo";
+    } else {
+        dir = "/tmp/mivo";
+    }
+    std::string parent = dir.substr(0, dir.find_last_of('/'));
+    mkdir(parent.c_str(), 0755);
+    mkdir(dir.c_str(), 0755);
+    return dir;
+}
+
+std::string CameraCapabilities::cache_path(const CameraIdentity& identity) {
+    return cache_dir() + "/camera-" + identity.key() + ".bin";
+}
+
+CameraCapabilities CameraCapabilities::load_or_probe(const std::string& device) {
+    CameraCapabilities caps;
+    CameraIdentity current = identify(device);
+    std::string path = cache_path(current);
+
+    if (caps.load(path) && caps.identity.same_device(current)) {
+        caps.identity.bus_info = current.bus_info;  // the port may change, the camera has not
+        std::cout << "Camera capabilities loaded from " << path << std::endl;
+        return caps;
+    }
+    if (caps.probe(device) && !caps.save(path)) {
+        std::cerr << "Failed to write camera cache " << path << std::endl;
+    }
+    return caps;
+}
+
+const CameraMode* CameraCapabilities::find_mode(uint32_t width, uint32_t height) const {
+    const CameraMode* best = nullptr;
+    double best_fps = 0;
+    for (const auto& mode : modes) {
+        if (mode.width != width || mode.height != height || caps_string(mode).empty()) {
+            continue;
+        }
+        for (const auto& ival : mode.intervals) {
+            double fps = ival.first ? double(ival.second) / ival.first : 0;
+            if (fps > best_fps) {
+                best_fps = fps;
+                best = &mode;
+            }
+        }
+    }
+    return best;
+}
+
+// Only raw formats the pipeline can take without a decoder.
+std::string CameraCapabilities::caps_string(const CameraMode& mode, bool lowest_rate) {
+    const char* format = nullptr;
+    switch (mode.fourcc) {
+    case V4L2_PIX_FMT_YUYV: format = "YUY2"; break;
+    case V4L2_PIX_FMT_UYVY: format = "UYVY"; break;
+    case V4L2_PIX_FMT_NV12: format = "NV12"; break;
+    case V4L2_PIX_FMT_YUV420: format = "I420"; break;
+    case V4L2_PIX_FMT_GREY: format = "GRAY8"; break;
+    case V4L2_PIX_FMT_RGB24: format = "RGB"; break;
+    case V4L2_PIX_FMT_BGR24: format = "BGR"; break;
+    default: return "";
+    }
+
+    uint32_t num = 0, den = 0;
+    for (const auto& ival : mode.intervals) {
+        if (!ival.first) {
+            continue;
+        }
+        double fps = double(ival.second) / ival.first;
+        if (!num || (lowest_rate ? fps < double(den) / num : fps > double(den) / num)) {
+            num = ival.first;
+            den = ival.second;
+        }
+    }
+    std::ostringstream caps;
+    caps << "video/x-raw,format=" << format << ",width=" << mode.width << ",height=" << mode.height;
+    if (num) {
+        caps << ",framerate=" << den << "/" << num;
+    }
+    return caps.str();
+}
+
+const CameraControl* CameraCapabilities::find_control(uint32_t id) const {
+    for (const auto& control : controls) {
+        if (control.id == id) {
+            return &control;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,64 @@
+#include "CameraControls.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <iostream>
+#include <linux/videodev2.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+CameraControls::CameraControls(const std::string& device, const CameraCapabilities& caps)
+    : device(device), caps(caps) {}
+
+CameraControls::~CameraControls() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool CameraControls::open_device() {
+    if (fd < 0) {
+        fd = open(device.c_str(), O_RDWR | O_NONBLOCK);
+        if (fd < 0) {
+            perror("Failed to open video device");
+        }
+    }
+    return fd >= 0;
+}
+
+bool CameraControls::set(uint32_t id, int32_t value) {
+    // Controls the cache does not know about are passed through unchecked
+    if (const CameraControl* control = caps.find_control(id)) {
+        value = std::clamp(value, control->minimum, control->maximum);
+        value = control->minimum + (value - control->minimum) / control->step * control->step;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!open_device()) {
+        return false;
+    }
+    struct v4l2_control control = {};
+    control.id = id;
+    control.value = value;
+    if (ioctl(fd, VIDIOC_S_CTRL, &control) < 0) {
+        perror("Failed to set control");
+        return false;
+    }
+    return true;
+}
+
+bool CameraControls::get(uint32_t id, int32_t& value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!open_device()) {
+        return false;
+    }
+    struct v4l2_control control = {};
+    control.id = id;
+    if (ioctl(fd, VIDIOC_G_CTRL, &control) < 0) {
+        perror("Failed to get control");
+        return false;
+    }
+    value = control.value;
+    return true;
+}
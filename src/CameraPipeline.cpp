@@ -0,0 +1,465 @@
+#include "CameraPipeline.h"
+#include "StartupProfiler.h"
+#include "ThreadPolicy.h"
+#include "Tracer.h"
+
+#include <iostream>
+
+CameraPipeline::CameraPipeline(const AppConfig& config) : config(config) {
+    // Formats and controls come from the on-disk cache unless the camera changed
+    {
+    StartupProfiler::Phase phase("camera_caps");
+    camera_caps = CameraCapabilities::load_or_probe(config.device);
+    camera_controls = std::make_unique<CameraControls>(config.device, camera_caps);
+    }
+
+    {
+    StartupProfiler::Phase phase("gst_init");
+    gst_init(nullptr, nullptr);
+    }
+
+    {
+    StartupProfiler::Phase phase("element_create");
+    pipeline = gst_pipeline_new("video-pipeline");
+    capture_options.device = config.device;
+    capture_options.io_mode = parse_io_mode(config.io_mode);
+    capture_options.buffers = config.capture_buffers;
+    capture_options.fake = config.fake_source;
+    capture_options.faults = FaultPlan::parse(config.fake_faults);
+    camera_source = std::make_unique<CameraSource>(capture_options);
+    tee_element = gst_element_factory_make("tee", "tee");
+    }
+
+    if (!pipeline || !camera_source->capture_element() || !tee_element) {
+        std::cerr << "Failed to create GStreamer elements." << std::endl;
+        return;
+    }
+
+    // Set default resolution to 1280x720 or 1920*1080
+    change_resolution(1280, 720);
+
+    gst_bin_add_many(GST_BIN(pipeline), camera_source->bin(), tee_element, nullptr);
+    // Branches such as the recorder come and go at runtime
+    g_object_set(tee_element, "allow-not-linked", TRUE, nullptr);
+    if (!gst_element_link(camera_source->bin(), tee_element)) {
+        std::cerr << "Failed to link GStreamer elements." << std::endl;
+    }
+
+    GstBus *bus = gst_element_get_bus(pipeline);
+    gst_bus_set_sync_handler(bus, &CameraPipeline::on_bus_sync, this, nullptr);
+    bus_watch_id = gst_bus_add_watch(bus, &CameraPipeline::on_bus_message, this);
+    gst_object_unref(bus);
+
+    // On the source bin's ghost pad, so the probe survives source rebuilds
+    gst_pad_add_probe(camera_source->src_pad(), GST_PAD_PROBE_TYPE_BUFFER, &CameraPipeline::on_capture_buffer, this, nullptr);
+
+    // Full, uncropped frames ahead of the tee
+    GstPad *tee_pad = gst_element_get_static_pad(tee_element, "sink");
+    frame_mailbox = std::make_unique<FrameMailbox>(tee_pad);
+    gst_object_unref(tee_pad);
+
+    HdrSettings hdr;
+    hdr.directory = config.captures_dir;
+    hdr.frames = config.hdr_frames;
+    hdr.stops = config.hdr_stops;
+    hdr.budget_ms = config.hdr_budget_ms;
+    hdr.threads = config.hdr_threads;
+    hdr_ = std::make_unique<HdrCapture>(*camera_controls, *frame_mailbox, hdr);
+
+    if (!config.raw_capture_path.empty()) {
+        // Tap before the tee so the store sees exactly what the camera delivered
+        raw_capture = std::make_unique<RawCapture>(camera_source->src_pad(), config.raw_capture_path,
+                                                   config.raw_capture_frames);
+    }
+}
+
+CameraPipeline::~CameraPipeline() {
+    if (bus_watch_id) {
+        g_source_remove(bus_watch_id);
+    }
+    hdr_.reset(); // puts the exposure back if a bracket is running
+    capture_sweep.reset();
+    watchdog.reset();
+    motion_trigger.reset();
+    encoder_tuner.reset();
+    if (timelapse_) {
+        timelapse_->stop_blocking(2 * GST_SECOND);
+        timelapse_.reset();
+    }
+    if (recorder_) {
+        recorder_->stop_blocking(2 * GST_SECOND);
+        recorder_.reset();
+    }
+    if (pipeline) {
+        gst_element_set_state(pipeline, GST_STATE_NULL);
+    }
+    flat_field_.reset(); // its probe does real work, so only once streaming has stopped
+    raw_capture.reset();
+    frame_mailbox.reset();
+    if (pipeline) {
+        gst_object_unref(pipeline);
+    }
+}
+
+void CameraPipeline::start() {
+    if (Tracer::instance().enabled()) {
+        install_trace_probes();
+    }
+
+    {
+    StartupProfiler::Phase phase("state_playing");
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    }
+    std::cout << "Initialise with Streaming..." << std::endl;
+
+    if (config.capture_sweep_seconds > 0) {
+        auto restart = [this](const std::function<void()>& while_stopped) { this->restart(while_stopped); };
+        capture_sweep = std::make_unique<CaptureSweep>(restart, *camera_source, capture_options, metrics_, integrity_,
+                                                       config.capture_sweep_seconds);
+    }
+
+    if (config.watchdog_stall_ms > 0) {
+        watchdog = std::make_unique<PipelineWatchdog>(pipeline, *camera_source, config.watchdog_stall_ms);
+    }
+
+    // After the watchdog: its probe has to see the frames the timelapse drops
+    if (config.timelapse_seconds > 0) {
+        TimelapseSettings settings;
+        settings.directory = config.timelapse_dir;
+        settings.interval_seconds = config.timelapse_seconds;
+        settings.images = config.timelapse_images;
+        settings.playback_fps = config.timelapse_fps;
+        timelapse_ = std::make_unique<Timelapse>(pipeline, tee_element, camera_source->src_pad(), settings);
+        timelapse_->start();
+    }
+
+    // After the timelapse, so frames it drops are not corrected first
+    FlatFieldSettings flat;
+    flat.directory = config.flat_dir.empty() ? CameraCapabilities::cache_dir() : config.flat_dir;
+    flat.camera_key = camera_caps.identity.key();
+    flat.enabled = config.flat_field;
+    flat.threads = config.flat_threads;
+    flat.calibration_frames = config.flat_frames;
+    flat_field_ = std::make_unique<FlatField>(camera_source->src_pad(), *frame_mailbox, flat);
+
+    if (!config.record_dir.empty()) {
+        RecorderSettings settings;
+        settings.directory = config.record_dir;
+        settings.segment_seconds = config.segment_seconds;
+        settings.quota_bytes = (uint64_t)config.record_quota_mb << 20;
+        settings.bitrate_kbps = config.record_bitrate_kbps;
+        settings.threads = config.record_threads;
+        if (config.motion_record) {
+            settings.preroll_seconds = config.motion_preroll;
+        }
+        recorder_ = std::make_unique<Recorder>(pipeline, tee_element, settings);
+        recorder_->set_integrity(&integrity_);
+
+        if (config.motion_record) {
+            MotionSettings motion;
+            motion.pixel_threshold = config.motion_threshold;
+            motion.area_percent = config.motion_area;
+            motion.analysis_fps = config.motion_fps;
+            motion_trigger = std::make_unique<MotionTrigger>(*recorder_, *frame_mailbox, motion, config.motion_postroll);
+        } else {
+            recorder_->start();
+        }
+
+        if (config.record_adaptive) {
+            EncoderBounds bounds;
+            bounds.min_bitrate_kbps = config.record_bitrate_min_kbps;
+            bounds.max_bitrate_kbps = config.record_bitrate_max_kbps;
+            bounds.max_threads = config.record_max_threads;
+            encoder_tuner = std::make_unique<EncoderTuner>(*recorder_, metrics_, bounds);
+        }
+    }
+}
+
+void CameraPipeline::play() {
+    TraceSpan span("state", "play");
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    std::cout << "Pipeline playing..." << std::endl;
+}
+
+void CameraPipeline::pause() {
+    TraceSpan span("state", "pause");
+    gst_element_set_state(pipeline, GST_STATE_PAUSED);
+    std::cout << "Pipeline paused." << std::endl;
+}
+
+// Going through NULL would cut the file branches off without an EOS, and
+// their sinks would then reopen the same files from the start.
+void CameraPipeline::restart(const std::function<void()>& while_stopped) {
+    TraceSpan span("state", "restart");
+    bool recording = recorder_ && recorder_->recording();
+    bool gate_open = recording && recorder_->gate_open();
+    if (recording) {
+        recorder_->stop_blocking(2 * GST_SECOND);
+    }
+    if (timelapse_) {
+        timelapse_->finish_file(2 * GST_SECOND);
+    }
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    if (while_stopped) {
+        while_stopped();
+    }
+    if (timelapse_) {
+        timelapse_->next_file();
+    }
+    if (recording && recorder_->start() && gate_open) {
+        recorder_->open_gate(); // motion had opened it; keep recording
+    }
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+}
+
+bool CameraPipeline::start_recording() {
+    if (!recorder_) {
+        std::cerr << "Recording is not configured (set MIVO_RECORD_DIR)." << std::endl;
+        return false;
+    }
+    if (!recorder_->recording() && !recorder_->start()) {
+        return false;
+    }
+    recorder_->open_gate(); // armed for motion: record now
+    return true;
+}
+
+void CameraPipeline::stop_recording() {
+    if (recorder_ && recorder_->recording()) {
+        recorder_->stop();
+    }
+}
+
+void CameraPipeline::change_resolution(int width, int height) {
+    // With a cached mode the caps are fully fixed (format and rate included),
+    // which leaves v4l2src nothing to search for during negotiation.
+    if (const CameraMode *mode = camera_caps.find_mode(width, height)) {
+        // A timelapse keeps one frame in seconds; the slowest rate saves USB
+        // bandwidth and capture work for the frames it drops anyway
+        std::string fixed = CameraCapabilities::caps_string(*mode, config.timelapse_seconds > 0);
+        GstCaps *caps = gst_caps_from_string(fixed.c_str());
+        camera_source->set_caps(caps);
+        gst_caps_unref(caps);
+        std::cout << "Resolution set to " << fixed << std::endl;
+        return;
+    }
+
+    GstCaps *caps = gst_caps_new_simple(
+        "video/x-raw",
+        "width", G_TYPE_INT, width,
+        "height", G_TYPE_INT, height,
+        // "framerate", GST_TYPE_FRACTION, 60, 1,
+        NULL);
+
+    if (caps) {
+        camera_source->set_caps(caps);
+        gst_caps_unref(caps);
+        std::cout << "Resolution set to " << width << "x" << height << std::endl;
+    } else {
+        std::cerr << "Failed to set resolution." << std::endl;
+    }
+}
+
+const char* CameraPipeline::thread_role(GstElement* owner) {
+    if (camera_source && camera_source->owns(GST_OBJECT(owner))) {
+        return "capture";
+    }
+    const char *name = GST_OBJECT_NAME(owner);
+    if (g_str_has_prefix(name, "display")) {
+        return "display";
+    }
+    if (g_str_has_prefix(name, "record")) {
+        return "record";
+    }
+    return "stream";
+}
+
+GstBusSyncReply CameraPipeline::on_bus_sync(GstBus* bus, GstMessage* message, gpointer user_data) {
+    auto self = static_cast<CameraPipeline*>(user_data);
+
+    // Delivered on the streaming thread itself, right as it starts
+    if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_STREAM_STATUS) {
+        GstStreamStatusType type;
+        GstElement *owner = nullptr;
+        gst_message_parse_stream_status(message, &type, &owner);
+        if (type == GST_STREAM_STATUS_TYPE_ENTER && owner) {
+            ThreadPolicy::instance().adopt_current(self->thread_role(owner));
+        }
+        return GST_BUS_PASS;
+    }
+    if (self->sync_hook) {
+        return self->sync_hook(message);
+    }
+    return GST_BUS_PASS;
+}
+
+gboolean CameraPipeline::on_bus_message(GstBus* bus, GstMessage* message, gpointer user_data) {
+    auto self = static_cast<CameraPipeline*>(user_data);
+    if (self->recorder_ && self->recorder_->handle_message(message)) {
+        return TRUE;
+    }
+    if (self->watchdog && self->watchdog->handle_message(message)) {
+        return TRUE;
+    }
+
+    switch (GST_MESSAGE_TYPE(message)) {
+    case GST_MESSAGE_ERROR: {
+        GError *error = nullptr;
+        gchar *debug = nullptr;
+        gst_message_parse_error(message, &error, &debug);
+        std::cerr << "Error from " << GST_OBJECT_NAME(GST_MESSAGE_SRC(message)) << ": "
+                  << (error ? error->message : "unknown") << std::endl;
+        g_clear_error(&error);
+        g_free(debug);
+        break;
+    }
+    case GST_MESSAGE_STATE_CHANGED:
+        if (GST_MESSAGE_SRC(message) == GST_OBJECT(self->pipeline) && Tracer::instance().enabled()) {
+            GstState old_state, new_state;
+            gst_message_parse_state_changed(message, &old_state, &new_state, nullptr);
+            std::string name = std::string(gst_element_state_get_name(old_state)) + "->" +
+                               gst_element_state_get_name(new_state);
+            Tracer::instance().instant("state", Tracer::instance().intern(name));
+        }
+        break;
+    default:
+        break;
+    }
+    if (self->message_hook) {
+        self->message_hook(message);
+    }
+    return TRUE;
+}
+
+// v4l2src stores the driver's frame sequence number in the buffer offset and
+// the capture timestamp in the PTS; elements downstream copy both along.
+GstPadProbeReturn CameraPipeline::on_capture_buffer(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    auto self = static_cast<CameraPipeline*>(user_data);
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    uint64_t sequence = GST_BUFFER_OFFSET_IS_VALID(buffer) ? GST_BUFFER_OFFSET(buffer) : self->integrity_.captured.load();
+    self->integrity_.on_capture(sequence, GST_BUFFER_PTS_IS_VALID(buffer) ? GST_BUFFER_PTS(buffer) : 0);
+
+    if (self->measure_at_capture) {
+        // No sink: latency is how long the frame took to reach the tee
+        double latency = 0;
+        GstClock *clock = gst_element_get_clock(self->pipeline);
+        if (clock && GST_BUFFER_PTS_IS_VALID(buffer)) {
+            GstClockTime running = gst_clock_get_time(clock) - gst_element_get_base_time(self->pipeline);
+            if (running > GST_BUFFER_PTS(buffer)) {
+                latency = (running - GST_BUFFER_PTS(buffer)) / 1e6;
+            }
+        }
+        if (clock) {
+            gst_object_unref(clock);
+        }
+        self->metrics_.on_frame_rendered(latency);
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+// Every element gets a probe on its sink and src pads. The time from a buffer
+// entering an element to it leaving shows up as a span on the streaming thread.
+// Elements added later (source rebuilds, recorder and timelapse branches) are
+// picked up through deep-element-added.
+void CameraPipeline::install_trace_probes() {
+    GstIterator *it = gst_bin_iterate_recurse(GST_BIN(pipeline));
+    GValue item = G_VALUE_INIT;
+    while (gst_iterator_next(it, &item) == GST_ITERATOR_OK) {
+        trace_element(GST_ELEMENT(g_value_get_object(&item)));
+        g_value_reset(&item);
+    }
+    g_value_unset(&item);
+    gst_iterator_free(it);
+
+    g_signal_connect(pipeline, "deep-element-added", G_CALLBACK(&CameraPipeline::on_element_added), this);
+}
+
+void CameraPipeline::on_element_added(GstBin* bin, GstBin* sub_bin, GstElement* element, gpointer user_data) {
+    auto self = static_cast<CameraPipeline*>(user_data);
+    self->trace_element(element);
+    if (GST_IS_BIN(element)) { // a branch added whole brings its children along
+        GstIterator *it = gst_bin_iterate_recurse(GST_BIN(element));
+        GValue item = G_VALUE_INIT;
+        while (gst_iterator_next(it, &item) == GST_ITERATOR_OK) {
+            self->trace_element(GST_ELEMENT(g_value_get_object(&item)));
+            g_value_reset(&item);
+        }
+        g_value_unset(&item);
+        gst_iterator_free(it);
+    }
+}
+
+void CameraPipeline::trace_element(GstElement* element) {
+    std::lock_guard<std::mutex> guard(trace_mutex);
+    if (g_object_get_data(G_OBJECT(element), "mivo-trace")) {
+        return;
+    }
+    gchar *name = gst_element_get_name(element);
+    trace_points.push_back(std::make_unique<TracePoint>());
+    TracePoint *point = trace_points.back().get();
+    point->element = Tracer::instance().intern(name);
+    g_free(name);
+    g_object_set_data(G_OBJECT(element), "mivo-trace", point);
+
+    // A queue hands buffers to another thread, so sink-to-src is waiting time,
+    // not work; only its src side is marked.
+    GstElementFactory *factory = gst_element_get_factory(element);
+    const gchar *kind = factory ? GST_OBJECT_NAME(factory) : "";
+    bool queue = g_str_equal(kind, "queue") || g_str_equal(kind, "queue2") || g_str_equal(kind, "multiqueue");
+
+    GstPad *pad = gst_element_get_static_pad(element, "src");
+    point->has_src = pad != nullptr;
+    if (pad) {
+        gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, &CameraPipeline::on_trace_src_pad, point, nullptr);
+        gst_object_unref(pad);
+    }
+    pad = queue ? nullptr : gst_element_get_static_pad(element, "sink");
+    if (pad) {
+        point->span = point->has_src;
+        gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, &CameraPipeline::on_trace_sink_pad, point, nullptr);
+        gst_object_unref(pad);
+    }
+}
+
+// Begin times are keyed by PTS: an encoder may hold several frames before the
+// first one comes out, so "the last buffer in" is not the one leaving.
+GstPadProbeReturn CameraPipeline::on_trace_sink_pad(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    auto point = static_cast<TracePoint*>(user_data);
+    if (!point->span) {
+        Tracer::instance().instant("buffer", point->element); // sinks: buffer consumed
+        return GST_PAD_PROBE_OK;
+    }
+    GstClockTime pts = GST_BUFFER_PTS(GST_PAD_PROBE_INFO_BUFFER(info));
+    if (GST_CLOCK_TIME_IS_VALID(pts)) {
+        std::lock_guard<std::mutex> guard(point->lock);
+        point->begins.emplace_back(pts, Tracer::instance().now_us());
+        if (point->begins.size() > 32) {
+            point->begins.pop_front();
+        }
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn CameraPipeline::on_trace_src_pad(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    auto point = static_cast<TracePoint*>(user_data);
+    Tracer& tracer = Tracer::instance();
+    uint64_t begin = 0;
+    GstClockTime pts = GST_BUFFER_PTS(GST_PAD_PROBE_INFO_BUFFER(info));
+    if (point->span && GST_CLOCK_TIME_IS_VALID(pts)) {
+        std::lock_guard<std::mutex> guard(point->lock);
+        for (auto entry = point->begins.begin(); entry != point->begins.end(); ++entry) {
+            if (entry->first == pts) {
+                begin = entry->second;
+                point->begins.erase(point->begins.begin(), entry + 1); // older ones were dropped
+                break;
+            }
+        }
+    }
+    if (begin) {
+        tracer.complete("buffer", point->element, begin, tracer.now_us());
+    } else {
+        tracer.instant("buffer", point->element); // sources, queues, retimed buffers
+    }
+    return GST_PAD_PROBE_OK;
+}
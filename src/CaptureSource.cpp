@@ -0,0 +1,236 @@
+#include "CaptureSource.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+
+IoMode parse_io_mode(const std::string& name) {
+    if (name == "mmap") return IoMode::Mmap;
+    if (name == "userptr") return IoMode::Userptr;
+    if (name == "dmabuf-import") return IoMode::DmabufImport;
+    if (!name.empty() && name != "auto") {
+        std::cerr << "Unknown io-mode '" << name << "', using auto." << std::endl;
+    }
+    return IoMode::Auto;
+}
+
+const char* io_mode_name(IoMode mode) {
+    switch (mode) {
+    case IoMode::Mmap: return "mmap";
+    case IoMode::Userptr: return "userptr";
+    case IoMode::DmabufImport: return "dmabuf-import";
+    default: return "auto";
+    }
+}
+
+static GstPadProbeReturn on_allocation_query(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    GstQuery *query = GST_PAD_PROBE_INFO_QUERY(info);
+    // Only touch the answer on its way back up from downstream
+    if (GST_QUERY_TYPE(query) != GST_QUERY_ALLOCATION || !(GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_PULL)) {
+        return GST_PAD_PROBE_OK;
+    }
+    guint wanted = GPOINTER_TO_UINT(user_data);
+
+    if (gst_query_get_n_allocation_pools(query) > 0) {
+        GstBufferPool *pool = nullptr;
+        guint size, min, max;
+        gst_query_parse_nth_allocation_pool(query, 0, &pool, &size, &min, &max);
+        min = wanted;
+        if (max && max < min) {
+            max = min;
+        }
+        gst_query_set_nth_allocation_pool(query, 0, pool, size, min, max);
+        if (pool) {
+            gst_object_unref(pool);
+        }
+    } else {
+        gst_query_add_allocation_pool(query, nullptr, 0, wanted, 0);
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+void configure_capture_source(GstElement* source, const CaptureOptions& options) {
+    g_object_set(source, "device", options.device.c_str(), "io-mode", (gint)options.io_mode, nullptr);
+
+    // Reconfiguring replaces the previous probe rather than stacking another
+    GstPad *pad = gst_element_get_static_pad(source, "src");
+    gulong probe = GPOINTER_TO_SIZE(g_object_get_data(G_OBJECT(source), "mivo-allocation-probe"));
+    if (probe) {
+        gst_pad_remove_probe(pad, probe);
+        probe = 0;
+    }
+    if (options.buffers > 0) {
+        probe = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_QUERY_DOWNSTREAM, &on_allocation_query,
+                                  GUINT_TO_POINTER(options.buffers), nullptr);
+    }
+    g_object_set_data(G_OBJECT(source), "mivo-allocation-probe", GSIZE_TO_POINTER(probe));
+    gst_object_unref(pad);
+
+    std::cout << "Capture " << options.device << ": io-mode " << io_mode_name(options.io_mode) << ", "
+              << (options.buffers > 0 ? std::to_string(options.buffers) : std::string("default"))
+              << " buffers" << std::endl;
+}
+
+// "kind:after_ms[:duration_ms]"; anything malformed injects no fault at all
+// rather than firing at 0 ms.
+FaultPlan FaultPlan::parse(const std::string& spec) {
+    FaultPlan plan;
+    if (spec.empty() || spec == "none") {
+        return plan;
+    }
+    size_t pos = spec.find(':');
+    std::string kind = spec.substr(0, pos);
+    Kind parsed;
+    if (kind == "stall") {
+        parsed = Kind::Stall;
+    } else if (kind == "error") {
+        parsed = Kind::Error;
+    } else if (kind == "eos") {
+        parsed = Kind::Eos;
+    } else {
+        std::cerr << "Unknown fault '" << spec << "', injecting none." << std::endl;
+        return plan;
+    }
+
+    int values[2] = {0, 0};
+    int count = 0;
+    while (pos != std::string::npos) {
+        const char *begin = spec.c_str() + pos + 1;
+        char *end = nullptr;
+        errno = 0;
+        long value = std::strtol(begin, &end, 10);
+        if (count == 2 || end == begin || (*end && *end != ':') || errno == ERANGE || value < 0 ||
+            value > 24L * 3600 * 1000) {
+            std::cerr << "Malformed fault '" << spec << "', injecting none." << std::endl;
+            return plan;
+        }
+        values[count++] = (int)value;
+        pos = spec.find(':', pos + 1);
+    }
+    if (count < (parsed == Kind::Stall ? 2 : 1)) {
+        std::cerr << "Fault '" << spec << "' is missing its times, injecting none." << std::endl;
+        return plan;
+    }
+    plan.kind = parsed;
+    plan.after_ms = values[0];
+    plan.duration_ms = values[1];
+    return plan;
+}
+
+CameraSource::CameraSource(const CaptureOptions& options) : options(options) {
+    element = gst_bin_new("source_bin");
+    ghost = gst_ghost_pad_new_no_target("src", GST_PAD_SRC);
+    gst_element_add_pad(element, ghost);
+    build();
+}
+
+CameraSource::~CameraSource() {
+    if (caps) {
+        gst_caps_unref(caps);
+    }
+}
+
+bool CameraSource::build() {
+    if (options.fake) {
+        source = gst_element_factory_make("videotestsrc", nullptr);
+        if (source) {
+            g_object_set(source, "is-live", TRUE, "pattern", 18 /* ball */, nullptr);
+        }
+    } else {
+        source = gst_element_factory_make("v4l2src", nullptr);
+    }
+    capsfilter = gst_element_factory_make("capsfilter", nullptr);
+    if (!source || !capsfilter) {
+        std::cerr << "Failed to create capture elements." << std::endl;
+        return false;
+    }
+
+    if (options.fake) {
+        fake_start_ns = 0;
+        fake_failed = false;
+        GstPad *pad = gst_element_get_static_pad(source, "src");
+        gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, &CameraSource::on_fake_buffer, this, nullptr);
+        gst_object_unref(pad);
+    } else {
+        configure_capture_source(source, options);
+    }
+    if (caps) {
+        g_object_set(capsfilter, "caps", caps, nullptr);
+    }
+
+    gst_bin_add_many(GST_BIN(element), source, capsfilter, nullptr);
+    if (!gst_element_link(source, capsfilter)) {
+        std::cerr << "Failed to link capture elements." << std::endl;
+        return false;
+    }
+    GstPad *target = gst_element_get_static_pad(capsfilter, "src");
+    gst_ghost_pad_set_target(GST_GHOST_PAD(ghost), target);
+    gst_object_unref(target);
+    return true;
+}
+
+void CameraSource::set_caps(GstCaps* new_caps) {
+    gst_caps_replace(&caps, new_caps);
+    if (capsfilter) {
+        g_object_set(capsfilter, "caps", caps, nullptr);
+    }
+}
+
+void CameraSource::set_options(const CaptureOptions& new_options) {
+    options = new_options;
+    if (source && !options.fake) {
+        configure_capture_source(source, options);
+    }
+}
+
+// Drops the old elements and starts fresh ones in the bin's current state.
+bool CameraSource::rebuild() {
+    for (GstElement *e : {source, capsfilter}) {
+        if (e) {
+            gst_element_set_state(e, GST_STATE_NULL);
+            gst_bin_remove(GST_BIN(element), e);
+        }
+    }
+    source = capsfilter = nullptr;
+
+    if (!build()) {
+        return false;
+    }
+    gst_element_sync_state_with_parent(capsfilter);
+    gst_element_sync_state_with_parent(source);
+    return true;
+}
+
+bool CameraSource::owns(GstObject* object) const {
+    return object == GST_OBJECT(element) || gst_object_has_as_ancestor(object, GST_OBJECT(element));
+}
+
+GstPadProbeReturn CameraSource::on_fake_buffer(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    auto self = static_cast<CameraSource*>(user_data);
+    const FaultPlan& plan = self->options.faults;
+    uint64_t now = g_get_monotonic_time() * 1000;
+    if (!self->fake_start_ns) {
+        self->fake_start_ns = now;
+    }
+    if (self->fake_failed) {
+        return GST_PAD_PROBE_DROP;
+    }
+
+    uint64_t elapsed_ms = (now - self->fake_start_ns) / 1000000;
+    if (plan.kind == FaultPlan::Kind::None || elapsed_ms < (uint64_t)plan.after_ms) {
+        return GST_PAD_PROBE_OK;
+    }
+    if (plan.kind == FaultPlan::Kind::Stall) {
+        return elapsed_ms < (uint64_t)(plan.after_ms + plan.duration_ms) ? GST_PAD_PROBE_DROP : GST_PAD_PROBE_OK;
+    }
+
+    // Error and EOS: fail the push the way a dead device does, so basesrc
+    // itself posts the error (for a flow error) and sends EOS downstream.
+    // Any buffers after that are dropped until the source is rebuilt.
+    self->fake_failed = true;
+    std::cout << "Injecting capture fault: " << (plan.kind == FaultPlan::Kind::Error ? "flow error" : "EOS")
+              << std::endl;
+    gst_buffer_unref(GST_PAD_PROBE_INFO_BUFFER(info));
+    GST_PAD_PROBE_INFO_FLOW_RETURN(info) = plan.kind == FaultPlan::Kind::Error ? GST_FLOW_ERROR : GST_FLOW_EOS;
+    return GST_PAD_PROBE_HANDLED;
+}
@@ -0,0 +1,133 @@
+#include "CaptureSweep.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+CaptureSweep::CaptureSweep(Restart restart, CameraSource& source, const CaptureOptions& base,
+                           const PipelineMetrics& metrics, const FrameIntegrity& integrity, int seconds_per_setting)
+    : restart(std::move(restart)), source(source), metrics(metrics), integrity(integrity),
+      seconds_per_setting(seconds_per_setting) {
+    for (IoMode mode : {IoMode::Mmap, IoMode::Userptr, IoMode::DmabufImport}) {
+        for (int buffers : {2, 3, 4, 6}) {
+            Result result;
+            result.options = base;
+            result.options.io_mode = mode;
+            result.options.buffers = buffers;
+            results.push_back(result);
+        }
+    }
+    std::cout << "Capture sweep: " << results.size() << " settings, " << seconds_per_setting
+              << " s each." << std::endl;
+
+    apply(results[0].options);
+    timer_id = g_timeout_add(sample_ms, &CaptureSweep::on_tick, this);
+}
+
+CaptureSweep::~CaptureSweep() {
+    if (timer_id) {
+        g_source_remove(timer_id);
+    }
+}
+
+gboolean CaptureSweep::on_tick(gpointer user_data) {
+    auto self = static_cast<CaptureSweep*>(user_data);
+    if (!self->tick()) {
+        self->timer_id = 0;
+        return G_SOURCE_REMOVE;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+// io-mode can only change in NULL, so each setting restarts the pipeline.
+void CaptureSweep::apply(const CaptureOptions& options) {
+    restart([this, &options]() { source.set_options(options); });
+    phase_start = std::chrono::steady_clock::now();
+    measuring = false;
+}
+
+void CaptureSweep::begin_measurement() {
+    measuring = true;
+    phase_start = std::chrono::steady_clock::now();
+    start_captured = integrity.captured;
+    start_lost = integrity.sensor_drops + integrity.pipeline_drops;
+    start_late = metrics.frames_dropped;
+}
+
+bool CaptureSweep::tick() {
+    auto elapsed = std::chrono::steady_clock::now() - phase_start;
+
+    // Skip the first second: device open and negotiation are not steady state
+    if (!measuring) {
+        if (elapsed >= std::chrono::milliseconds(warmup_ms)) {
+            begin_measurement();
+        }
+        return true;
+    }
+
+    Result& result = results[current];
+    result.latency_sum += metrics.latency_ms;
+    result.latency_samples++;
+
+    if (elapsed < std::chrono::seconds(seconds_per_setting)) {
+        return true;
+    }
+
+    uint64_t late = metrics.frames_dropped;
+    result.frames = integrity.captured - start_captured;
+    result.dropped = integrity.sensor_drops + integrity.pipeline_drops - start_lost +
+                     (late >= start_late ? late - start_late : late);
+    result.started = result.frames > 0;
+
+    std::cout << "Capture sweep: " << io_mode_name(result.options.io_mode) << " x" << result.options.buffers
+              << (result.started ? " done" : " produced no frames") << std::endl;
+
+    if (++current < results.size()) {
+        apply(results[current].options);
+        return true;
+    }
+    report();
+    return false;
+}
+
+// Lowest latency among the settings whose drop rate is within half a percent
+// of the best one.
+void CaptureSweep::report() {
+    std::cout << "Capture sweep results:" << std::endl;
+    std::cout << "  io-mode        buffers  latency(ms)  drop rate" << std::endl;
+
+    double best_drop_rate = 1.0;
+    for (const auto& r : results) {
+        if (r.started) {
+            best_drop_rate = std::min(best_drop_rate, r.drop_rate());
+        }
+    }
+
+    const Result* best = nullptr;
+    for (const auto& r : results) {
+        std::cout << "  " << std::left << std::setw(15) << io_mode_name(r.options.io_mode) << std::right
+                  << std::setw(7) << r.options.buffers;
+        if (!r.started) {
+            std::cout << "  unsupported" << std::endl;
+            continue;
+        }
+        std::cout << std::fixed << std::setprecision(1) << std::setw(13) << r.latency()
+                  << std::setprecision(2) << std::setw(10) << r.drop_rate() * 100 << "%" << std::endl;
+
+        if (r.drop_rate() <= best_drop_rate + 0.005 && (!best || r.latency() < best->latency())) {
+            best = &r;
+        }
+    }
+
+    if (!best) {
+        std::cout << "No setting produced frames; keeping the driver defaults." << std::endl;
+        CaptureOptions fallback = results[0].options;
+        fallback.io_mode = IoMode::Auto;
+        fallback.buffers = 0;
+        apply(fallback);
+        return;
+    }
+    std::cout << "Recommended for this camera: MIVO_IO_MODE=" << io_mode_name(best->options.io_mode)
+              << " MIVO_CAPTURE_BUFFERS=" << best->options.buffers << std::endl;
+    apply(best->options);
+}
@@ -0,0 +1,189 @@
+#include "CompareKernels.h"
+
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+#if defined(__ARM_NEON)
+// Horizontal adds: vaddlv only exists on AArch64; 32-bit ARM folds with
+// pairwise widening adds instead.
+inline uint32_t add_lanes(uint8x8_t v) {
+#if defined(__aarch64__)
+    return vaddlv_u8(v);
+#else
+    return (uint32_t)vget_lane_u64(vpaddl_u32(vpaddl_u16(vpaddl_u8(v))), 0);
+#endif
+}
+
+inline uint32_t add_lanes(uint16x8_t v) {
+#if defined(__aarch64__)
+    return vaddlvq_u16(v);
+#else
+    uint64x2_t sum = vpaddlq_u32(vpaddlq_u16(v));
+    return (uint32_t)(vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1));
+#endif
+}
+
+inline uint64_t add_lanes(uint32x4_t v) {
+#if defined(__aarch64__)
+    return vaddlvq_u32(v);
+#else
+    uint64x2_t sum = vpaddlq_u32(v);
+    return vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1);
+#endif
+}
+#endif
+
+// Sums over one 8-pixel row of a block
+struct BlockSums {
+    uint32_t a = 0, b = 0, aa = 0, bb = 0, ab = 0;
+};
+
+inline void add_block_row(const uint8_t* a, const uint8_t* b, BlockSums& s) {
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    __m128i va = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(a));
+    __m128i vb = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(b));
+    s.a += (uint32_t)_mm_cvtsi128_si32(_mm_sad_epu8(va, zero));
+    s.b += (uint32_t)_mm_cvtsi128_si32(_mm_sad_epu8(vb, zero));
+    __m128i wa = _mm_unpacklo_epi8(va, zero), wb = _mm_unpacklo_epi8(vb, zero);
+    // Four 32-bit lanes each holding two products; fold them
+    __m128i products[3] = {_mm_madd_epi16(wa, wa), _mm_madd_epi16(wb, wb), _mm_madd_epi16(wa, wb)};
+    uint32_t totals[3];
+    for (int i = 0; i < 3; ++i) {
+        __m128i v = _mm_add_epi32(products[i], _mm_shuffle_epi32(products[i], _MM_SHUFFLE(1, 0, 3, 2)));
+        v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+        totals[i] = (uint32_t)_mm_cvtsi128_si32(v);
+    }
+    s.aa += totals[0];
+    s.bb += totals[1];
+    s.ab += totals[2];
+#elif defined(__ARM_NEON)
+    uint8x8_t va = vld1_u8(a), vb = vld1_u8(b);
+    s.a += add_lanes(va);
+    s.b += add_lanes(vb);
+    s.aa += add_lanes(vmull_u8(va, va));
+    s.bb += add_lanes(vmull_u8(vb, vb));
+    s.ab += add_lanes(vmull_u8(va, vb));
+#else
+    for (int i = 0; i < 8; ++i) {
+        s.a += a[i];
+        s.b += b[i];
+        s.aa += a[i] * a[i];
+        s.bb += b[i] * b[i];
+        s.ab += a[i] * b[i];
+    }
+#endif
+}
+
+} // namespace
+
+uint64_t sum_squared_diff(const uint8_t* a, const uint8_t* b, size_t n) {
+    uint64_t total = 0;
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    // 32-bit lanes take at most 2 * 255^2 per step; flush well before overflow
+    while (i + 16 <= n) {
+        __m128i acc = zero;
+        size_t end = i + 16 * 4096 < n ? i + 16 * 4096 : n;
+        for (; i + 16 <= end; i += 16) {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+            __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+            __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+            acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi)));
+        }
+        uint32_t lanes[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+        total += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+#elif defined(__ARM_NEON)
+    while (i + 16 <= n) {
+        uint32x4_t acc = vdupq_n_u32(0);
+        size_t end = i + 16 * 4096 < n ? i + 16 * 4096 : n;
+        for (; i + 16 <= end; i += 16) {
+            uint8x16_t d = vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+            acc = vpadalq_u16(acc, vmull_u8(vget_low_u8(d), vget_low_u8(d)));
+            acc = vpadalq_u16(acc, vmull_u8(vget_high_u8(d), vget_high_u8(d)));
+        }
+        total += add_lanes(acc);
+    }
+#endif
+    for (; i < n; ++i) {
+        int d = (int)a[i] - (int)b[i];
+        total += (uint64_t)(d * d);
+    }
+    return total;
+}
+
+double psnr_from_ssd(uint64_t ssd, size_t n) {
+    if (ssd == 0 || n == 0) {
+        return 99;
+    }
+    double mse = (double)ssd / n;
+    return 10 * std::log10(255.0 * 255.0 / mse);
+}
+
+double mean_ssim(const uint8_t* a, const uint8_t* b, int width, int height) {
+    const double c1 = (0.01 * 255) * (0.01 * 255), c2 = (0.03 * 255) * (0.03 * 255);
+    const double count = 64;
+    double total = 0;
+    int blocks = 0;
+    for (int by = 0; by + 8 <= height; by += 8) {
+        for (int bx = 0; bx + 8 <= width; bx += 8) {
+            BlockSums s;
+            for (int row = 0; row < 8; ++row) {
+                size_t offset = (size_t)(by + row) * width + bx;
+                add_block_row(a + offset, b + offset, s);
+            }
+            double mean_a = s.a / count, mean_b = s.b / count;
+            double var_a = s.aa / count - mean_a * mean_a;
+            double var_b = s.bb / count - mean_b * mean_b;
+            double cov = s.ab / count - mean_a * mean_b;
+            total += ((2 * mean_a * mean_b + c1) * (2 * cov + c2)) /
+                     ((mean_a * mean_a + mean_b * mean_b + c1) * (var_a + var_b + c2));
+            ++blocks;
+        }
+    }
+    return blocks ? total / blocks : 1;
+}
+
+void diff_bgrx_row(uint8_t* dst, const uint8_t* ref, int pixels, int gain_shift) {
+    int x = 0;
+#if defined(__SSE2__)
+    const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+    for (; x + 4 <= pixels; x += 4) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + x * 4));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ref + x * 4));
+        __m128i d = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+        for (int i = 0; i < gain_shift; ++i) {
+            d = _mm_adds_epu8(d, d);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), _mm_or_si128(d, opaque));
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t opaque = vreinterpretq_u8_u32(vdupq_n_u32(0xFF000000));
+    for (; x + 4 <= pixels; x += 4) {
+        uint8x16_t d = vabdq_u8(vld1q_u8(dst + x * 4), vld1q_u8(ref + x * 4));
+        for (int i = 0; i < gain_shift; ++i) {
+            d = vqaddq_u8(d, d);
+        }
+        vst1q_u8(dst + x * 4, vorrq_u8(d, opaque));
+    }
+#endif
+    for (; x < pixels; ++x) {
+        for (int c = 0; c < 3; ++c) {
+            int d = dst[x * 4 + c] > ref[x * 4 + c] ? dst[x * 4 + c] - ref[x * 4 + c] : ref[x * 4 + c] - dst[x * 4 + c];
+            d <<= gain_shift;
+            dst[x * 4 + c] = (uint8_t)(d > 255 ? 255 : d);
+        }
+        dst[x * 4 + 3] = 0xFF;
+    }
+}
@@ -0,0 +1,108 @@
+#include "Config.h"
+
+#include <cstdlib>
+#include <iostream>
+
+bool env_bool(const char* name, bool fallback) {
+    const char* value = std::getenv(name);
+    if (!value || !*value) {
+        return fallback;
+    }
+    std::string v(value);
+    return !(v == "0" || v == "false" || v == "no" || v == "off");
+}
+
+int env_int(const char* name, int fallback) {
+    const char* value = std::getenv(name);
+    if (!value || !*value) {
+        return fallback;
+    }
+    try {
+        return std::stoi(value);
+    } catch (const std::exception&) {
+        std::cerr << "Ignoring invalid " << name << "=" << value << std::endl;
+        return fallback;
+    }
+}
+
+double env_double(const char* name, double fallback) {
+    const char* value = std::getenv(name);
+    if (!value || !*value) {
+        return fallback;
+    }
+    try {
+        return std::stod(value);
+    } catch (const std::exception&) {
+        std::cerr << "Ignoring invalid " << name << "=" << value << std::endl;
+        return fallback;
+    }
+}
+
+std::string env_string(const char* name, const std::string& fallback) {
+    const char* value = std::getenv(name);
+    return (value && *value) ? std::string(value) : fallback;
+}
+
+AppConfig AppConfig::from_env() {
+    AppConfig config;
+    config.device = env_string("MIVO_DEVICE", config.device);
+    config.io_mode = env_string("MIVO_IO_MODE", config.io_mode);
+    config.capture_buffers = env_int("MIVO_CAPTURE_BUFFERS", config.capture_buffers);
+    config.capture_sweep_seconds = env_int("MIVO_CAPTURE_SWEEP", config.capture_sweep_seconds);
+    config.watchdog_stall_ms = env_int("MIVO_WATCHDOG_MS", config.watchdog_stall_ms);
+    config.fake_source = env_bool("MIVO_FAKE_SOURCE", config.fake_source);
+    config.fake_faults = env_string("MIVO_FAKE_FAULTS", config.fake_faults);
+    config.thread_cpus = env_string("MIVO_THREAD_CPUS", config.thread_cpus);
+    config.thread_priorities = env_string("MIVO_THREAD_PRIO", config.thread_priorities);
+    config.thread_report_seconds = env_int("MIVO_THREAD_REPORT", config.thread_report_seconds);
+    config.headless = env_bool("MIVO_HEADLESS", config.headless);
+    config.control_socket = env_string("MIVO_CONTROL_SOCKET", config.control_socket);
+    config.display_scale = env_bool("MIVO_DISPLAY_SCALE", config.display_scale);
+    config.display_mode = env_string("MIVO_DISPLAY_MODE", config.display_mode);
+    config.hud = env_bool("MIVO_HUD", config.hud);
+    config.scope = env_string("MIVO_SCOPE", config.scope);
+    config.exposure_warning = env_string("MIVO_EXPOSURE_WARNING", config.exposure_warning);
+    config.scope_every = env_int("MIVO_SCOPE_EVERY", config.scope_every);
+    config.zebra_percent = env_int("MIVO_ZEBRA_LEVEL", config.zebra_percent);
+    config.scope_threads = env_int("MIVO_SCOPE_THREADS", config.scope_threads);
+    config.reference_path = env_string("MIVO_REFERENCE", config.reference_path);
+    config.trace_path = env_string("MIVO_TRACE", config.trace_path);
+    config.record_dir = env_string("MIVO_RECORD_DIR", config.record_dir);
+    config.segment_seconds = env_int("MIVO_SEGMENT_SECONDS", config.segment_seconds);
+    config.record_quota_mb = env_int("MIVO_RECORD_QUOTA_MB", config.record_quota_mb);
+    config.record_bitrate_kbps = env_int("MIVO_RECORD_BITRATE", config.record_bitrate_kbps);
+    config.record_adaptive = env_bool("MIVO_RECORD_ADAPTIVE", config.record_adaptive);
+    config.record_bitrate_min_kbps = env_int("MIVO_RECORD_BITRATE_MIN", config.record_bitrate_min_kbps);
+    config.record_bitrate_max_kbps = env_int("MIVO_RECORD_BITRATE_MAX", config.record_bitrate_max_kbps);
+    config.record_threads = env_int("MIVO_RECORD_THREADS", config.record_threads);
+    config.record_max_threads = env_int("MIVO_RECORD_MAX_THREADS", config.record_max_threads);
+    config.captures_dir = env_string("MIVO_CAPTURES_DIR", config.captures_dir);
+    config.gallery_cache_mb = env_int("MIVO_GALLERY_CACHE_MB", config.gallery_cache_mb);
+    config.motion_record = env_bool("MIVO_MOTION", config.motion_record);
+    config.motion_threshold = env_int("MIVO_MOTION_THRESHOLD", config.motion_threshold);
+    config.motion_area = env_double("MIVO_MOTION_AREA", config.motion_area);
+    config.motion_fps = env_int("MIVO_MOTION_FPS", config.motion_fps);
+    config.motion_preroll = env_int("MIVO_MOTION_PREROLL", config.motion_preroll);
+    config.motion_postroll = env_int("MIVO_MOTION_POSTROLL", config.motion_postroll);
+    config.timelapse_seconds = env_int("MIVO_TIMELAPSE", config.timelapse_seconds);
+    config.timelapse_dir = env_string("MIVO_TIMELAPSE_DIR", config.timelapse_dir);
+    config.timelapse_images = env_bool("MIVO_TIMELAPSE_IMAGES", config.timelapse_images);
+    config.timelapse_fps = env_int("MIVO_TIMELAPSE_FPS", config.timelapse_fps);
+    config.flat_field = env_bool("MIVO_FLAT_FIELD", config.flat_field);
+    config.flat_threads = env_int("MIVO_FLAT_THREADS", config.flat_threads);
+    config.flat_frames = env_int("MIVO_FLAT_FRAMES", config.flat_frames);
+    config.flat_dir = env_string("MIVO_FLAT_DIR", config.flat_dir);
+    config.lens_k1 = env_double("MIVO_LENS_K1", config.lens_k1);
+    config.lens_k2 = env_double("MIVO_LENS_K2", config.lens_k2);
+    config.lens_threads = env_int("MIVO_LENS_THREADS", config.lens_threads);
+    config.stabilize = env_bool("MIVO_STABILIZE", config.stabilize);
+    config.stabilize_smoothing = env_double("MIVO_STABILIZE_SMOOTHING", config.stabilize_smoothing);
+    config.mosaic_scale = env_double("MIVO_MOSAIC_SCALE", config.mosaic_scale);
+    config.hdr_frames = env_int("MIVO_HDR_FRAMES", config.hdr_frames);
+    config.hdr_stops = env_double("MIVO_HDR_STOPS", config.hdr_stops);
+    config.hdr_budget_ms = env_int("MIVO_HDR_BUDGET_MS", config.hdr_budget_ms);
+    config.hdr_threads = env_int("MIVO_HDR_THREADS", config.hdr_threads);
+    config.raw_capture_path = env_string("MIVO_RAW_CAPTURE", config.raw_capture_path);
+    config.raw_capture_frames = env_int("MIVO_RAW_FRAMES", config.raw_capture_frames);
+    return config;
+}
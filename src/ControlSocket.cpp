@@ -0,0 +1,104 @@
+#include "ControlSocket.h"
+
+#include <glib-unix.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+ControlSocket::ControlSocket(const std::string& path, Handler handler) : path(path), handler(std::move(handler)) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Control socket path too long: " << path << std::endl;
+        return;
+    }
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (listen_fd < 0) {
+        std::cerr << "Control socket: " << strerror(errno) << std::endl;
+        return;
+    }
+    unlink(path.c_str()); // left over from a previous run
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listen_fd, 4) < 0) {
+        std::cerr << "Control socket " << path << ": " << strerror(errno) << std::endl;
+        close(listen_fd);
+        listen_fd = -1;
+        return;
+    }
+    listen_source = g_unix_fd_add(listen_fd, G_IO_IN, &ControlSocket::on_accept, this);
+    std::cout << "Listening for commands on " << path << std::endl;
+}
+
+ControlSocket::~ControlSocket() {
+    while (!clients.empty()) {
+        close_client(clients.begin()->first);
+    }
+    if (listen_source) {
+        g_source_remove(listen_source);
+    }
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        unlink(path.c_str());
+    }
+}
+
+gboolean ControlSocket::on_accept(gint fd, GIOCondition condition, gpointer user_data) {
+    auto self = static_cast<ControlSocket*>(user_data);
+    int client = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+    if (client >= 0) {
+        self->clients[client].source = g_unix_fd_add(client, (GIOCondition)(G_IO_IN | G_IO_HUP | G_IO_ERR),
+                                                     &ControlSocket::on_client, self);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+gboolean ControlSocket::on_client(gint fd, GIOCondition condition, gpointer user_data) {
+    auto self = static_cast<ControlSocket*>(user_data);
+    char data[512];
+    ssize_t n = read(fd, data, sizeof(data));
+    if (n <= 0) {
+        if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+            return G_SOURCE_CONTINUE;
+        }
+        self->clients[fd].source = 0; // removed by returning G_SOURCE_REMOVE
+        self->close_client(fd);
+        return G_SOURCE_REMOVE;
+    }
+
+    std::string& pending = self->clients[fd].pending;
+    pending.append(data, n);
+    size_t newline;
+    while ((newline = pending.find('\n')) != std::string::npos) {
+        std::string command = pending.substr(0, newline);
+        pending.erase(0, newline + 1);
+        if (!command.empty() && command.back() == '\r') {
+            command.pop_back();
+        }
+        std::string reply = self->handler(command) + "\n";
+        // Replies are short; a client that doesn't read them just loses them
+        if (write(fd, reply.data(), reply.size()) < 0 && errno != EAGAIN) {
+            break;
+        }
+    }
+    if (pending.size() > 4096) {
+        pending.clear(); // no newline in sight, not a command
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+void ControlSocket::close_client(int fd) {
+    auto it = clients.find(fd);
+    if (it == clients.end()) {
+        return;
+    }
+    if (it->second.source) {
+        g_source_remove(it->second.source);
+    }
+    close(fd);
+    clients.erase(it);
+}
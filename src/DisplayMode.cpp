@@ -0,0 +1,42 @@
+#include "DisplayMode.h"
+
+#include <iostream>
+
+const std::vector<DisplayMode>& display_modes() {
+    static const std::vector<DisplayMode> modes = {
+        // Without sync the sink never measures lateness, so QoS and
+        // max-lateness would do nothing; the leaky queue is what drops
+        {"low-latency", false, false, -1, 1, true},
+        {"balanced", true, true, 20 * GST_MSECOND, 2, true},
+        {"smooth", true, false, -1, 6, false},
+    };
+    return modes;
+}
+
+int find_display_mode(const std::string& name) {
+    const auto& modes = display_modes();
+    for (size_t i = 0; i < modes.size(); ++i) {
+        if (name == modes[i].name) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+void apply_display_mode(const DisplayMode& mode, GstElement* queue, GstElement* sink) {
+    // Depth in buffers only; the default byte and time limits would cap it first
+    g_object_set(queue,
+                 "max-size-buffers", mode.queue_buffers,
+                 "max-size-bytes", 0,
+                 "max-size-time", (guint64)0,
+                 "leaky", mode.leaky ? 2 : 0, // 2 = downstream: drop the oldest
+                 nullptr);
+    g_object_set(sink,
+                 "sync", mode.sync,
+                 "qos", mode.qos,
+                 "max-lateness", mode.max_lateness_ns,
+                 nullptr);
+    std::cout << "Display mode: " << mode.name << " (sync " << (mode.sync ? "on" : "off")
+              << ", qos " << (mode.qos ? "on" : "off")
+              << ", queue " << mode.queue_buffers << (mode.leaky ? " leaky" : "") << ")" << std::endl;
+}
@@ -0,0 +1,143 @@
+#include "EncoderTuner.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+static const char* preset_name(int preset) {
+    static const char* names[] = {"none", "ultrafast", "superfast", "veryfast", "faster",
+                                  "fast", "medium", "slow", "slower", "veryslow", "placebo"};
+    return (preset >= 0 && preset <= 10) ? names[preset] : "?";
+}
+
+EncoderTuner::EncoderTuner(Recorder& recorder, const PipelineMetrics& metrics, const EncoderBounds& bounds)
+    : recorder(recorder), metrics(metrics), bounds(bounds),
+      last_restart(std::chrono::steady_clock::now()) {
+    last_display_dropped = metrics.frames_dropped;
+    // The steps below assume the bitrate starts inside the bounds
+    int configured = recorder.current_settings().bitrate_kbps;
+    int bitrate = std::max(bounds.min_bitrate_kbps, std::min(configured, bounds.max_bitrate_kbps));
+    if (bitrate != configured) {
+        recorder.set_bitrate(bitrate);
+        std::cout << "Encoder tuner: bitrate " << configured << " kbps is outside " << bounds.min_bitrate_kbps << "-"
+                  << bounds.max_bitrate_kbps << " kbps, starting at " << bitrate << " kbps." << std::endl;
+    }
+    idle_fraction(); // first sample
+    timer_id = g_timeout_add_seconds(interval_seconds, &EncoderTuner::on_tick, this);
+}
+
+EncoderTuner::~EncoderTuner() {
+    if (timer_id) {
+        g_source_remove(timer_id);
+    }
+}
+
+gboolean EncoderTuner::on_tick(gpointer user_data) {
+    static_cast<EncoderTuner*>(user_data)->evaluate();
+    return G_SOURCE_CONTINUE;
+}
+
+bool EncoderTuner::can_restart() const {
+    return std::chrono::steady_clock::now() - last_restart >= std::chrono::seconds(restart_holdoff_seconds);
+}
+
+// Share of all CPUs idle since the previous call, from /proc/stat (idle and
+// iowait against the total); 0 if unknown.
+double EncoderTuner::idle_fraction() {
+    std::ifstream in("/proc/stat");
+    std::string cpu;
+    uint64_t value, total = 0, idle = 0;
+    in >> cpu;
+    for (int i = 0; i < 8 && in >> value; ++i) {
+        total += value;
+        if (i == 3 || i == 4) {
+            idle += value;
+        }
+    }
+    double fraction = 0;
+    if (cpu == "cpu" && total > last_cpu_total && last_cpu_total) {
+        fraction = double(idle - last_cpu_idle) / (total - last_cpu_total);
+    }
+    last_cpu_total = total;
+    last_cpu_idle = idle;
+    return fraction;
+}
+
+void EncoderTuner::restart_with(int preset, int threads, const char* reason) {
+    const RecorderSettings& current = recorder.current_settings();
+    std::cout << "Encoder tuner: " << reason << ", preset " << preset_name(current.speed_preset)
+              << " -> " << preset_name(preset) << ", threads " << current.threads << " -> " << threads
+              << std::endl;
+    recorder.reconfigure(preset, threads);
+    last_restart = std::chrono::steady_clock::now();
+}
+
+void EncoderTuner::evaluate() {
+    if (!recorder.recording()) {
+        return;
+    }
+
+    uint64_t offered = recorder.frames_offered;
+    uint64_t encoded = recorder.frames_encoded;
+    uint64_t display_dropped = metrics.frames_dropped;
+    double idle = idle_fraction();
+
+    // Counters restart with each branch rebuild
+    if (offered < last_offered || encoded < last_encoded) {
+        last_offered = offered;
+        last_encoded = encoded;
+        return;
+    }
+
+    double in_fps = double(offered - last_offered) / interval_seconds;
+    double out_fps = double(encoded - last_encoded) / interval_seconds;
+    double fill = recorder.queue_fill();
+    uint64_t new_drops = display_dropped - last_display_dropped;
+
+    last_offered = offered;
+    last_encoded = encoded;
+    last_display_dropped = display_dropped;
+
+    const RecorderSettings& current = recorder.current_settings();
+    bool behind = in_fps > 0 && out_fps < in_fps * 0.95;
+    bool pressure = new_drops > 0 || fill > 0.5 || behind;
+
+    std::ostringstream measured;
+    measured << std::fixed << std::setprecision(1) << "in " << in_fps << " fps, out " << out_fps
+             << " fps, queue " << int(fill * 100) << "%, display drops +" << new_drops << ", idle "
+             << int(idle * 100) << "%";
+
+    if (pressure) {
+        calm_intervals = 0;
+        // Bitrate applies live; preset and threads restart the branch, which
+        // closes the segment early
+        if (current.bitrate_kbps > bounds.min_bitrate_kbps) {
+            int bitrate = std::max(bounds.min_bitrate_kbps, current.bitrate_kbps * 4 / 5);
+            std::cout << "Encoder tuner: under load (" << measured.str() << "), bitrate "
+                      << current.bitrate_kbps << " -> " << bitrate << " kbit/s" << std::endl;
+            recorder.set_bitrate(bitrate);
+        } else if (current.speed_preset > bounds.fastest_preset && can_restart()) {
+            restart_with(current.speed_preset - 1, current.threads, ("under load (" + measured.str() + ")").c_str());
+        } else if (current.threads > 0 && current.threads < bounds.max_threads && idle >= idle_for_threads &&
+                   can_restart()) {
+            // threads == 0 leaves x264 on its own automatic choice
+            restart_with(current.speed_preset, current.threads + 1, ("under load (" + measured.str() + ")").c_str());
+        }
+        return;
+    }
+
+    // Only spend more CPU after a sustained quiet period
+    if (fill < 0.1 && ++calm_intervals >= calm_intervals_before_upgrade) {
+        calm_intervals = 0;
+        if (current.bitrate_kbps < bounds.max_bitrate_kbps) {
+            int bitrate = std::min(bounds.max_bitrate_kbps, current.bitrate_kbps * 11 / 10);
+            std::cout << "Encoder tuner: headroom (" << measured.str() << "), bitrate "
+                      << current.bitrate_kbps << " -> " << bitrate << " kbit/s" << std::endl;
+            recorder.set_bitrate(bitrate);
+        } else if (current.speed_preset < bounds.slowest_preset && can_restart()) {
+            restart_with(current.speed_preset + 1, current.threads, ("headroom (" + measured.str() + ")").c_str());
+        }
+    }
+}
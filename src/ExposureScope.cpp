@@ -0,0 +1,289 @@
+#include "ExposureScope.h"
+#include "Tracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+// False colour zones by luma: crushed blacks purple, shadows blue, middle
+// grey green, skin pink, highlights yellow, clipping red; the rest as grey.
+void build_palette(uint32_t* palette) {
+    for (int y = 0; y < 256; ++y) {
+        double level = y / 255.0;
+        uint32_t rgb;
+        if (level < 0.02) {
+            rgb = 0x800080;
+        } else if (level < 0.10) {
+            rgb = 0x0040FF;
+        } else if (level >= 0.38 && level < 0.48) {
+            rgb = 0x20C020;
+        } else if (level >= 0.60 && level < 0.70) {
+            rgb = 0xFF80C0;
+        } else if (level >= 0.90 && level < 0.97) {
+            rgb = 0xFFFF00;
+        } else if (level >= 0.97) {
+            rgb = 0xFF0000;
+        } else {
+            rgb = (uint32_t)y * 0x010101;
+        }
+        palette[y] = 0xFF000000 | rgb; // opaque, for ARGB32 frames
+    }
+}
+
+} // namespace
+
+ExposureScope::ExposureScope(const ScopeSettings& settings)
+    : settings(settings), waveform(scope_waveform_width * scope_waveform_levels),
+      pool(std::max(settings.threads, 1), "scope") {
+    this->settings.every = std::max(settings.every, 1);
+    size_t bands = pool.size() + 1;
+    partial_histograms.resize(bands);
+    partial_waveforms.assign(bands, std::vector<uint32_t>(waveform.size()));
+    build_palette(palette);
+}
+
+ScopeView ExposureScope::parse_view(const std::string& name) {
+    if (name == "histogram") {
+        return ScopeView::Histogram;
+    }
+    if (name == "waveform") {
+        return ScopeView::Waveform;
+    }
+    return ScopeView::Off;
+}
+
+ExposureWarning ExposureScope::parse_warning(const std::string& name) {
+    if (name == "zebra") {
+        return ExposureWarning::Zebra;
+    }
+    if (name == "false-colour") {
+        return ExposureWarning::FalseColour;
+    }
+    return ExposureWarning::Off;
+}
+
+const char* ExposureScope::name(ScopeView view) {
+    switch (view) {
+    case ScopeView::Histogram: return "histogram";
+    case ScopeView::Waveform: return "waveform";
+    default: return "off";
+    }
+}
+
+const char* ExposureScope::name(ExposureWarning warning) {
+    switch (warning) {
+    case ExposureWarning::Zebra: return "zebra";
+    case ExposureWarning::FalseColour: return "false-colour";
+    default: return "off";
+    }
+}
+
+// The HUD wraps the BGRx frame in an image surface, so the target is the frame
+cairo_surface_t* ExposureScope::frame_surface(cairo_t* cr) {
+    cairo_surface_t *target = cairo_get_target(cr);
+    if (cairo_surface_get_type(target) != CAIRO_SURFACE_TYPE_IMAGE) {
+        return nullptr;
+    }
+    cairo_format_t format = cairo_image_surface_get_format(target);
+    if (format != CAIRO_FORMAT_RGB24 && format != CAIRO_FORMAT_ARGB32) {
+        return nullptr;
+    }
+    return target;
+}
+
+void ExposureScope::measure(cairo_t* cr) {
+    measure_ms = 0;
+    ScopeView view = view_;
+    if (view == ScopeView::Off || (frame_count % settings.every != 0 && view == rendered_view)) {
+        return;
+    }
+    cairo_surface_t *target = frame_surface(cr);
+    if (!target) {
+        return;
+    }
+    TraceSpan span("display", "exposure_measure");
+    auto begin = std::chrono::steady_clock::now();
+    cairo_surface_flush(target);
+    // Before the warnings are painted in, and before any comparison
+    analyse(cairo_image_surface_get_data(target), cairo_image_surface_get_stride(target),
+            cairo_image_surface_get_width(target), cairo_image_surface_get_height(target),
+            view == ScopeView::Waveform);
+    if (view == ScopeView::Histogram) {
+        render_histogram();
+    } else {
+        render_waveform();
+    }
+    rendered_view = view;
+    measure_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+void ExposureScope::draw(cairo_t* cr, int live_width) {
+    ScopeView view = view_;
+    ExposureWarning warning = warning_;
+    if (view == ScopeView::Off && warning == ExposureWarning::Off) {
+        return;
+    }
+    cairo_surface_t *target = frame_surface(cr);
+    if (!target) {
+        return;
+    }
+    TraceSpan span("display", "exposure_scope");
+    auto begin = std::chrono::steady_clock::now();
+    cairo_surface_flush(target);
+    uint8_t *data = cairo_image_surface_get_data(target);
+    int stride = cairo_image_surface_get_stride(target);
+    int width = cairo_image_surface_get_width(target), height = cairo_image_surface_get_height(target);
+    int warn_width = live_width < 0 ? width : std::min(live_width, width);
+
+    if (warning != ExposureWarning::Off && warn_width > 0) {
+        size_t bands = partial_histograms.size();
+        int phase = (int)(frame_count & 15); // stripes crawl so they read as an overlay
+        pool.parallel_for(bands, [&](size_t band) {
+            int first = (int)(height * band / bands), last = (int)(height * (band + 1) / bands);
+            if (warning == ExposureWarning::Zebra) {
+                apply_zebra(data, stride, warn_width, first, last, settings.zebra_level, phase);
+            } else {
+                apply_false_colour(data, stride, warn_width, first, last, palette);
+            }
+        });
+        cairo_surface_mark_dirty(target);
+    }
+
+    if (view != ScopeView::Off && surface) {
+        cairo_set_source_surface(cr, surface->cobj(), width - scope_width - 10, height - scope_height - 10);
+        cairo_paint(cr);
+    }
+    ++frame_count;
+
+    double ms = measure_ms + std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    average_ms.store(0.9 * average_ms.load(std::memory_order_relaxed) + 0.1 * ms, std::memory_order_relaxed);
+}
+
+void ExposureScope::analyse(const uint8_t* data, int stride, int width, int height, bool with_waveform) {
+    size_t bands = partial_histograms.size();
+    pool.parallel_for(bands, [&](size_t band) {
+        int first = (int)(height * band / bands), last = (int)(height * (band + 1) / bands);
+        partial_histograms[band].clear();
+        uint32_t *counts = nullptr;
+        if (with_waveform) {
+            std::fill(partial_waveforms[band].begin(), partial_waveforms[band].end(), 0);
+            counts = partial_waveforms[band].data();
+        }
+        accumulate_scope(data, stride, width, first, last, partial_histograms[band], counts);
+    });
+
+    histogram.clear();
+    for (const auto& partial : partial_histograms) {
+        histogram.add(partial);
+    }
+    samples = 0;
+    for (uint32_t count : histogram.luma) {
+        samples += count;
+    }
+    if (with_waveform) {
+        std::copy(partial_waveforms[0].begin(), partial_waveforms[0].end(), waveform.begin());
+        for (size_t band = 1; band < bands; ++band) {
+            const auto& partial = partial_waveforms[band];
+            for (size_t i = 0; i < waveform.size(); ++i) {
+                waveform[i] += partial[i];
+            }
+        }
+    }
+}
+
+// Luma filled, RGB as lines; scaled to the tallest bin short of the two ends
+// so a clipped spike doesn't flatten the rest, with the ends marked red when
+// more than 0.5% of the frame sits there.
+void ExposureScope::render_histogram() {
+    if (!surface) {
+        surface = Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, scope_width, scope_height);
+    }
+    auto cr = Cairo::Context::create(surface);
+    cr->set_operator(Cairo::OPERATOR_SOURCE);
+    cr->set_source_rgba(0.0, 0.0, 0.0, 0.55);
+    cr->paint();
+    cr->set_operator(Cairo::OPERATOR_OVER);
+
+    uint32_t peak = 1;
+    for (int i = 1; i < 255; ++i) {
+        peak = std::max({peak, histogram.luma[i], histogram.red[i], histogram.green[i], histogram.blue[i]});
+    }
+    double scale = (scope_height - 4) / (double)peak;
+    auto bar = [&](const uint32_t* bins, int i) { return scope_height - std::min(bins[i] * scale, scope_height - 4.0); };
+
+    cr->move_to(0, scope_height);
+    for (int i = 0; i < 256; ++i) {
+        cr->line_to(i + 0.5, bar(histogram.luma, i));
+    }
+    cr->line_to(scope_width, scope_height);
+    cr->close_path();
+    cr->set_source_rgba(0.85, 0.85, 0.85, 0.5);
+    cr->fill();
+
+    const uint32_t *channels[3] = {histogram.red, histogram.green, histogram.blue};
+    const double colours[3][3] = {{1, 0.2, 0.2}, {0.2, 1, 0.2}, {0.3, 0.5, 1}};
+    cr->set_line_width(1);
+    for (int c = 0; c < 3; ++c) {
+        cr->move_to(0.5, bar(channels[c], 0));
+        for (int i = 1; i < 256; ++i) {
+            cr->line_to(i + 0.5, bar(channels[c], i));
+        }
+        cr->set_source_rgba(colours[c][0], colours[c][1], colours[c][2], 0.9);
+        cr->stroke();
+    }
+
+    uint64_t limit = samples / 200;
+    cr->set_source_rgb(1, 0, 0);
+    if (std::max({histogram.red[0], histogram.green[0], histogram.blue[0]}) > limit) {
+        cr->rectangle(0, 0, 3, scope_height);
+        cr->fill();
+    }
+    if (std::max({histogram.red[255], histogram.green[255], histogram.blue[255]}) > limit) {
+        cr->rectangle(scope_width - 3, 0, 3, scope_height);
+        cr->fill();
+    }
+    surface->flush();
+}
+
+// Column position across, luma up; brightness is how many pixels of that
+// column sit at that level. Guides at 0, 50 and 100%.
+void ExposureScope::render_waveform() {
+    if (!surface) {
+        surface = Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, scope_width, scope_height);
+    }
+    surface->flush();
+    uint8_t *pixels = surface->get_data();
+    int stride = surface->get_stride();
+    // A column spread evenly over all levels would show as faint; a line
+    // across one level as full brightness
+    uint64_t per_column = std::max<uint64_t>(samples / scope_waveform_width, 1);
+    int rows_per_level = scope_height / scope_waveform_levels;
+    for (int level = 0; level < scope_waveform_levels; ++level) {
+        const uint32_t *counts = &waveform[(size_t)level * scope_waveform_width];
+        for (int column = 0; column < scope_waveform_width; ++column) {
+            uint32_t pixel = 0x8C000000; // background, 55% black
+            if (counts[column]) {
+                uint32_t intensity = (uint32_t)std::min<uint64_t>(255, 48 + counts[column] * 1024 / per_column);
+                pixel = 0xFF000000 | (intensity / 3) << 16 | intensity << 8 | (intensity / 3);
+            }
+            for (int r = 0; r < rows_per_level; ++r) {
+                int row = scope_height - 1 - (level * rows_per_level + r);
+                reinterpret_cast<uint32_t*>(pixels + (size_t)row * stride)[column] = pixel;
+            }
+        }
+    }
+    surface->mark_dirty();
+
+    auto cr = Cairo::Context::create(surface);
+    cr->set_source_rgba(1, 1, 1, 0.3);
+    cr->set_line_width(1);
+    for (double fraction : {0.0, 0.5, 1.0}) {
+        double y = 0.5 + (scope_height - 1) * (1 - fraction);
+        cr->move_to(0, y);
+        cr->line_to(scope_width, y);
+    }
+    cr->stroke();
+    surface->flush();
+}
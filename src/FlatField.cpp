@@ -0,0 +1,324 @@
+#include "FlatField.h"
+#include "FlatFieldKernels.h"
+#include "MotionDetector.h"
+#include "Tracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static const char flat_magic[8] = {'M', 'I', 'V', 'O', 'F', 'L', 'T', '1'};
+
+GainGrid GainGrid::from_cells(const std::vector<float>& cells, int columns, int rows, int width, int height, int step) {
+    GainGrid grid;
+    grid.width = width;
+    grid.height = height;
+    grid.step = step;
+    grid.columns = columns;
+    grid.rows = rows;
+
+    std::vector<float> blurred(cells.size());
+    double total = 0;
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < columns; ++c) {
+            float sum = 0;
+            int n = 0;
+            for (int dr = -1; dr <= 1; ++dr) {
+                for (int dc = -1; dc <= 1; ++dc) {
+                    int rr = r + dr, cc = c + dc;
+                    if (rr >= 0 && rr < rows && cc >= 0 && cc < columns) {
+                        sum += cells[(size_t)rr * columns + cc];
+                        ++n;
+                    }
+                }
+            }
+            blurred[(size_t)r * columns + c] = sum / n;
+            total += sum / n;
+        }
+    }
+
+    double mean = cells.empty() ? 0 : total / cells.size();
+    grid.gains.resize(cells.size());
+    for (size_t i = 0; i < blurred.size(); ++i) {
+        double gain = blurred[i] > 0 ? mean / blurred[i] : 4.0;
+        gain = std::min(std::max(gain, 0.25), flat_gain_max / 256.0);
+        grid.gains[i] = (uint16_t)std::lround(gain * 256);
+    }
+    return grid;
+}
+
+std::vector<uint16_t> GainGrid::expand() const {
+    std::vector<uint16_t> out((size_t)width * height);
+    if (columns == 0 || rows == 0) {
+        std::fill(out.begin(), out.end(), flat_gain_one);
+        return out;
+    }
+
+    // Block centres sit at (i + 0.5) * step
+    auto axis = [this](int n, int cells, std::vector<int>& first, std::vector<float>& weight) {
+        first.resize(n);
+        weight.resize(n);
+        for (int i = 0; i < n; ++i) {
+            float pos = (i + 0.5f) / step - 0.5f;
+            pos = std::min(std::max(pos, 0.0f), (float)(cells - 1));
+            int p0 = std::min((int)pos, std::max(cells - 2, 0));
+            first[i] = p0;
+            weight[i] = cells > 1 ? pos - p0 : 0;
+        }
+    };
+    std::vector<int> x0, y0;
+    std::vector<float> wx, wy;
+    axis(width, columns, x0, wx);
+    axis(height, rows, y0, wy);
+
+    int x_next = columns > 1 ? 1 : 0;
+    size_t y_next = rows > 1 ? columns : 0;
+    for (int y = 0; y < height; ++y) {
+        const uint16_t *top = &gains[(size_t)y0[y] * columns];
+        const uint16_t *bottom = top + y_next;
+        for (int x = 0; x < width; ++x) {
+            int c = x0[x];
+            float upper = top[c] + (top[c + x_next] - top[c]) * wx[x];
+            float lower = bottom[c] + (bottom[c + x_next] - bottom[c]) * wx[x];
+            out[(size_t)y * width + x] = (uint16_t)std::lround(upper + (lower - upper) * wy[y]);
+        }
+    }
+    return out;
+}
+
+bool GainGrid::save(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    uint32_t header[5] = {(uint32_t)width, (uint32_t)height, (uint32_t)step, (uint32_t)columns, (uint32_t)rows};
+    out.write(flat_magic, sizeof(flat_magic));
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(gains.data()), gains.size() * sizeof(uint16_t));
+    return out.good();
+}
+
+bool GainGrid::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[8];
+    uint32_t header[5];
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, flat_magic, sizeof(magic)) != 0 ||
+        !in.read(reinterpret_cast<char*>(header), sizeof(header))) {
+        return false;
+    }
+    width = header[0];
+    height = header[1];
+    step = header[2];
+    columns = header[3];
+    rows = header[4];
+    if (step <= 0 || columns <= 0 || rows <= 0 || columns > 4096 || rows > 4096) {
+        return false;
+    }
+    gains.resize((size_t)columns * rows);
+    return (bool)in.read(reinterpret_cast<char*>(gains.data()), gains.size() * sizeof(uint16_t));
+}
+
+FlatField::FlatField(GstPad* capture_pad, FrameMailbox& mailbox, const FlatFieldSettings& settings)
+    : capture_pad(capture_pad), mailbox(mailbox), settings(settings), pool(std::max(settings.threads, 1), "flatfield") {
+    active = settings.enabled;
+    probe_id = gst_pad_add_probe(capture_pad,
+                                 (GstPadProbeType)(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM),
+                                 &FlatField::on_capture, this, nullptr);
+}
+
+FlatField::~FlatField() {
+    gst_pad_remove_probe(capture_pad, probe_id);
+    if (calibration.joinable()) {
+        calibration.join();
+    }
+}
+
+void FlatField::set_enabled(bool enabled) {
+    active = enabled;
+    std::cout << "Flat-field correction " << (enabled ? "on" : "off") << std::endl;
+}
+
+std::string FlatField::map_path(int width, int height) const {
+    return settings.directory + "/flat-" + settings.camera_key + "-" + std::to_string(width) + "x" +
+           std::to_string(height) + ".bin";
+}
+
+// On the streaming thread at each caps change; reads ~64 KB
+void FlatField::load_map(int width, int height) {
+    GainGrid grid;
+    if (!grid.load(map_path(width, height)) || grid.width != width || grid.height != height) {
+        std::atomic_store(&map, std::shared_ptr<const PixelGains>());
+        if (active) {
+            std::cout << "No flat-field map for " << width << "x" << height
+                      << "; calibrate on an evenly lit, empty field." << std::endl;
+        }
+        return;
+    }
+    auto pixels = std::make_shared<PixelGains>();
+    pixels->width = width;
+    pixels->height = height;
+    pixels->gains = grid.expand();
+    std::atomic_store(&map, std::shared_ptr<const PixelGains>(pixels));
+    std::cout << "Flat-field map loaded for " << width << "x" << height << std::endl;
+}
+
+// Gains are applied to luma only, which RGB frames don't have
+bool FlatField::luma_layout(const GstVideoInfo* info, LumaLayout* layout) {
+    return find_luma_layout(info, layout) && *layout != LumaLayout::Packed4;
+}
+
+GstPadProbeReturn FlatField::on_capture(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    auto self = static_cast<FlatField*>(user_data);
+
+    if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+        GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+        if (GST_EVENT_TYPE(event) == GST_EVENT_CAPS) {
+            GstCaps *caps = nullptr;
+            gst_event_parse_caps(event, &caps);
+            self->have_info = gst_video_info_from_caps(&self->video_info, caps) &&
+                              luma_layout(&self->video_info, &self->layout);
+            if (self->have_info) {
+                self->load_map(GST_VIDEO_INFO_WIDTH(&self->video_info), GST_VIDEO_INFO_HEIGHT(&self->video_info));
+            } else if (self->active) {
+                std::cerr << "Flat-field correction needs planar YUV, YUY2 or UYVY capture." << std::endl;
+            }
+        }
+        return GST_PAD_PROBE_OK;
+    }
+
+    if (!self->active || self->suspended || !self->have_info) {
+        return GST_PAD_PROBE_OK;
+    }
+    std::shared_ptr<const PixelGains> map = std::atomic_load(&self->map);
+    if (!map || map->width != GST_VIDEO_INFO_WIDTH(&self->video_info) ||
+        map->height != GST_VIDEO_INFO_HEIGHT(&self->video_info)) {
+        return GST_PAD_PROBE_OK;
+    }
+
+    // Writing in place is only free while nothing else holds the buffer or
+    // its memory; an earlier probe keeping a ref, or a driver pool handing out
+    // shared memory, turns this into a full frame copy. Still corrected, since
+    // a flickering correction is worse, but counted and reported once.
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    if (!gst_buffer_is_writable(buffer) || !gst_buffer_is_all_memory_writable(buffer)) {
+        if (self->copied_frames++ == 0) {
+            std::cerr << "Flat-field correction is copying frames: the capture buffer is shared." << std::endl;
+        }
+    }
+    buffer = gst_buffer_make_writable(buffer);
+    GST_PAD_PROBE_INFO_DATA(info) = buffer;
+    GstVideoFrame frame;
+    if (!gst_video_frame_map(&frame, &self->video_info, buffer, GST_MAP_READWRITE)) {
+        return GST_PAD_PROBE_OK;
+    }
+    auto begin = std::chrono::steady_clock::now();
+    self->apply(&frame, *map);
+    self->last_apply_ms.store(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count(),
+                              std::memory_order_relaxed);
+    gst_video_frame_unmap(&frame);
+    return GST_PAD_PROBE_OK;
+}
+
+void FlatField::apply(GstVideoFrame* frame, const PixelGains& map) {
+    TraceSpan span("flatfield", "flat_apply");
+    uint8_t *data = static_cast<uint8_t*>(GST_VIDEO_FRAME_PLANE_DATA(frame, 0));
+    int stride = GST_VIDEO_FRAME_PLANE_STRIDE(frame, 0);
+    int width = map.width, height = map.height;
+
+    // One band per worker plus the streaming thread; each band is a
+    // contiguous run of rows, so threads never share a cache line of pixels.
+    size_t bands = pool.size() + 1;
+    pool.parallel_for(bands, [&](size_t band) {
+        int first = (int)(height * band / bands);
+        int last = (int)(height * (band + 1) / bands);
+        for (int y = first; y < last; ++y) {
+            apply_gain_row(data + (size_t)y * stride, &map.gains[(size_t)y * width], width, layout);
+        }
+    });
+}
+
+bool FlatField::calibrate() {
+    if (calibration_running.exchange(true)) {
+        return false;
+    }
+    if (calibration.joinable()) {
+        calibration.join();
+    }
+    calibration = std::thread(&FlatField::run_calibration, this);
+    return true;
+}
+
+void FlatField::run_calibration() {
+    TraceSpan span("flatfield", "flat_calibrate");
+    suspended = true;
+    // The one frame that may have been corrected before the suspend is skipped
+    uint64_t sequence = mailbox.frames() + 1;
+    int frames = std::max(settings.calibration_frames, 1);
+    const int step = 8;
+
+    std::vector<uint32_t> sums;
+    std::vector<uint8_t> cells;
+    int width = 0, height = 0, columns = 0, rows = 0, taken = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+    while (taken < frames && std::chrono::steady_clock::now() < deadline) {
+        GstSample *sample = mailbox.take(&sequence);
+        if (!sample) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            continue;
+        }
+        GstVideoInfo info;
+        LumaLayout sample_layout;
+        GstVideoFrame frame;
+        bool usable = gst_video_info_from_caps(&info, gst_sample_get_caps(sample)) && luma_layout(&info, &sample_layout) &&
+                      gst_video_frame_map(&frame, &info, gst_sample_get_buffer(sample), GST_MAP_READ);
+        if (usable) {
+            if (taken == 0) {
+                width = GST_VIDEO_INFO_WIDTH(&info);
+                height = GST_VIDEO_INFO_HEIGHT(&info);
+                columns = width / step;
+                rows = height / step;
+                sums.assign((size_t)columns * rows, 0);
+                cells.resize(sums.size());
+            }
+            if (GST_VIDEO_INFO_WIDTH(&info) == width && GST_VIDEO_INFO_HEIGHT(&info) == height) {
+                downsample_luma(static_cast<const uint8_t*>(GST_VIDEO_FRAME_PLANE_DATA(&frame, 0)),
+                                GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 0), width, height, sample_layout, step, cells.data());
+                for (size_t i = 0; i < cells.size(); ++i) {
+                    sums[i] += cells[i];
+                }
+                ++taken;
+            }
+            gst_video_frame_unmap(&frame);
+        }
+        gst_sample_unref(sample);
+    }
+    suspended = false;
+
+    if (taken < frames || columns == 0 || rows == 0) {
+        std::cerr << "Flat-field calibration failed: " << taken << " of " << frames << " usable frames." << std::endl;
+        calibration_running = false;
+        return;
+    }
+
+    std::vector<float> mean(sums.size());
+    for (size_t i = 0; i < sums.size(); ++i) {
+        mean[i] = (float)sums[i] / taken;
+    }
+    GainGrid grid = GainGrid::from_cells(mean, columns, rows, width, height, step);
+    std::string path = map_path(width, height);
+    if (!grid.save(path)) {
+        std::cerr << "Failed to write flat-field map " << path << std::endl;
+    }
+
+    auto pixels = std::make_shared<PixelGains>();
+    pixels->width = width;
+    pixels->height = height;
+    pixels->gains = grid.expand();
+    std::atomic_store(&map, std::shared_ptr<const PixelGains>(pixels));
+
+    auto corner = std::max_element(grid.gains.begin(), grid.gains.end());
+    std::cout << "Flat-field calibrated at " << width << "x" << height << " from " << taken << " frames, strongest gain "
+              << *corner / 256.0 << ", saved to " << path << std::endl;
+    calibration_running = false;
+}
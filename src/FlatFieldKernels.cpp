@@ -0,0 +1,92 @@
+#include "FlatFieldKernels.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+inline uint8_t scale(uint8_t y, uint16_t gain) {
+    uint32_t v = ((uint32_t)y * gain) >> 8;
+    return (uint8_t)(v > 255 ? 255 : v);
+}
+
+#if defined(__ARM_NEON)
+inline uint8x8_t scale8(uint8x8_t y, uint16x8_t gain) {
+    uint16x8_t wide = vmovl_u8(y);
+    uint16x4_t lo = vshrn_n_u32(vmull_u16(vget_low_u16(wide), vget_low_u16(gain)), 8);
+    uint16x4_t hi = vshrn_n_u32(vmull_u16(vget_high_u16(wide), vget_high_u16(gain)), 8);
+    return vqmovn_u16(vcombine_u16(lo, hi));
+}
+#endif
+
+} // namespace
+
+void apply_gain_row(uint8_t* row, const uint16_t* gain, int width, LumaLayout layout) {
+    int x = 0;
+    switch (layout) {
+    case LumaLayout::Planar:
+#if defined(__SSE2__)
+        // Interleaving with zero puts y << 8 in each 16-bit lane, so the
+        // high half of the product is y * gain >> 8; packus clamps to 255.
+        for (; x + 16 <= width; x += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+            __m128i g0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(gain + x));
+            __m128i g1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(gain + x + 8));
+            __m128i zero = _mm_setzero_si128();
+            __m128i lo = _mm_mulhi_epu16(_mm_unpacklo_epi8(zero, v), g0);
+            __m128i hi = _mm_mulhi_epu16(_mm_unpackhi_epi8(zero, v), g1);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(row + x), _mm_packus_epi16(lo, hi));
+        }
+#elif defined(__ARM_NEON)
+        for (; x + 8 <= width; x += 8) {
+            vst1_u8(row + x, scale8(vld1_u8(row + x), vld1q_u16(gain + x)));
+        }
+#endif
+        for (; x < width; ++x) {
+            row[x] = scale(row[x], gain[x]);
+        }
+        break;
+
+    case LumaLayout::YUYV:
+    case LumaLayout::UYVY: {
+        bool uyvy = layout == LumaLayout::UYVY;
+#if defined(__SSE2__)
+        // 8 pixels per 16 bytes, one luma byte in each 16-bit lane
+        const __m128i chroma_mask = _mm_set1_epi16(uyvy ? 0x00FF : (short)0xFF00);
+        const __m128i limit = _mm_set1_epi16(255);
+        for (; x + 8 <= width; x += 8) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x * 2));
+            __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(gain + x));
+            __m128i y = uyvy ? _mm_andnot_si128(chroma_mask, v) : _mm_slli_epi16(v, 8);
+            __m128i r = _mm_min_epi16(_mm_mulhi_epu16(y, g), limit);
+            if (uyvy) {
+                r = _mm_slli_epi16(r, 8);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(row + x * 2), _mm_or_si128(_mm_and_si128(v, chroma_mask), r));
+        }
+#elif defined(__ARM_NEON)
+        for (; x + 8 <= width; x += 8) {
+            uint8x8x2_t v = vld2_u8(row + x * 2);
+            uint16x8_t g = vld1q_u16(gain + x);
+            if (uyvy) {
+                v.val[1] = scale8(v.val[1], g);
+            } else {
+                v.val[0] = scale8(v.val[0], g);
+            }
+            vst2_u8(row + x * 2, v);
+        }
+#endif
+        uint8_t *p = row + (uyvy ? 1 : 0);
+        for (; x < width; ++x) {
+            p[x * 2] = scale(p[x * 2], gain[x]);
+        }
+        break;
+    }
+
+    case LumaLayout::Packed4:
+        break; // not corrected
+    }
+}
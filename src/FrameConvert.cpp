@@ -0,0 +1,87 @@
+#include "FrameConvert.h"
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <cstring>
+
+bool frame_to_rgb(const GstVideoFrame& frame, cv::Mat& rgb) {
+    int width = GST_VIDEO_FRAME_WIDTH(&frame), height = GST_VIDEO_FRAME_HEIGHT(&frame);
+    auto plane = [&frame, width, height](int index, int type, int divide) {
+        return cv::Mat(height / divide, width / divide, type, GST_VIDEO_FRAME_PLANE_DATA(&frame, index),
+                       GST_VIDEO_FRAME_PLANE_STRIDE(&frame, index));
+    };
+    switch (GST_VIDEO_FRAME_FORMAT(&frame)) {
+    case GST_VIDEO_FORMAT_YUY2:
+        cv::cvtColor(plane(0, CV_8UC2, 1), rgb, cv::COLOR_YUV2RGB_YUY2);
+        return true;
+    case GST_VIDEO_FORMAT_UYVY:
+        cv::cvtColor(plane(0, CV_8UC2, 1), rgb, cv::COLOR_YUV2RGB_UYVY);
+        return true;
+    case GST_VIDEO_FORMAT_NV12:
+        cv::cvtColorTwoPlane(plane(0, CV_8UC1, 1), plane(1, CV_8UC2, 2), rgb, cv::COLOR_YUV2RGB_NV12);
+        return true;
+    case GST_VIDEO_FORMAT_I420: {
+        // OpenCV wants the three planes back to back without padding
+        cv::Mat packed(height * 3 / 2, width, CV_8UC1);
+        uint8_t *out = packed.data;
+        for (int index = 0; index < 3; ++index) {
+            int divide = index ? 2 : 1;
+            cv::Mat source = plane(index, CV_8UC1, divide);
+            for (int row = 0; row < source.rows; ++row, out += source.cols) {
+                std::memcpy(out, source.ptr(row), source.cols);
+            }
+        }
+        cv::cvtColor(packed, rgb, cv::COLOR_YUV2RGB_I420);
+        return true;
+    }
+    case GST_VIDEO_FORMAT_GRAY8:
+        cv::cvtColor(plane(0, CV_8UC1, 1), rgb, cv::COLOR_GRAY2RGB);
+        return true;
+    case GST_VIDEO_FORMAT_RGB:
+        plane(0, CV_8UC3, 1).copyTo(rgb);
+        return true;
+    case GST_VIDEO_FORMAT_BGR:
+        cv::cvtColor(plane(0, CV_8UC3, 1), rgb, cv::COLOR_BGR2RGB);
+        return true;
+    case GST_VIDEO_FORMAT_RGBx:
+    case GST_VIDEO_FORMAT_RGBA:
+        cv::cvtColor(plane(0, CV_8UC4, 1), rgb, cv::COLOR_RGBA2RGB);
+        return true;
+    case GST_VIDEO_FORMAT_BGRx:
+    case GST_VIDEO_FORMAT_BGRA:
+        cv::cvtColor(plane(0, CV_8UC4, 1), rgb, cv::COLOR_BGRA2RGB);
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool sample_to_rgb(GstSample* sample, cv::Mat& rgb) {
+    GstCaps *caps = gst_sample_get_caps(sample);
+    GstBuffer *buffer = gst_sample_get_buffer(sample);
+    if (!caps || !buffer) {
+        return false;
+    }
+    if (gst_structure_has_name(gst_caps_get_structure(caps, 0), "image/jpeg")) {
+        GstMapInfo map;
+        if (!gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+            return false;
+        }
+        cv::Mat bgr = cv::imdecode(cv::Mat(1, (int)map.size, CV_8UC1, map.data), cv::IMREAD_COLOR);
+        gst_buffer_unmap(buffer, &map);
+        if (bgr.empty()) {
+            return false;
+        }
+        cv::cvtColor(bgr, rgb, cv::COLOR_BGR2RGB);
+        return true;
+    }
+    GstVideoInfo info;
+    GstVideoFrame frame;
+    if (!gst_video_info_from_caps(&info, caps) || !gst_video_frame_map(&frame, &info, buffer, GST_MAP_READ)) {
+        return false;
+    }
+    bool converted = frame_to_rgb(frame, rgb);
+    gst_video_frame_unmap(&frame);
+    return converted;
+}
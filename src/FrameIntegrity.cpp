@@ -0,0 +1,75 @@
+#include "FrameIntegrity.h"
+
+#include <cmath>
+
+void FrameIntegrity::on_capture(uint64_t sequence, uint64_t timestamp_ns) {
+    captured.fetch_add(1, std::memory_order_relaxed);
+    seen[sequence % history].store(sequence + 1, std::memory_order_relaxed);
+
+    if (!have_capture) {
+        have_capture = true;
+        last_sequence = sequence;
+        last_timestamp = timestamp_ns;
+        return;
+    }
+
+    uint64_t sequence_gap = 0;
+    if (sequence == last_sequence) {
+        duplicates.fetch_add(1, std::memory_order_relaxed);
+        return;
+    } else if (sequence > last_sequence) {
+        sequence_gap = sequence - last_sequence - 1;
+    }
+    // A sequence going backwards means the device restarted; resync silently
+
+    // Timestamps catch drivers that keep counting sequence numbers densely
+    // even when the sensor skipped a frame.
+    uint64_t timestamp_gap = 0;
+    if (timestamp_ns && last_timestamp) {
+        if (timestamp_ns == last_timestamp) {
+            duplicates.fetch_add(1, std::memory_order_relaxed);
+        } else if (timestamp_ns > last_timestamp) {
+            double delta = double(timestamp_ns - last_timestamp);
+            if (frame_interval_ns > 0 && delta > frame_interval_ns * 1.5) {
+                timestamp_gap = static_cast<uint64_t>(std::lround(delta / frame_interval_ns)) - 1;
+            } else if (sequence_gap == 0) {
+                // Learn the nominal interval only from clean frame pairs
+                frame_interval_ns = frame_interval_ns > 0 ? frame_interval_ns * 0.95 + delta * 0.05 : delta;
+            }
+        }
+    }
+
+    uint64_t lost = sequence_gap > timestamp_gap ? sequence_gap : timestamp_gap;
+    if (lost) {
+        sensor_drops.fetch_add(lost, std::memory_order_relaxed);
+    }
+    last_sequence = sequence;
+    last_timestamp = timestamp_ns;
+}
+
+// Any sequence skipped between two displayed frames is either a frame the
+// source never produced (already counted) or one the pipeline discarded.
+void FrameIntegrity::on_display(uint64_t sequence) {
+    displayed.fetch_add(1, std::memory_order_relaxed);
+
+    if (have_display && sequence > last_displayed + 1) {
+        uint64_t first = last_displayed + 1;
+        // Beyond the history window we cannot tell, so only look at the tail
+        if (sequence - first > history) {
+            first = sequence - history;
+        }
+        uint64_t dropped = 0;
+        for (uint64_t s = first; s < sequence; ++s) {
+            if (seen[s % history].load(std::memory_order_relaxed) == s + 1) {
+                dropped++;
+            }
+        }
+        if (dropped) {
+            pipeline_drops.fetch_add(dropped, std::memory_order_relaxed);
+        }
+    }
+    if (!have_display || sequence > last_displayed) {
+        last_displayed = sequence;
+    }
+    have_display = true;
+}
@@ -0,0 +1,92 @@
+#include "FrameMailbox.h"
+
+#include <chrono>
+
+FrameMailbox::FrameMailbox(GstPad* pad) : pad(GST_PAD(gst_object_ref(pad))) {
+    probe_id = gst_pad_add_probe(pad,
+        static_cast<GstPadProbeType>(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM),
+        &FrameMailbox::on_data, this, nullptr);
+}
+
+FrameMailbox::~FrameMailbox() {
+    gst_pad_remove_probe(pad, probe_id);
+    gst_object_unref(pad);
+    if (caps) {
+        gst_caps_unref(caps);
+    }
+}
+
+GstSample* FrameMailbox::take(uint64_t* sequence) {
+    GstSample *sample = nullptr;
+    uint64_t after = sequence ? *sequence : 0;
+    uint64_t taken = 0;
+    if (!mailbox.take(sample, taken, after)) {
+        return nullptr;
+    }
+    if (sequence) {
+        *sequence = taken;
+    }
+    return sample;
+}
+
+GstSample* FrameMailbox::wait(uint64_t* sequence, int timeout_ms) {
+    if (GstSample *sample = take(sequence)) {
+        return sample;
+    }
+    uint64_t after = *sequence;
+    waiters.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with the one in on_data
+    {
+        std::unique_lock<std::mutex> lock(wait_mutex);
+        arrived.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&]() { return mailbox.sequence() > after; });
+    }
+    waiters.fetch_sub(1);
+    return take(sequence);
+}
+
+void FrameMailbox::set_bracketing(bool on) {
+    if (on) {
+        ++brackets;
+    }
+    bracketing = on;
+}
+
+bool FrameMailbox::disturbed(uint64_t* seen) const {
+    // The count catches a bracket that began and ended between two calls
+    uint64_t started = brackets.load();
+    bool changed = started != *seen;
+    *seen = started;
+    return bracketing.load() || changed;
+}
+
+GstPadProbeReturn FrameMailbox::on_data(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    auto self = static_cast<FrameMailbox*>(user_data);
+
+    // Keep the caps from the event instead of querying the pad per buffer
+    if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+        GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+        if (GST_EVENT_TYPE(event) == GST_EVENT_CAPS) {
+            GstCaps *new_caps = nullptr;
+            gst_event_parse_caps(event, &new_caps);
+            gst_caps_replace(&self->caps, new_caps);
+        }
+        return GST_PAD_PROBE_OK;
+    }
+
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    if (!self->caps) {
+        return GST_PAD_PROBE_OK;
+    }
+    GstSample *sample = gst_sample_new(buffer, self->caps, nullptr, nullptr);
+    self->mailbox.publish(sample);
+    gst_sample_unref(sample);
+
+    // Either the waiter sees the new sequence before it sleeps, or it is
+    // counted here and the lock makes sure it is asleep before the notify
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (self->waiters.load(std::memory_order_relaxed)) {
+        { std::lock_guard<std::mutex> lock(self->wait_mutex); }
+        self->arrived.notify_all();
+    }
+    return GST_PAD_PROBE_OK;
+}
@@ -0,0 +1,270 @@
+#include "FrameStore.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace framestore;
+
+static uint64_t align_up(uint64_t value, uint64_t to) {
+    return (value + to - 1) / to * to;
+}
+
+// [offset, offset + count * item) lies inside a mapping of `size` bytes,
+// without overflowing on corrupt values
+static bool within(uint64_t offset, uint64_t count, uint64_t item, uint64_t size) {
+    return offset <= size && (item == 0 || count <= (size - offset) / item);
+}
+
+FrameStoreWriter::FrameStoreWriter(const std::string& path, uint64_t capacity, size_t queue_depth)
+    : path(path), capacity(capacity), queue_depth(queue_depth) {
+    worker = std::thread(&FrameStoreWriter::run, this);
+}
+
+FrameStoreWriter::~FrameStoreWriter() {
+    close();
+}
+
+bool FrameStoreWriter::submit(Frame&& frame) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!closing && queue.size() < queue_depth) {
+            queue.push_back(std::move(frame));
+            cv.notify_one();
+            return true;
+        }
+    }
+    dropped_queue_full++;
+    if (frame.release) {
+        frame.release();
+    }
+    return false;
+}
+
+void FrameStoreWriter::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closing) {
+            return;
+        }
+        closing = true;
+    }
+    cv.notify_one();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    finish();
+    std::cout << "Raw capture closed: " << written << " frames in " << path
+              << (part ? " and " + std::to_string(part) + " more files" : std::string()) << ", "
+              << dropped_queue_full << " dropped (queue full), "
+              << dropped_store_full << " dropped (store full)" << std::endl;
+}
+
+void FrameStoreWriter::finish() {
+    if (map) {
+        header->dropped_queue_full = dropped_queue_full;
+        header->dropped_store_full = dropped_store_full;
+        msync(map, map_size, MS_SYNC);
+        munmap(map, map_size);
+        map = nullptr;
+        header = nullptr;
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+bool FrameStoreWriter::fits(const Frame& frame) const {
+    return frame.width == header->width && frame.height == header->height && frame.fourcc == header->fourcc &&
+           frame.size <= header->slot_size;
+}
+
+std::string FrameStoreWriter::part_path() const {
+    if (!part) {
+        return path;
+    }
+    std::filesystem::path next(path);
+    next.replace_filename(next.stem().string() + "_" + std::to_string(part) + next.extension().string());
+    return next.string();
+}
+
+// Sized from the first frame: every slot fits one frame of that size.
+bool FrameStoreWriter::create(const Frame& first) {
+    std::string file = part_path();
+    count = 0;
+    uint64_t slot_size = align_up(first.size, alignment);
+    uint64_t index_offset = header_size;
+    uint64_t data_offset = align_up(index_offset + capacity * sizeof(IndexEntry), alignment);
+    map_size = data_offset + capacity * slot_size;
+
+    fd = open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("Failed to create frame store");
+        return false;
+    }
+    // Reserve the blocks now so the writer never hits ENOSPC through the mapping
+    int err = posix_fallocate(fd, 0, map_size);
+    if (err != 0) {
+        std::cerr << "Failed to preallocate " << map_size << " bytes for " << file << ": "
+                  << strerror(err) << std::endl;
+        return false;
+    }
+    void* mapped = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        perror("Failed to map frame store");
+        return false;
+    }
+    map = static_cast<uint8_t*>(mapped);
+    madvise(map + data_offset, map_size - data_offset, MADV_SEQUENTIAL);
+
+    header = reinterpret_cast<Header*>(map);
+    std::memset(header, 0, header_size);
+    header->magic = magic;
+    header->version = version;
+    header->width = first.width;
+    header->height = first.height;
+    header->fourcc = first.fourcc;
+    header->slot_size = slot_size;
+    header->capacity = capacity;
+    header->index_offset = index_offset;
+    header->data_offset = data_offset;
+
+    std::cout << "Raw capture to " << file << ": " << capacity << " slots of " << slot_size
+              << " bytes (" << (map_size >> 20) << " MiB)" << std::endl;
+    return true;
+}
+
+void FrameStoreWriter::store(Frame& frame) {
+    uint64_t n = count;
+    if (n >= capacity) {
+        dropped_store_full++;
+        return;
+    }
+    uint64_t offset = header->data_offset + n * header->slot_size;
+    std::memcpy(map + offset, frame.data, frame.size);
+
+    auto index = reinterpret_cast<IndexEntry*>(map + header->index_offset);
+    index[n] = {frame.timestamp_ns, frame.sequence, frame.fourcc, static_cast<uint32_t>(frame.size), offset};
+    count = n + 1;
+    written++;
+}
+
+// Starts writeback of the batch's slots and index entries, then publishes the
+// new frame count so readers never see a frame whose bytes are incomplete.
+void FrameStoreWriter::flush(uint64_t first_frame, uint64_t count) {
+    long page = sysconf(_SC_PAGESIZE);
+    uint64_t data_begin = header->data_offset + first_frame * header->slot_size;
+    msync(map + data_begin, count * header->slot_size, MS_ASYNC);
+
+    uint64_t index_begin = header->index_offset + first_frame * sizeof(IndexEntry);
+    uint64_t index_page = index_begin / page * page;
+    msync(map + index_page, index_begin + count * sizeof(IndexEntry) - index_page, MS_ASYNC);
+
+    __atomic_store_n(&header->frame_count, first_frame + count, __ATOMIC_RELEASE);
+    header->dropped_queue_full = dropped_queue_full;
+    header->dropped_store_full = dropped_store_full;
+}
+
+void FrameStoreWriter::run() {
+    std::deque<Frame> batch;
+    bool failed = false;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this]() { return closing || !queue.empty(); });
+            if (queue.empty() && closing) {
+                break;
+            }
+            // Take everything that is waiting, up to one batch
+            while (!queue.empty() && batch.size() < batch_size) {
+                batch.push_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+        }
+
+        uint64_t first = count;
+        for (auto& frame : batch) {
+            if (map && !fits(frame)) {
+                // New caps: this file is complete, the next gets slots of the new size
+                if (count > first) {
+                    flush(first, count - first);
+                }
+                finish();
+                ++part;
+            }
+            if (!map && !failed) {
+                failed = !create(frame);
+                first = count;
+            }
+            if (!failed) {
+                store(frame);
+            }
+            if (frame.release) {
+                frame.release();
+            }
+        }
+        if (!failed && count > first) {
+            flush(first, count - first);
+        }
+        batch.clear();
+    }
+}
+
+FrameStoreReader::FrameStoreReader(const std::string& path) {
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Unable to open frame store " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < header_size) {
+        ::close(fd);
+        throw std::runtime_error("Frame store " + path + " is truncated");
+    }
+    map_size = st.st_size;
+    void* mapped = mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        ::close(fd);
+        throw std::runtime_error("Unable to map frame store " + path);
+    }
+    map = static_cast<const uint8_t*>(mapped);
+    header = reinterpret_cast<const Header*>(map);
+
+    // A truncated or corrupt file must not send frame() outside the mapping
+    if (header->magic != magic || header->version != version || header->index_offset < header_size ||
+        !within(header->index_offset, header->capacity, sizeof(IndexEntry), map_size) ||
+        !within(header->data_offset, header->capacity, header->slot_size, map_size)) {
+        munmap(const_cast<uint8_t*>(map), map_size);
+        ::close(fd);
+        throw std::runtime_error(path + " is not a valid frame store");
+    }
+}
+
+FrameStoreReader::~FrameStoreReader() {
+    munmap(const_cast<uint8_t*>(map), map_size);
+    ::close(fd);
+}
+
+uint64_t FrameStoreReader::size() const {
+    return std::min(__atomic_load_n(&header->frame_count, __ATOMIC_ACQUIRE), header->capacity);
+}
+
+FrameStoreReader::FrameRef FrameStoreReader::frame(uint64_t i) const {
+    if (i >= size()) {
+        throw std::out_of_range("frame index out of range");
+    }
+    auto index = reinterpret_cast<const IndexEntry*>(map + header->index_offset);
+    const IndexEntry& entry = index[i];
+    if (entry.offset < header->data_offset || entry.size > header->slot_size ||
+        !within(entry.offset, 1, entry.size, map_size)) {
+        throw std::runtime_error("frame " + std::to_string(i) + " has a corrupt index entry");
+    }
+    return {map + entry.offset, entry.size, entry.fourcc, entry.timestamp_ns, entry.sequence};
+}
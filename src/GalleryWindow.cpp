@@ -0,0 +1,204 @@
+#include "GalleryWindow.h"
+#include "Tracer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <dirent.h>
+#include <iostream>
+#include <sys/stat.h>
+
+GalleryWindow::GalleryWindow(const std::vector<std::string>& directories, std::size_t cache_bytes)
+    : directories(directories),
+      cache(cache_bytes),
+      pool(2, "thumbnail") {
+    set_title("Captures");
+    set_default_size(900, 600);
+
+    store = Gtk::ListStore::create(columns);
+    icons.set_model(store);
+    icons.set_pixbuf_column(columns.thumbnail);
+    icons.set_text_column(columns.name);
+    icons.set_item_width(thumb_size);
+    icons.signal_item_activated().connect(sigc::mem_fun(*this, &GalleryWindow::on_item_activated));
+
+    placeholder = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, false, 8, thumb_size, thumb_size * 9 / 16);
+    placeholder->fill(0x404040ff);
+
+    scroller.set_policy(Gtk::POLICY_NEVER, Gtk::POLICY_AUTOMATIC);
+    scroller.add(icons);
+    add(scroller);
+
+    cache.set_evict_callback([this](const std::string& path) { on_evicted(path); });
+    decoded_signal.connect(sigc::mem_fun(*this, &GalleryWindow::on_decoded));
+    scroller.get_vadjustment()->signal_value_changed().connect(sigc::mem_fun(*this, &GalleryWindow::request_visible));
+    icons.signal_size_allocate().connect([this](Gtk::Allocation&) { request_visible(); });
+
+    refresh();
+    show_all_children();
+}
+
+GalleryWindow::~GalleryWindow() {
+    pool.clear();
+}
+
+void GalleryWindow::refresh() {
+    struct Entry {
+        std::string path;
+        std::string name;
+        time_t mtime;
+        off_t size;
+    };
+    std::vector<Entry> entries;
+    for (const auto& directory : directories) {
+        DIR *dir = opendir(directory.c_str());
+        if (!dir) {
+            continue;
+        }
+        while (dirent *entry = readdir(dir)) {
+            std::string path = directory + "/" + entry->d_name;
+            if (!is_image_file(path) && !is_video_file(path)) {
+                continue;
+            }
+            struct stat st;
+            if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+                entries.push_back({path, entry->d_name, st.st_mtime, st.st_size});
+            }
+        }
+        closedir(dir);
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.mtime > b.mtime; });
+
+    // Dropped decodes never report back, so forget them here; one already
+    // running may be requested again, which only costs a duplicate decode
+    pool.clear();
+    in_flight.clear();
+    ++generation;
+
+    // A capture or segment may still have been written at the last scan:
+    // failures get another try, and anything rewritten since is decoded again
+    failed.clear();
+    std::map<std::string, std::pair<time_t, off_t>> now_scanned;
+    for (const auto& entry : entries) {
+        auto stamp = std::make_pair(entry.mtime, entry.size);
+        auto previous = scanned.find(entry.path);
+        if (previous != scanned.end() && previous->second != stamp) {
+            cache.erase(entry.path);
+        }
+        now_scanned[entry.path] = stamp;
+    }
+    scanned = std::move(now_scanned);
+    rows.clear();
+    store->clear();
+    for (const auto& entry : entries) {
+        auto row = *store->append();
+        auto cached = cache.get(entry.path);
+        row[columns.thumbnail] = cached ? *cached : placeholder;
+        row[columns.name] = entry.name;
+        row[columns.path] = entry.path;
+        rows[entry.path] = row;
+    }
+    std::cout << "Gallery: " << entries.size() << " captures" << std::endl;
+    request_visible();
+}
+
+// Queue decodes for what's on screen, nearest first. Anything already cached,
+// decoding or known-broken is left alone.
+void GalleryWindow::request_visible() {
+    Gtk::TreeModel::Path first, last;
+    if (!icons.get_visible_range(first, last)) {
+        return;
+    }
+    int begin = first[0];
+    int end = last[0];
+    // A screen's worth of read-ahead in each direction
+    int span = end - begin + 1;
+    begin = std::max(0, begin - span);
+    end = std::min((int)store->children().size() - 1, end + span);
+
+    std::set<std::string> now_visible;
+    std::vector<std::string> wanted;
+    for (int i = begin; i <= end; ++i) {
+        auto row = store->children()[i];
+        std::string path = row[columns.path];
+        now_visible.insert(path);
+        if (!cache.contains(path) && !in_flight.count(path) && !failed.count(path)) {
+            wanted.push_back(path);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(visible_mutex);
+        visible = std::move(now_visible);
+    }
+    uint64_t current = ++generation;
+
+    // The pool runs the newest task first, so submit the top of the view last
+    for (auto it = wanted.rbegin(); it != wanted.rend(); ++it) {
+        const std::string path = *it;
+        in_flight.insert(path);
+        pool.submit([this, path, current]() {
+            Decoded result{path, false, false, {}};
+            if (generation.load() != current) {
+                std::lock_guard<std::mutex> lock(visible_mutex);
+                result.skipped = !visible.count(path);
+            }
+            if (!result.skipped) {
+                TraceSpan span("gallery", "thumbnail_decode");
+                result.ok = load_thumbnail(path, thumb_size, result.thumbnail);
+            }
+            {
+                std::lock_guard<std::mutex> lock(decoded_mutex);
+                decoded.push_back(std::move(result));
+            }
+            decoded_signal.emit();
+        });
+    }
+}
+
+void GalleryWindow::on_decoded() {
+    std::vector<Decoded> batch;
+    {
+        std::lock_guard<std::mutex> lock(decoded_mutex);
+        batch.swap(decoded);
+    }
+    for (auto& result : batch) {
+        in_flight.erase(result.path);
+        if (result.skipped) {
+            continue; // requested again if it comes back into view
+        }
+        if (!result.ok) {
+            failed.insert(result.path);
+            continue;
+        }
+        const Thumbnail& t = result.thumbnail;
+        auto pixbuf = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, false, 8, t.width, t.height);
+        for (int y = 0; y < t.height; ++y) {
+            std::memcpy(pixbuf->get_pixels() + (size_t)y * pixbuf->get_rowstride(),
+                        t.rgb.data() + (size_t)y * t.width * 3, (size_t)t.width * 3);
+        }
+        set_row_thumbnail(result.path, pixbuf);
+        cache.put(result.path, pixbuf, (size_t)pixbuf->get_rowstride() * t.height);
+    }
+}
+
+// Rows hold the pixbufs the cache owns; drop them too so the budget is real
+void GalleryWindow::on_evicted(const std::string& path) {
+    set_row_thumbnail(path, placeholder);
+}
+
+void GalleryWindow::set_row_thumbnail(const std::string& path, const Glib::RefPtr<Gdk::Pixbuf>& pixbuf) {
+    auto it = rows.find(path);
+    if (it != rows.end()) {
+        (*it->second)[columns.thumbnail] = pixbuf;
+    }
+}
+
+void GalleryWindow::on_item_activated(const Gtk::TreeModel::Path& path) {
+    auto row = *store->get_iter(path);
+    std::string file = row[columns.path];
+    std::cout << "Opening " << file << std::endl;
+    try {
+        Gio::AppInfo::launch_default_for_uri(Gio::File::create_for_path(file)->get_uri());
+    } catch (const Glib::Error& e) {
+        std::cerr << "Could not open " << file << ": " << e.what() << std::endl;
+    }
+}
@@ -0,0 +1,232 @@
+#include "HdrCapture.h"
+#include "FrameConvert.h"
+#include "Snapshot.h"
+#include "Tracer.h"
+
+#include <linux/videodev2.h>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/photo.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+double elapsed_ms(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+} // namespace
+
+HdrCapture::HdrCapture(CameraControls& controls, FrameMailbox& mailbox, const HdrSettings& settings)
+    : controls(controls), mailbox(mailbox), settings(settings), pool(std::max(settings.threads, 1), "hdr") {}
+
+HdrCapture::~HdrCapture() {
+    aborting = true;
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+bool HdrCapture::capture() {
+    if (running.exchange(true)) {
+        return false;
+    }
+    if (worker.joinable()) {
+        worker.join();
+    }
+    worker = std::thread(&HdrCapture::run, this);
+    return true;
+}
+
+void HdrCapture::run() {
+    TraceSpan span("hdr", "hdr_capture");
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<cv::Mat> frames;
+    if (!bracket(frames)) {
+        running = false;
+        return;
+    }
+    double bracket_ms = elapsed_ms(begin);
+
+    // Scale the fusion down if the last measured rate says full size won't fit
+    auto fuse_begin = std::chrono::steady_clock::now();
+    double megapixels = frames[0].total() / 1e6;
+    double remaining_ms = settings.budget_ms - bracket_ms;
+    double scale = 1;
+    if (fuse_ms_per_megapixel > 0 && fuse_ms_per_megapixel * megapixels > remaining_ms) {
+        scale = std::max(0.25, std::sqrt(std::max(remaining_ms, 0.0) / (fuse_ms_per_megapixel * megapixels)));
+        for (auto& frame : frames) {
+            cv::resize(frame, frame, cv::Size(), scale, scale, cv::INTER_AREA);
+        }
+    }
+
+    std::vector<cv::Mat> aligned;
+    cv::createAlignMTB()->process(frames, aligned);
+    cv::Mat fused = fuse(aligned);
+    double fuse_ms = elapsed_ms(fuse_begin);
+    fuse_ms_per_megapixel = fuse_ms / (megapixels * scale * scale);
+
+    std::string path = capture_path(settings.directory, "hdr");
+    cv::Mat bgr;
+    cv::cvtColor(fused, bgr, cv::COLOR_RGB2BGR);
+    bool saved = g_mkdir_with_parents(settings.directory.c_str(), 0755) == 0 && cv::imwrite(path, bgr);
+    double total_ms = elapsed_ms(begin);
+    std::cout << "HDR " << frames.size() << " exposures at " << fused.cols << "x" << fused.rows << ": bracket "
+              << (int)bracket_ms << " ms, align+fuse " << (int)fuse_ms << " ms"
+              << (total_ms <= settings.budget_ms ? " (within " : " (over ") << settings.budget_ms << " ms budget)"
+              << std::endl;
+    std::cout << (saved ? "HDR saved to " + path : "HDR save failed: " + path) << std::endl;
+    running = false;
+}
+
+// One settled frame per exposure, darkest first; the camera's exposure mode
+// and time are put back whatever happens.
+bool HdrCapture::bracket(std::vector<cv::Mat>& frames) {
+    TraceSpan span("hdr", "hdr_bracket");
+    mailbox.set_bracketing(true);
+    int32_t auto_mode = V4L2_EXPOSURE_MANUAL;
+    bool has_auto = controls.has(V4L2_CID_EXPOSURE_AUTO) && controls.get(V4L2_CID_EXPOSURE_AUTO, auto_mode);
+    if (has_auto && auto_mode != V4L2_EXPOSURE_MANUAL) {
+        controls.set(V4L2_CID_EXPOSURE_AUTO, V4L2_EXPOSURE_MANUAL);
+    }
+    // Read after the switch: cameras hold the auto exposure's last value
+    int32_t base = 0;
+    if (!controls.has(V4L2_CID_EXPOSURE_ABSOLUTE) || !controls.get(V4L2_CID_EXPOSURE_ABSOLUTE, base) || base <= 0) {
+        std::cerr << "HDR needs a camera with exposure time control." << std::endl;
+        if (has_auto && auto_mode != V4L2_EXPOSURE_MANUAL) {
+            controls.set(V4L2_CID_EXPOSURE_AUTO, auto_mode);
+        }
+        mailbox.set_bracketing(false);
+        return false;
+    }
+
+    int count = std::max(settings.frames, 2);
+    bool ok = true;
+    for (int i = 0; i < count && ok && !aborting; ++i) {
+        double ev = settings.stops * (i - (count - 1) / 2.0);
+        controls.set(V4L2_CID_EXPOSURE_ABSOLUTE, std::max(1, (int32_t)std::lround(base * std::pow(2.0, ev))));
+        cv::Mat rgb;
+        ok = take_settled(rgb);
+        if (ok) {
+            frames.push_back(rgb);
+        }
+    }
+
+    controls.set(V4L2_CID_EXPOSURE_ABSOLUTE, base);
+    if (has_auto && auto_mode != V4L2_EXPOSURE_MANUAL) {
+        controls.set(V4L2_CID_EXPOSURE_AUTO, auto_mode);
+    }
+    // The restored exposure arrives late too; analysers stay off until then
+    uint64_t seen = mailbox.frames();
+    uint64_t settled = seen + std::max(settings.settle_frames, 1);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (seen < settled && !aborting && std::chrono::steady_clock::now() < deadline) {
+        if (GstSample *sample = mailbox.wait(&seen, 50)) {
+            gst_sample_unref(sample);
+        }
+    }
+    mailbox.set_bracketing(false);
+    if (!ok || (int)frames.size() != count) {
+        std::cerr << "HDR bracket incomplete, nothing saved." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// First frame at least settle_frames after the exposure change
+bool HdrCapture::take_settled(cv::Mat& rgb) {
+    uint64_t sequence = mailbox.frames() + std::max(settings.settle_frames, 1) - 1;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (!aborting && std::chrono::steady_clock::now() < deadline) {
+        GstSample *sample = mailbox.wait(&sequence, 50);
+        if (!sample) {
+            continue;
+        }
+        bool converted = sample_to_rgb(sample, rgb);
+        gst_sample_unref(sample);
+        if (!converted) {
+            std::cerr << "HDR: unsupported frame format." << std::endl;
+        }
+        return converted;
+    }
+    return false;
+}
+
+// Mertens exposure fusion: every pixel is a blend of the exposures weighted
+// by local contrast, saturation and closeness to mid-grey, blended across a
+// Laplacian pyramid so the weights don't show as seams. The same method as
+// cv::MergeMertens, laid out so the per-exposure work runs on the pool.
+cv::Mat HdrCapture::fuse(const std::vector<cv::Mat>& images) {
+    TraceSpan span("hdr", "hdr_fuse");
+    size_t count = images.size();
+    cv::Size size = images[0].size();
+    int levels = (int)std::log2((double)std::min(size.width, size.height));
+
+    std::vector<cv::Mat> weights(count);
+    std::vector<std::vector<cv::Mat>> pyramids(count);
+    pool.parallel_for(count, [&](size_t i) {
+        cv::Mat image, gray, contrast;
+        images[i].convertTo(image, CV_32FC3, 1.0 / 255);
+        cv::cvtColor(image, gray, cv::COLOR_RGB2GRAY);
+        cv::Laplacian(gray, contrast, CV_32F);
+        contrast = cv::abs(contrast);
+
+        std::vector<cv::Mat> channels;
+        cv::split(image, channels);
+        cv::Mat mean = (channels[0] + channels[1] + channels[2]) / 3;
+        cv::Mat saturation = cv::Mat::zeros(size, CV_32F);
+        cv::Mat exposedness = cv::Mat::ones(size, CV_32F);
+        for (auto& channel : channels) {
+            cv::Mat deviation = channel - mean;
+            saturation += deviation.mul(deviation);
+            cv::Mat centred = channel - 0.5;
+            cv::Mat gauss;
+            cv::exp(centred.mul(centred) * (-1 / (2 * 0.2 * 0.2)), gauss);
+            exposedness = exposedness.mul(gauss);
+        }
+        cv::sqrt(saturation / 3, saturation);
+        weights[i] = contrast.mul(saturation).mul(exposedness) + 1e-12;
+
+        std::vector<cv::Mat>& pyramid = pyramids[i];
+        cv::buildPyramid(image, pyramid, levels);
+        for (int level = 0; level < levels; ++level) {
+            cv::Mat up;
+            cv::pyrUp(pyramid[level + 1], up, pyramid[level].size());
+            pyramid[level] -= up;
+        }
+    });
+
+    cv::Mat total = weights[0].clone();
+    for (size_t i = 1; i < count; ++i) {
+        total += weights[i];
+    }
+    pool.parallel_for(count, [&](size_t i) {
+        std::vector<cv::Mat> weight_pyramid;
+        cv::buildPyramid(weights[i] / total, weight_pyramid, levels);
+        for (int level = 0; level <= levels; ++level) {
+            cv::Mat weight3;
+            cv::merge(std::vector<cv::Mat>(3, weight_pyramid[level]), weight3);
+            pyramids[i][level] = pyramids[i][level].mul(weight3);
+        }
+    });
+
+    std::vector<cv::Mat> result(levels + 1);
+    pool.parallel_for(levels + 1, [&](size_t level) {
+        result[level] = pyramids[0][level].clone();
+        for (size_t i = 1; i < count; ++i) {
+            result[level] += pyramids[i][level];
+        }
+    });
+    for (int level = levels; level > 0; --level) {
+        cv::Mat up;
+        cv::pyrUp(result[level], up, result[level - 1].size());
+        result[level - 1] += up;
+    }
+    cv::Mat fused;
+    result[0].convertTo(fused, CV_8UC3, 255);
+    return fused;
+}
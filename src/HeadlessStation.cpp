@@ -0,0 +1,237 @@
+#include "HeadlessStation.h"
+#include "ResourceUsage.h"
+#include "Snapshot.h"
+#include "ThreadPolicy.h"
+#include "Tracer.h"
+
+#include <glib-unix.h>
+
+#include <iostream>
+#include <sstream>
+
+HeadlessStation::HeadlessStation(const AppConfig& config) : config(config) {
+    if (!config.trace_path.empty()) {
+        Tracer::instance().enable(config.trace_path);
+    }
+    ThreadPolicy::instance().configure(config.thread_cpus, config.thread_priorities);
+
+    // The keypad opens slowly; don't hold up the first frame for it
+    keypad_init_thread = std::thread(&HeadlessStation::init_keypad, this);
+    ThreadPolicy::instance().adopt_current("ui"); // after starting threads that would inherit it
+
+    loop = g_main_loop_new(nullptr, FALSE);
+    camera = std::make_unique<CameraPipeline>(config);
+    control = std::make_unique<ControlSocket>(config.control_socket,
+        [this](const std::string& command) { return handle_command(command); });
+
+    g_unix_signal_add(SIGINT, &HeadlessStation::on_quit_signal, this);
+    g_unix_signal_add(SIGTERM, &HeadlessStation::on_quit_signal, this);
+    if (config.thread_report_seconds > 0) {
+        g_timeout_add_seconds(config.thread_report_seconds, [](gpointer) -> gboolean {
+            ThreadPolicy::instance().report();
+            print_resource_usage("headless");
+            return G_SOURCE_CONTINUE;
+        }, nullptr);
+    }
+}
+
+HeadlessStation::~HeadlessStation() {
+    if (keypad_init_thread.joinable()) {
+        keypad_init_thread.join();
+    }
+    if (keypad) {
+        keypad->reverse();
+        delete keypad;
+    }
+    control.reset();
+    if (mosaic) {
+        // Reads the mailbox, so stopped before the camera; saved here since
+        // the snapshot worker drops what is still queued
+        mosaic->stop();
+        mosaic->save(config.captures_dir);
+        mosaic.reset();
+    }
+    compare.reset();
+    camera.reset(); // finalizes the open recording segment
+    print_resource_usage("headless");
+    Tracer::instance().dump();
+    g_main_loop_unref(loop);
+}
+
+int HeadlessStation::run() {
+    if (!camera->valid()) {
+        return 1;
+    }
+    camera->start();
+    std::cout << "Headless station running" << (config.record_dir.empty() ? "" : ", recording to " + config.record_dir)
+              << std::endl;
+    g_main_loop_run(loop);
+    return 0;
+}
+
+gboolean HeadlessStation::on_quit_signal(gpointer user_data) {
+    auto self = static_cast<HeadlessStation*>(user_data);
+    std::cout << "Stopping..." << std::endl;
+    g_main_loop_quit(self->loop);
+    return G_SOURCE_CONTINUE;
+}
+
+void HeadlessStation::init_keypad() {
+    try {
+        keypad = new FT232HHandler([this](int button) {
+            Tracer::instance().instant("keypad", "button_event");
+            // Back onto the main loop, like the GUI's idle handler
+            auto call = new std::pair<HeadlessStation*, int>(this, button);
+            g_idle_add([](gpointer data) -> gboolean {
+                auto call = static_cast<std::pair<HeadlessStation*, int>*>(data);
+                call->first->handle_button_press(call->second);
+                delete call;
+                return G_SOURCE_REMOVE;
+            }, call);
+        });
+        keypad->thread_init = []() { ThreadPolicy::instance().adopt_current("keypad"); };
+        keypad->initialize();
+        keypad->start();
+    } catch (const std::runtime_error& e) {
+        std::cout << "Error: " + std::string(e.what()) << std::endl;
+    }
+}
+
+void HeadlessStation::handle_button_press(int button) {
+    TraceSpan span("ui", "button_press");
+    std::cout << "Button " + std::to_string(button) + " pressed!" << std::endl;
+    switch (button) {
+    case 1:
+        std::cout << handle_command(camera->recording() ? "record stop" : "record start") << std::endl;
+        break;
+    case 2:
+        std::cout << handle_command(paused ? "play" : "pause") << std::endl;
+        break;
+    case 3:
+        std::cout << handle_command("snapshot") << std::endl;
+        break;
+    case 4:
+        std::cout << status() << std::endl;
+        break;
+    default:
+        break;
+    }
+}
+
+std::string HeadlessStation::handle_command(const std::string& command) {
+    if (command == "status") {
+        return status();
+    }
+    if (command == "record start") {
+        return camera->start_recording() ? "ok recording" : "error recording not available";
+    }
+    if (command == "record stop") {
+        camera->stop_recording();
+        return "ok stopped";
+    }
+    if (command == "snapshot") {
+        return snapshot();
+    }
+    if (command == "pause") {
+        camera->pause();
+        paused = true;
+        return "ok paused";
+    }
+    if (command == "play") {
+        camera->play();
+        paused = false;
+        return "ok playing";
+    }
+    if (command == "flat on" || command == "flat off") {
+        camera->flat_field()->set_enabled(command == "flat on");
+        return "ok " + command;
+    }
+    if (command == "flat calibrate") {
+        return camera->flat_field()->calibrate() ? "ok calibrating" : "error calibration already running";
+    }
+    if (command == "mosaic start") {
+        if (mosaic) {
+            return "error mosaic already running";
+        }
+        MosaicSettings settings;
+        settings.scale = config.mosaic_scale;
+        mosaic = std::make_unique<Mosaic>(camera->mailbox(), settings);
+        return "ok mosaic started";
+    }
+    if (command == "mosaic stop") {
+        return stop_mosaic();
+    }
+    if (command == "hdr") {
+        return camera->hdr().capture() ? "ok hdr capturing" : "error hdr capture already running";
+    }
+    if (command == "compare off") {
+        compare.reset();
+        return "ok compare off";
+    }
+    if (command.compare(0, 8, "compare ") == 0) {
+        auto next = std::make_unique<ReferenceCompare>(camera->mailbox());
+        if (!next->load(command.substr(8))) {
+            return "error cannot read " + command.substr(8);
+        }
+        next->set_mode(CompareMode::Split); // any mode but Off scores
+        compare = std::move(next);
+        return "ok comparing";
+    }
+    if (command == "quit") {
+        g_main_loop_quit(loop);
+        return "ok quitting";
+    }
+    return "error unknown command (status, record start|stop, snapshot, pause, play, flat on|off|calibrate, mosaic start|stop, hdr, compare <image>|off, quit)";
+}
+
+std::string HeadlessStation::snapshot() {
+    GstSample *sample = camera->mailbox().take();
+    if (!sample) {
+        return "error no frame yet";
+    }
+    std::string directory = config.captures_dir;
+    std::shared_ptr<GstSample> frame(sample, gst_sample_unref); // released even if never run
+    snapshots.submit([frame, directory]() {
+        std::string path = save_snapshot(frame.get(), directory);
+        std::cout << (path.empty() ? "Snapshot failed" : "Snapshot saved to " + path) << std::endl;
+    });
+    return "ok snapshot queued";
+}
+
+// The full-resolution render and JPEG encode run on the snapshot worker
+std::string HeadlessStation::stop_mosaic() {
+    if (!mosaic) {
+        return "error no mosaic running";
+    }
+    mosaic->stop();
+    std::shared_ptr<Mosaic> finished(std::move(mosaic));
+    std::string directory = config.captures_dir;
+    snapshots.submit([finished, directory]() { finished->save(directory); });
+    return "ok mosaic saving";
+}
+
+std::string HeadlessStation::status() {
+    PipelineMetrics& metrics = camera->metrics();
+    FrameIntegrity& integrity = camera->integrity();
+    std::ostringstream out;
+    out << "ok " << (paused ? "paused" : "playing")
+        << " recording=" << (camera->recording() ? 1 : 0)
+        << " fps=" << metrics.fps.load()
+        << " latency_ms=" << metrics.latency_ms.load()
+        << " sensor_drops=" << integrity.sensor_drops.load();
+    if (Timelapse* timelapse = camera->timelapse()) {
+        out << " timelapse_frames=" << timelapse->frames_kept();
+    }
+    if (camera->flat_field()->enabled()) {
+        out << " flat_ms=" << camera->flat_field()->apply_ms()
+            << " flat_copies=" << camera->flat_field()->frames_copied();
+    }
+    if (mosaic) {
+        out << " mosaic_frames=" << mosaic->frames_placed();
+    }
+    if (compare && compare->scored()) {
+        out << " psnr_db=" << compare->psnr() << " ssim=" << compare->ssim();
+    }
+    out << " | " << ResourceUsage::sample().summary();
+    return out.str();
+}
@@ -27,6 +27,7 @@
     void FT232HHandler::start() {
         running = true;
         gpio_thread = std::thread([this]() {
+            if (thread_init) thread_init();
             while (running) {
                 unsigned char gpio_state;
                 if (ftdi_read_pins(ftdi, &gpio_state) < 0) {
@@ -37,8 +38,12 @@
                     // Detect specific button presses
                     if (!(gpio_state & 0x04)) callback(1); // Button 1 4
                     if (!(gpio_state & 0x08)) callback(2); // Button 2 8
+                    if (!(gpio_state & 0x01) && !(gpio_state & 0x02)) {
+                        callback(6); // Buttons 3+4 together: next display mode
+                    } else {
                     if (!(gpio_state & 0x01)) callback(3); // Button 3 1
                     if (!(gpio_state & 0x02)) callback(4); // Button 4 2
+                    }
                     prev_state = gpio_state;
                 }
                 usleep(250000);  // Poll every 250ms
@@ -0,0 +1,202 @@
+#include "LensCorrection.h"
+#include "Tracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+// Output tiles: a few KB of table and a compact source region each
+static const int tile_width = 256;
+static const int tile_height = 32;
+
+LensCorrection::LensCorrection(GstPad* pad, const LensModel& lens, const std::string& cache_dir, int threads)
+    : pad(pad), lens(lens), cache_dir(cache_dir), pool(std::max(threads, 1), "lens") {
+    gst_object_ref(pad);
+    probe_id = gst_pad_add_probe(pad, (GstPadProbeType)(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM),
+                                 &LensCorrection::on_data, this, nullptr);
+}
+
+LensCorrection::~LensCorrection() {
+    gst_pad_remove_probe(pad, probe_id);
+    gst_object_unref(pad);
+    if (buffer_pool) {
+        gst_buffer_pool_set_active(buffer_pool, FALSE);
+        gst_object_unref(buffer_pool);
+    }
+}
+
+void LensCorrection::set_crop(const ViewCrop& crop) {
+    std::lock_guard<std::mutex> lock(crop_mutex);
+    this->crop = crop;
+    crop_changed = true;
+}
+
+std::shared_ptr<const RemapTable> LensCorrection::table_for(int width, int height, const ViewCrop& crop) {
+    std::string key = std::to_string(width) + "x" + std::to_string(height) + "-" + std::to_string(crop.left) + "." +
+                      std::to_string(crop.top) + "." + std::to_string(crop.right) + "." + std::to_string(crop.bottom);
+    if (auto *hit = tables.get(key)) {
+        return *hit;
+    }
+
+    TraceSpan span("lens", "lens_table");
+    auto begin = std::chrono::steady_clock::now();
+    std::string path = cache_dir + "/lens-" + key + ".bin";
+    auto loaded = std::make_shared<RemapTable>();
+    bool cached = loaded->load(path) && loaded->matches(width, height, crop, lens);
+    if (!cached) {
+        *loaded = RemapTable::build(width, height, crop, lens);
+        if (loaded->entries.empty()) {
+            std::cerr << "Lens correction does not handle " << width << "x" << height << std::endl;
+            return nullptr;
+        }
+        if (!loaded->save(path)) {
+            std::cerr << "Failed to write lens table " << path << std::endl;
+        }
+    }
+    std::cout << "Lens table " << key << (cached ? " loaded" : " built") << " in "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count() << " ms"
+              << std::endl;
+
+    std::shared_ptr<const RemapTable> result = loaded;
+    tables.put(key, result, loaded->entries.size() * sizeof(uint32_t));
+    return result;
+}
+
+// On the streaming thread, at a caps change
+bool LensCorrection::prepare(const GstVideoInfo& info) {
+    switch (GST_VIDEO_INFO_FORMAT(&info)) {
+    case GST_VIDEO_FORMAT_YUY2:
+    case GST_VIDEO_FORMAT_YVYU:
+    case GST_VIDEO_FORMAT_UYVY:
+    case GST_VIDEO_FORMAT_GRAY8:
+    case GST_VIDEO_FORMAT_I420:
+    case GST_VIDEO_FORMAT_YV12:
+    case GST_VIDEO_FORMAT_NV12:
+    case GST_VIDEO_FORMAT_NV21:
+        break;
+    default:
+        if (!warned_format) {
+            std::cerr << "Lens correction does not handle " << gst_video_format_to_string(GST_VIDEO_INFO_FORMAT(&info))
+                      << "; showing frames uncorrected." << std::endl;
+            warned_format = true;
+        }
+        return false;
+    }
+
+    if (buffer_pool) {
+        gst_buffer_pool_set_active(buffer_pool, FALSE);
+        gst_object_unref(buffer_pool);
+    }
+    // Frames in flight to the sink hold buffers; a few more than the
+    // display queue keeps the pool from running dry
+    buffer_pool = gst_video_buffer_pool_new();
+    GstCaps *caps = gst_video_info_to_caps(&info);
+    GstStructure *config = gst_buffer_pool_get_config(buffer_pool);
+    gst_buffer_pool_config_set_params(config, caps, GST_VIDEO_INFO_SIZE(&info), 4, 0);
+    gst_caps_unref(caps);
+    if (!gst_buffer_pool_set_config(buffer_pool, config) || !gst_buffer_pool_set_active(buffer_pool, TRUE)) {
+        std::cerr << "Failed to set up the lens correction buffer pool." << std::endl;
+        gst_object_unref(buffer_pool);
+        buffer_pool = nullptr;
+        return false;
+    }
+    crop_changed = true;
+    return true;
+}
+
+GstPadProbeReturn LensCorrection::on_data(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    auto self = static_cast<LensCorrection*>(user_data);
+
+    if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+        GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+        if (GST_EVENT_TYPE(event) == GST_EVENT_CAPS) {
+            GstCaps *caps = nullptr;
+            gst_event_parse_caps(event, &caps);
+            self->have_info = gst_video_info_from_caps(&self->video_info, caps) && self->prepare(self->video_info);
+        }
+        return GST_PAD_PROBE_OK;
+    }
+    if (!self->have_info) {
+        return GST_PAD_PROBE_OK;
+    }
+
+    if (self->crop_changed.exchange(false)) {
+        ViewCrop crop;
+        {
+            std::lock_guard<std::mutex> lock(self->crop_mutex);
+            crop = self->crop;
+        }
+        self->table = self->table_for(GST_VIDEO_INFO_WIDTH(&self->video_info),
+                                      GST_VIDEO_INFO_HEIGHT(&self->video_info), crop);
+    }
+    if (!self->table) {
+        return GST_PAD_PROBE_OK;
+    }
+
+    GstBuffer *in = GST_PAD_PROBE_INFO_BUFFER(info);
+    GstBuffer *out = nullptr;
+    if (gst_buffer_pool_acquire_buffer(self->buffer_pool, &out, nullptr) != GST_FLOW_OK) {
+        return GST_PAD_PROBE_OK;
+    }
+    GstVideoFrame in_frame, out_frame;
+    if (!gst_video_frame_map(&in_frame, &self->video_info, in, GST_MAP_READ)) {
+        gst_buffer_unref(out);
+        return GST_PAD_PROBE_OK;
+    }
+    if (!gst_video_frame_map(&out_frame, &self->video_info, out, GST_MAP_WRITE)) {
+        gst_video_frame_unmap(&in_frame);
+        gst_buffer_unref(out);
+        return GST_PAD_PROBE_OK;
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    self->remap(&in_frame, &out_frame, *self->table);
+    self->last_remap_ms.store(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count(),
+                              std::memory_order_relaxed);
+    gst_video_frame_unmap(&out_frame);
+    gst_video_frame_unmap(&in_frame);
+
+    gst_buffer_copy_into(out, in, (GstBufferCopyFlags)(GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS), 0, -1);
+    gst_buffer_unref(in);
+    GST_PAD_PROBE_INFO_DATA(info) = out;
+    return GST_PAD_PROBE_OK;
+}
+
+void LensCorrection::remap(const GstVideoFrame* in, GstVideoFrame* out, const RemapTable& table) {
+    TraceSpan span("lens", "lens_remap");
+    GstVideoFormat format = GST_VIDEO_FRAME_FORMAT(in);
+    int columns = (table.width + tile_width - 1) / tile_width;
+    int rows = (table.height + tile_height - 1) / tile_height;
+
+    auto src = [in](int plane) { return static_cast<const uint8_t*>(GST_VIDEO_FRAME_PLANE_DATA(in, plane)); };
+    auto dst = [out](int plane) { return static_cast<uint8_t*>(GST_VIDEO_FRAME_PLANE_DATA(out, plane)); };
+    auto src_stride = [in](int plane) { return GST_VIDEO_FRAME_PLANE_STRIDE(in, plane); };
+    auto dst_stride = [out](int plane) { return GST_VIDEO_FRAME_PLANE_STRIDE(out, plane); };
+
+    pool.parallel_for((size_t)columns * rows, [&](size_t index) {
+        int x0 = (int)(index % columns) * tile_width, y0 = (int)(index / columns) * tile_height;
+        RemapTile tile{x0, y0, std::min(x0 + tile_width, table.width), std::min(y0 + tile_height, table.height)};
+        switch (format) {
+        case GST_VIDEO_FORMAT_YUY2:
+        case GST_VIDEO_FORMAT_YVYU:
+        case GST_VIDEO_FORMAT_UYVY:
+            remap_packed422(table, src(0), src_stride(0), dst(0), dst_stride(0), tile,
+                            format == GST_VIDEO_FORMAT_UYVY ? 1 : 0);
+            break;
+        case GST_VIDEO_FORMAT_NV12:
+        case GST_VIDEO_FORMAT_NV21:
+            remap_plane(table, src(0), src_stride(0), dst(0), dst_stride(0), tile, 16);
+            remap_chroma(table, src(1), src_stride(1), dst(1), dst_stride(1), tile, 2, 128);
+            break;
+        case GST_VIDEO_FORMAT_I420:
+        case GST_VIDEO_FORMAT_YV12:
+            remap_plane(table, src(0), src_stride(0), dst(0), dst_stride(0), tile, 16);
+            remap_chroma(table, src(1), src_stride(1), dst(1), dst_stride(1), tile, 1, 128);
+            remap_chroma(table, src(2), src_stride(2), dst(2), dst_stride(2), tile, 1, 128);
+            break;
+        default: // GRAY8
+            remap_plane(table, src(0), src_stride(0), dst(0), dst_stride(0), tile, 0);
+            break;
+        }
+    });
+}
@@ -0,0 +1,173 @@
+#include "LensRemap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+static const char lens_magic[8] = {'M', 'I', 'V', 'O', 'L', 'E', 'N', '1'};
+
+RemapTable RemapTable::build(int width, int height, const ViewCrop& crop, const LensModel& lens) {
+    RemapTable table;
+    table.width = width;
+    table.height = height;
+    table.crop = crop;
+    table.lens = lens;
+    if (width < 2 || height < 2 || width > 4095 || height > 4095) {
+        return table;
+    }
+    table.entries.resize((size_t)width * height);
+
+    double view_width = std::max(1, width - crop.left - crop.right);
+    double view_height = std::max(1, height - crop.top - crop.bottom);
+    double scale = std::max(view_width / width, view_height / height); // source pixels per output pixel
+    double view_x = crop.left + view_width / 2, view_y = crop.top + view_height / 2;
+    double centre_x = width / 2.0, centre_y = height / 2.0;
+    double norm = std::sqrt((double)width * width + (double)height * height) / 2;
+    uint32_t max_x = (width - 1) * 16 - 1, max_y = (height - 1) * 16 - 1;
+
+    for (int y = 0; y < height; ++y) {
+        double ny = (view_y + (y + 0.5 - centre_y) * scale - centre_y) / norm;
+        uint32_t *row = &table.entries[(size_t)y * width];
+        for (int x = 0; x < width; ++x) {
+            double nx = (view_x + (x + 0.5 - centre_x) * scale - centre_x) / norm;
+            double r2 = nx * nx + ny * ny;
+            double factor = 1 + lens.k1 * r2 + lens.k2 * r2 * r2;
+            // Back from pixel centres to sample positions
+            double sx = centre_x + nx * factor * norm - 0.5;
+            double sy = centre_y + ny * factor * norm - 0.5;
+            if (sx < 0 || sy < 0 || sx > width - 1 || sy > height - 1) {
+                row[x] = outside;
+                continue;
+            }
+            // At most 15/16 past the second-last column/row, so the kernels
+            // can always read the next pixel without a bounds check
+            uint32_t qx = std::min((uint32_t)std::lround(sx * 16), max_x);
+            uint32_t qy = std::min((uint32_t)std::lround(sy * 16), max_y);
+            row[x] = qy << 16 | qx;
+        }
+    }
+    return table;
+}
+
+bool RemapTable::matches(int width, int height, const ViewCrop& crop, const LensModel& lens) const {
+    return this->width == width && this->height == height && this->crop.left == crop.left &&
+           this->crop.top == crop.top && this->crop.right == crop.right && this->crop.bottom == crop.bottom &&
+           this->lens.k1 == lens.k1 && this->lens.k2 == lens.k2 && entries.size() == (size_t)width * height;
+}
+
+bool RemapTable::save(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    int32_t header[6] = {width, height, crop.left, crop.top, crop.right, crop.bottom};
+    double model[2] = {lens.k1, lens.k2};
+    out.write(lens_magic, sizeof(lens_magic));
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(model), sizeof(model));
+    out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(uint32_t));
+    return out.good();
+}
+
+bool RemapTable::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[8];
+    int32_t header[6];
+    double model[2];
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, lens_magic, sizeof(magic)) != 0 ||
+        !in.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+        !in.read(reinterpret_cast<char*>(model), sizeof(model))) {
+        return false;
+    }
+    if (header[0] <= 0 || header[1] <= 0 || header[0] > 4095 || header[1] > 4095) {
+        return false;
+    }
+    width = header[0];
+    height = header[1];
+    crop = {header[2], header[3], header[4], header[5]};
+    lens = {model[0], model[1]};
+    entries.resize((size_t)width * height);
+    return (bool)in.read(reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(uint32_t));
+}
+
+namespace {
+
+// 4-bit fractions, so the four weights sum to 256
+inline uint8_t bilinear(const uint8_t* p, int next_x, size_t next_y, uint32_t fx, uint32_t fy) {
+    uint32_t top = p[0] * (16 - fx) + p[next_x] * fx;
+    uint32_t bottom = p[next_y] * (16 - fx) + p[next_y + next_x] * fx;
+    return (uint8_t)((top * (16 - fy) + bottom * fy + 128) >> 8);
+}
+
+} // namespace
+
+void remap_plane(const RemapTable& table, const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride,
+                 const RemapTile& tile, uint8_t fill) {
+    for (int y = tile.y0; y < tile.y1; ++y) {
+        const uint32_t *entry = &table.entries[(size_t)y * table.width];
+        uint8_t *out = dst + (size_t)y * dst_stride;
+        for (int x = tile.x0; x < tile.x1; ++x) {
+            uint32_t e = entry[x];
+            if (e == RemapTable::outside) {
+                out[x] = fill;
+                continue;
+            }
+            uint32_t sx = e & 0xFFFF, sy = e >> 16;
+            int ix = sx >> 4, iy = sy >> 4;
+            const uint8_t *p = src + (size_t)iy * src_stride + ix;
+            out[x] = bilinear(p, 1, src_stride, sx & 15, sy & 15);
+        }
+    }
+}
+
+void remap_packed422(const RemapTable& table, const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride,
+                     const RemapTile& tile, int luma_offset) {
+    int chroma_offset = 1 - luma_offset;
+    int x0 = tile.x0 & ~1;
+    for (int y = tile.y0; y < tile.y1; ++y) {
+        const uint32_t *entry = &table.entries[(size_t)y * table.width];
+        uint8_t *out = dst + (size_t)y * dst_stride;
+        for (int x = x0; x < tile.x1; ++x) {
+            uint32_t e = entry[x];
+            bool pair_start = (x & 1) == 0;
+            if (e == RemapTable::outside) {
+                out[x * 2 + luma_offset] = 16;
+                if (pair_start) {
+                    out[x * 2 + chroma_offset] = 128;
+                    out[x * 2 + chroma_offset + 2] = 128;
+                }
+                continue;
+            }
+            uint32_t sx = e & 0xFFFF, sy = e >> 16;
+            int ix = sx >> 4, iy = sy >> 4;
+            const uint8_t *row = src + (size_t)iy * src_stride;
+            out[x * 2 + luma_offset] = bilinear(row + ix * 2 + luma_offset, 2, src_stride, sx & 15, sy & 15);
+            if (pair_start) {
+                // Chroma is shared by a pixel pair; take the pair the sample lands in
+                int nx = std::min((int)((sx + 8) >> 4), table.width - 1);
+                int ny = std::min((int)((sy + 8) >> 4), table.height - 1);
+                const uint8_t *pair = src + (size_t)ny * src_stride + (nx & ~1) * 2 + chroma_offset;
+                out[x * 2 + chroma_offset] = pair[0];
+                out[x * 2 + chroma_offset + 2] = pair[2];
+            }
+        }
+    }
+}
+
+void remap_chroma(const RemapTable& table, const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride,
+                  const RemapTile& tile, int pixel_bytes, uint8_t fill) {
+    int chroma_width = (table.width + 1) / 2, chroma_height = (table.height + 1) / 2;
+    for (int cy = tile.y0 / 2; cy < (tile.y1 + 1) / 2; ++cy) {
+        const uint32_t *entry = &table.entries[(size_t)(cy * 2) * table.width];
+        uint8_t *out = dst + (size_t)cy * dst_stride;
+        for (int cx = tile.x0 / 2; cx < (tile.x1 + 1) / 2; ++cx) {
+            uint32_t e = entry[cx * 2];
+            uint8_t *d = out + cx * pixel_bytes;
+            if (e == RemapTable::outside) {
+                std::memset(d, fill, pixel_bytes);
+                continue;
+            }
+            int nx = std::min((int)(((e & 0xFFFF) + 8) >> 5), chroma_width - 1);
+            int ny = std::min((int)(((e >> 16) + 8) >> 5), chroma_height - 1);
+            std::memcpy(d, src + (size_t)ny * src_stride + nx * pixel_bytes, pixel_bytes);
+        }
+    }
+}
@@ -1,10 +1,24 @@
 #include "MainWindow.h"
 #include "KeyPad.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
 
 
 MainWindow::MainWindow(): m_VBox(Gtk::ORIENTATION_VERTICAL),
         m_ButtonBox(Gtk::ORIENTATION_HORIZONTAL) {
-        
+
+        // Open the keypad on its own thread; ftdi_usb_open is slow and must not
+        // hold up the first frame.
+        if (!config.trace_path.empty()) {
+            Tracer::instance().enable(config.trace_path);
+        }
+        ThreadPolicy::instance().configure(config.thread_cpus, config.thread_priorities);
+        gpio_init_thread = std::thread(&MainWindow::init_gpio, this);
+        ThreadPolicy::instance().adopt_current("ui"); // after starting threads that would inherit it
+
+        {
+        StartupProfiler::Phase phase("window_layout");
         set_title("Mivonix");
         set_default_size(1300, 800);
         // Layout: Main box
@@ -20,23 +34,18 @@ MainWindow::MainWindow(): m_VBox(Gtk::ORIENTATION_VERTICAL),
         add_button(m_Button2, "Pause", 2);
         add_button(m_Button3, "Zoom +/-", 3);
         add_button(m_Button4, "AWB", 4);
+        add_button(m_Button5, "Gallery", 5);
+        add_button(m_Button6, "Display mode", 6);
+        add_button(m_Button7, "Flat field", 7);
+        add_button(m_Button8, "Calibrate flat", 8);
+        add_button(m_Button9, "Mosaic", 9);
+        add_button(m_Button10, "HDR", 10);
+        add_button(m_Button11, "Scope", 11);
+        add_button(m_Button12, "Zebra", 12);
+        add_button(m_Button13, "Compare", 13);
 
         m_VBox.pack_start(m_ButtonBox, Gtk::PACK_SHRINK);
-
-            // Initialize FTDI GPIO handler
-            try {
-                gpio_handler = new FT232HHandler([this](int button) {
-                    Glib::signal_idle().connect_once([this, button]() {
-                        handle_button_press(button);
-                    });
-                });
-                gpio_handler->initialize();
-                gpio_handler->start();
-                
-            } catch (const std::runtime_error& e) {
-                std::cout<< "Error: " + std::string(e.what())<<std::endl;
-            }
-            // End of Keypad syncing
+        }
 
                 // Connect button signals
             // m_Button1.signal_clicked().connect(sigc::mem_fun(*this, &MainWindow::on_play));
@@ -44,51 +53,102 @@ MainWindow::MainWindow(): m_VBox(Gtk::ORIENTATION_VERTICAL),
             // m_Button3.signal_clicked().connect(sigc::mem_fun(*this, &MainWindow::on_zoom));
             // m_Button4.signal_clicked().connect(sigc::mem_fun(*this, &MainWindow::on_awb));
             m_DrawingArea.signal_realize().connect(sigc::mem_fun(*this, &MainWindow::on_drawing_area_realized));
+            m_DrawingArea.signal_size_allocate().connect([this](Gtk::Allocation&) { schedule_display_size(); });
 
             // Start of Camera syncing using Gstreamer
 
-    // Initialize GStreamer
-    gst_init(nullptr, nullptr);
+    // Capture, recording and the tee; the display branch is added below
+    camera = std::make_unique<CameraPipeline>(config);
+    camera->set_measure_at_capture(false); // the sink measures what is shown
+    pipeline = camera->element();
+    tee = camera->tee();
 
     // Create GStreamer elements
-    pipeline = gst_pipeline_new("video-pipeline");
-    source = gst_element_factory_make("v4l2src", "source");
-    capsfilter = gst_element_factory_make("capsfilter", "capsfilter");
+    {
+    StartupProfiler::Phase phase("display_create");
+    display_queue = gst_element_factory_make("queue", "display_queue");
     // jpegdec = gst_element_factory_make("jpegdec", "jpegdec");
     crop = gst_element_factory_make("videocrop", "crop");
+    if (config.display_scale) {
+        scale = gst_element_factory_make("videoscale", "display_scale");
+        scale_caps = gst_element_factory_make("capsfilter", "display_caps");
+    }
     convert = gst_element_factory_make("videoconvert", "convert");
     sink = gst_element_factory_make("glimagesink", "sink");
+    if (config.hud) {
+        hud_caps = gst_element_factory_make("capsfilter", "hud_caps");
+        ScopeSettings settings;
+        settings.every = config.scope_every;
+        settings.zebra_level = (uint8_t)(std::min(std::max(config.zebra_percent, 0), 100) * 255 / 100);
+        settings.threads = config.scope_threads;
+        scope = std::make_unique<ExposureScope>(settings);
+        scope->set_view(ExposureScope::parse_view(config.scope));
+        scope->set_warning(ExposureScope::parse_warning(config.exposure_warning));
+    }
+    }
 
     // Below is for Sony usb
-    if (!pipeline || !source || !capsfilter || !crop || !convert || !sink) {
+    if (!camera->valid() || !display_queue || !crop || !convert || !sink) {
         std::cerr << "Failed to create GStreamer elements." << std::endl;
         return;
     }
 
+    display_mode = std::max(0, find_display_mode(config.display_mode));
+    if (find_display_mode(config.display_mode) < 0) {
+        std::cerr << "Unknown display mode " << config.display_mode << ", using " << display_modes()[0].name << std::endl;
+    }
+    apply_display_mode(display_modes()[display_mode], display_queue, sink);
+
     // Below is for Sonymulti
     // if (!pipeline || !source || !capsfilter || !jpegdec || !crop || !convert || !sink) {
     //     std::cerr << "Failed to create GStreamer elements." << std::endl;
     //     return;
     // }
 
-    // Set camera device
-    g_object_set(source, "device", "/dev/video0", nullptr);
+    // Camera device, io-mode, driver buffer count and the default 1280x720
+    // caps are set by CameraPipeline
     // g_object_set(source, "buffer-size", 1048576, NULL);
     // g_object_set(source, "latency", 200, NULL);
 
-        // Set capsfilter properties
-    // GstCaps *caps = gst_caps_from_string("format=MJPEG,width=1280,height=720,framerate=40/1");
-    // g_object_set(capsfilter, "caps", caps, NULL);
-    // gst_caps_unref(caps); // Free the caps structure after setting it
-
-    // Set default resolution to 1280x720 or 1920*1080
-    change_resolution(1280, 720);
-
     // Add and link elements for SonyUSB
-    gst_bin_add_many(GST_BIN(pipeline), source, capsfilter, crop, convert, sink, nullptr);
-    if (!gst_element_link_many(source, capsfilter, crop, convert, sink, nullptr)) {
+    {
+    StartupProfiler::Phase phase("element_link");
+    gst_bin_add_many(GST_BIN(pipeline), display_queue, crop, convert, sink, nullptr);
+    GstElement *last = convert;
+    if (hud_caps) {
+        // Without the HUD glimagesink takes YUY2 and converts on the GPU, so
+        // videoconvert passes frames through. The stats box keeps it that way:
+        // it is attached as an overlay composition the sink blends. Only the
+        // scope, exposure warnings and the comparison work on the pixels
+        // themselves; while one of them is on, hud_caps asks for BGRx and
+        // each displayed frame is converted on the CPU.
+        gst_bin_add(GST_BIN(pipeline), hud_caps);
+        if (!gst_element_link(convert, hud_caps)) {
+            std::cerr << "Failed to link HUD overlay." << std::endl;
+        }
+        GstPad *pad = gst_element_get_static_pad(hud_caps, "src");
+        gst_pad_add_probe(pad, (GstPadProbeType)(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM),
+                          &MainWindow::on_hud_buffer, this, nullptr);
+        gst_object_unref(pad);
+        last = hud_caps;
+    }
+    // Recording and snapshots take full-resolution frames from the tee; the
+    // display branch is scaled to the window right after the crop, so
+    // videoconvert and the upload only touch on-screen pixels.
+    GstElement *before_convert = crop;
+    if (scale && scale_caps) {
+        gst_bin_add_many(GST_BIN(pipeline), scale, scale_caps, nullptr);
+        if (!gst_element_link_many(crop, scale, scale_caps, nullptr)) {
+            std::cerr << "Failed to link display scaler." << std::endl;
+        }
+        before_convert = scale_caps;
+    }
+    if (!gst_element_link_many(tee, display_queue, crop, nullptr) ||
+        !gst_element_link(before_convert, convert) ||
+        !gst_element_link(last, sink)) {
         std::cerr << "Failed to link GStreamer elements." << std::endl;
     }
+    }
 
     // Add and link elements for Sonymulti
     // gst_bin_add_many(GST_BIN(pipeline), source, capsfilter, jpegdec, crop, convert, sink, nullptr);
@@ -96,40 +156,100 @@ MainWindow::MainWindow(): m_VBox(Gtk::ORIENTATION_VERTICAL),
     //     std::cerr << "Failed to link GStreamer elements." << std::endl;
     // }
 
+    LensModel lens_model{config.lens_k1, config.lens_k2};
+    if (!lens_model.identity()) {
+        GstPad *pad = gst_element_get_static_pad(display_queue, "src");
+        lens = std::make_unique<LensCorrection>(pad, lens_model, CameraCapabilities::cache_dir(), config.lens_threads);
+        gst_object_unref(pad);
+    }
+
+    if (config.stabilize) {
+        if (lens) {
+            // The crop lives in the lens table there, out of videocrop's reach
+            std::cerr << "Stabilization is not available with lens correction." << std::endl;
+        } else {
+            StabilizerSettings settings;
+            settings.smoothing = std::min(std::max(config.stabilize_smoothing, 0.0), 0.99);
+            stabilizer = std::make_unique<Stabilizer>(camera->mailbox(), crop, settings);
+        }
+    }
+
+    // The sink asks for its window from the streaming thread; answer it there
+    // so the camera can open and negotiate while the window is still realizing.
+    camera->sync_hook = [this](GstMessage* message) { return on_sync_message(message); };
+    camera->message_hook = [this](GstMessage* message) { on_pipeline_message(message); };
+
+    GstPad *sink_pad = gst_element_get_static_pad(sink, "sink");
+    gst_pad_add_probe(sink_pad, GST_PAD_PROBE_TYPE_BUFFER, &MainWindow::on_first_frame, this, nullptr);
+    gst_pad_add_probe(sink_pad, GST_PAD_PROBE_TYPE_BUFFER, &MainWindow::on_sink_buffer, this, nullptr);
+    gst_object_unref(sink_pad);
+
+    if (hud_caps) {
+        compare = std::make_unique<ReferenceCompare>(camera->mailbox());
+        update_hud_format();
+        Glib::signal_timeout().connect(sigc::mem_fun(*this, &MainWindow::update_hud), 250);
+    }
+    if (config.thread_report_seconds > 0) {
+        Glib::signal_timeout().connect_seconds([]() {
+            ThreadPolicy::instance().report();
+            print_resource_usage("GUI"); // same line as bimba-headless, for comparing the builds
+            return true;
+        }, config.thread_report_seconds);
+    }
+
     // Start with Video Play
-    gst_element_set_state(pipeline, GST_STATE_PLAYING);
-    std::cout << "Initialise with Streaming..." << std::endl;
+    camera->start();
 
     show_all_children();
     
 }
 
 MainWindow::~MainWindow() { 
-    gpio_handler->reverse();
-
-    if (pipeline) {
-        gst_element_set_state(pipeline, GST_STATE_NULL);
-        gst_object_unref(pipeline);
+    if (gpio_init_thread.joinable()) {
+        gpio_init_thread.join();
+    }
+    if (gpio_handler) {
+        gpio_handler->reverse();
     }
-}
-
-void MainWindow::change_resolution(int width, int height) {
-    GstCaps *caps = gst_caps_new_simple(
-        "video/x-raw",
-        "width", G_TYPE_INT, width,
-        "height", G_TYPE_INT, height,
-        // "framerate", GST_TYPE_FRACTION, 60, 1,
-        NULL);
 
-    if (caps) {
-        g_object_set(capsfilter, "caps", caps, NULL);
-        gst_caps_unref(caps);
-        std::cout << "Resolution set to " << width << "x" << height << std::endl;
-    } else {
-        std::cerr << "Failed to set resolution." << std::endl;
+    // CPU per thread over the run; compare with MIVO_DISPLAY_SCALE=0
+    ThreadPolicy::instance().report();
+    if (mosaic) {
+        mosaic_window.reset();
+        mosaic->stop(); // reads the mailbox, so before the camera goes
+        mosaic->save(config.captures_dir);
+        mosaic.reset();
+    }
+    if (mosaic_saver.joinable()) {
+        mosaic_saver.join();
     }
+    stabilizer.reset();
+    compare.reset();
+    camera.reset();
+    report_display_latency(display_mode);
+    print_resource_usage("GUI");
+    Tracer::instance().dump();
 }
 
+void MainWindow::init_gpio() {
+    StartupProfiler::Phase phase("ftdi_init");
+            // Initialize FTDI GPIO handler
+            try {
+                gpio_handler = new FT232HHandler([this](int button) {
+                    Tracer::instance().instant("keypad", "button_event");
+                    Glib::signal_idle().connect_once([this, button]() {
+                        handle_button_press(button);
+                    });
+                });
+                gpio_handler->thread_init = []() { ThreadPolicy::instance().adopt_current("keypad"); };
+                gpio_handler->initialize();
+                gpio_handler->start();
+                
+            } catch (const std::runtime_error& e) {
+                std::cout<< "Error: " + std::string(e.what())<<std::endl;
+            }
+            // End of Keypad syncing
+}
 
     void MainWindow::add_button(Gtk::Button& button, const Glib::ustring& label, int id) {
         button.set_label(label);
@@ -138,6 +258,7 @@ void MainWindow::change_resolution(int width, int height) {
         }
 
     void MainWindow::handle_button_press(int button) {
+        TraceSpan span("ui", "button_press");
         std::cout<< "Button " + std::to_string(button) + " pressed!" << std::endl;
         
         if(button == 1){
@@ -152,64 +273,188 @@ void MainWindow::change_resolution(int width, int height) {
         if(button == 4){
         on_awb();
         }
+        if(button == 5){
+        on_gallery();
+        }
+        if(button == 6){
+        on_display_mode();
+        }
+        if(button == 7){
+        on_flat_field();
+        }
+        if(button == 8){
+        on_flat_calibrate();
+        }
+        if(button == 9){
+        on_mosaic();
+        }
+        if(button == 10){
+        on_hdr();
+        }
+        if(button == 11){
+        on_scope();
+        }
+        if(button == 12){
+        on_exposure_warning();
+        }
+        if(button == 13){
+        on_compare();
+        }
         
     }
 
 
 void MainWindow::on_play() {
-    gst_element_set_state(pipeline, GST_STATE_PLAYING);
-    std::cout << "Pipeline playing..." << std::endl;
+    camera->play();
 }
 
 void MainWindow::on_pause() {
-    gst_element_set_state(pipeline, GST_STATE_PAUSED);
-    std::cout << "Pipeline paused." << std::endl;
+    camera->pause();
 }
 
-void MainWindow::on_zoom() {
-    // Increment zoom level
-    zoom_level = (zoom_level + 1) % 4; // Cycle through 4 zoom levels (0-3)
-    apply_zoom();
-    std::cout << "Zoom level: " << zoom_level << std::endl;
+void MainWindow::on_gallery() {
+    if (!gallery) {
+        std::vector<std::string> directories{config.captures_dir};
+        if (!config.record_dir.empty()) {
+            directories.push_back(config.record_dir);
+        }
+        gallery = std::make_unique<GalleryWindow>(directories, (size_t)config.gallery_cache_mb << 20);
+        gallery->set_transient_for(*this);
+    } else {
+        gallery->refresh();
+    }
+    gallery->present();
 }
 
-    int set_v4l2_control(const char *device, int control_id, int value) {
-    int fd = open(device, O_RDWR);
-    if (fd < 0) {
-        perror("Failed to open video device");
-        return -1;
+void MainWindow::on_flat_field() {
+    FlatField *flat = camera->flat_field();
+    flat->set_enabled(!flat->enabled());
+}
+
+// Point the scope at an evenly lit, empty field first
+void MainWindow::on_flat_calibrate() {
+    if (!camera->flat_field()->calibrate()) {
+        std::cout << "Flat-field calibration already running." << std::endl;
     }
+}
 
-    struct v4l2_control control;
-    control.id = control_id;
-    control.value = value;
+// First press starts a mosaic and shows its preview; the second stops it and
+// saves it to the captures directory without holding up the UI.
+void MainWindow::on_mosaic() {
+    if (!mosaic) {
+        if (mosaic_saver.joinable()) {
+            mosaic_saver.join(); // the previous one is still being written
+        }
+        MosaicSettings settings;
+        settings.scale = config.mosaic_scale;
+        mosaic = std::make_unique<Mosaic>(camera->mailbox(), settings);
+        mosaic_window = std::make_unique<MosaicWindow>(*mosaic);
+        mosaic_window->set_transient_for(*this);
+        mosaic_window->present();
+        return;
+    }
+    mosaic_window.reset();
+    mosaic->stop();
+    if (mosaic_saver.joinable()) {
+        mosaic_saver.join();
+    }
+    std::string directory = config.captures_dir;
+    mosaic_saver = std::thread([finished = std::move(mosaic), directory]() {
+        ThreadPolicy::instance().adopt_current("snapshot");
+        finished->save(directory);
+    });
+}
 
-    if (ioctl(fd, VIDIOC_S_CTRL, &control) < 0) {
-        perror("Failed to set control");
-        close(fd);
-        return -1;
+void MainWindow::on_hdr() {
+    if (!camera->hdr().capture()) {
+        std::cout << "HDR capture already running." << std::endl;
     }
+}
 
-    close(fd);
-    return 0;
+void MainWindow::on_scope() {
+    if (!scope) {
+        std::cout << "The scope needs the HUD overlay (MIVO_HUD=1)." << std::endl;
+        return;
+    }
+    scope->set_view(ScopeView(((int)scope->view() + 1) % 3));
+    std::cout << "Scope: " << ExposureScope::name(scope->view()) << std::endl;
+    update_hud_format();
 }
 
+void MainWindow::on_exposure_warning() {
+    if (!scope) {
+        std::cout << "Exposure warnings need the HUD overlay (MIVO_HUD=1)." << std::endl;
+        return;
+    }
+    scope->set_warning(ExposureWarning(((int)scope->warning() + 1) % 3));
+    std::cout << "Exposure warning: " << ExposureScope::name(scope->warning()) << std::endl;
+    update_hud_format();
+}
+
+// The reference is only decoded the first time the view is turned on
+void MainWindow::on_compare() {
+    if (!compare) {
+        std::cout << "Comparison needs the HUD overlay (MIVO_HUD=1)." << std::endl;
+        return;
+    }
+    if (!compare->loaded()) {
+        if (config.reference_path.empty()) {
+            std::cout << "Set MIVO_REFERENCE to the image to compare against." << std::endl;
+            return;
+        }
+        if (!compare->load(config.reference_path)) {
+            return;
+        }
+    }
+    compare->set_mode(CompareMode(((int)compare->mode() + 1) % 3));
+    std::cout << "Compare: " << ReferenceCompare::name(compare->mode()) << std::endl;
+    update_hud_format();
+}
+
+void MainWindow::on_display_mode() {
+    report_display_latency(display_mode);
+    int next = (display_mode + 1) % (int)display_modes().size();
+    mode_latency[next].reset();
+    apply_display_mode(display_modes()[next], display_queue, sink);
+    display_mode = next;
+}
+
+// Capture timestamp to render, per mode. The v4l2 timestamp is taken when the
+// driver receives the frame, so sensor readout is included; panel scan-out is not.
+void MainWindow::report_display_latency(int mode) {
+    const LatencyHistogram& latency = mode_latency[mode];
+    if (!latency.count()) {
+        return;
+    }
+    std::cout << "Latency in " << display_modes()[mode].name << " mode: mean " << std::fixed
+              << std::setprecision(1) << latency.mean() << " ms, p50 " << latency.percentile(0.5)
+              << " ms, p95 " << latency.percentile(0.95) << " ms, p99 " << latency.percentile(0.99)
+              << " ms over " << latency.count() << " frames" << std::endl;
+}
+
+void MainWindow::on_zoom() {
+    // Increment zoom level
+    zoom_level = (zoom_level + 1) % 4; // Cycle through 4 zoom levels (0-3)
+    apply_zoom();
+    std::cout << "Zoom level: " << zoom_level << std::endl;
+}
 
 void MainWindow::on_awb() {
     // Toggle AWB and set white balance temperature to 4600K when AWB is disabled
+    TraceSpan span("awb", "awb_toggle");
     awb_enabled = !awb_enabled;
-    gst_element_set_state(pipeline, GST_STATE_NULL);
-    
-    gst_element_set_state(pipeline, GST_STATE_PLAYING);
-    const char *cam = "/dev/video0";
     if (awb_enabled) {
-        set_v4l2_control(cam, V4L2_CID_AUTO_WHITE_BALANCE, 1); 
+        camera->controls().set(V4L2_CID_AUTO_WHITE_BALANCE, 1);
         std::cout << "AWB enabled." << std::endl;
-        gst_element_set_state(pipeline, GST_STATE_NULL);
         const char *command = "ffmpeg -f v4l2 -i /dev/video0 -framerate 30 -vframes 1 output_image.jpg";
         
             std::cout << "Capturing Image" << std::endl;
-            int ret = system(command);
+            int ret;
+            // ffmpeg needs the device, so it runs while the pipeline is stopped
+            camera->restart([&]() {
+                TraceSpan encode("snapshot", "snapshot_encode");
+                ret = system(command);
+            });
 
             if (ret == 0) {
                 printf("Image captured successfully and saved as 'captured_frame.jpg'.\n");
@@ -229,11 +474,12 @@ void MainWindow::on_awb() {
             // return 1; // Exit with error code
         }
 
+        awb_temperature_k = temperature;
         std::cout << "Estimated Color Temperature: " << static_cast<int>(temperature) << "K" << std::endl;
    
         // double temperature = awb_temperature("output_image.jpg");
-        set_v4l2_control(cam, V4L2_CID_AUTO_WHITE_BALANCE, 0);  // Disable auto white balance
-        set_v4l2_control(cam, V4L2_CID_WHITE_BALANCE_TEMPERATURE, static_cast<int>(temperature));
+        camera->controls().set(V4L2_CID_AUTO_WHITE_BALANCE, 0);  // Disable auto white balance
+        camera->controls().set(V4L2_CID_WHITE_BALANCE_TEMPERATURE, static_cast<int>(temperature));
         std::cout << "AWB disabled. White balance temperature set to " << temperature<< std::endl;
         system("rm -rf output_image.jpg");
     }
@@ -241,6 +487,7 @@ void MainWindow::on_awb() {
 
 
 void MainWindow::apply_zoom() {
+    TraceSpan span("state", "apply_zoom");
     // Crop values for each zoom level
     int crop_values[4][4] = {
         {0, 0, 0, 0},       // No crop (zoom level 0)
@@ -249,6 +496,18 @@ void MainWindow::apply_zoom() {
         {150, 150, 150, 150}  // Maximum zoom (zoom level 3)
     };
 
+    if (compare) {
+        const int *c = crop_values[zoom_level];
+        compare->set_view({c[0], c[2], c[1], c[3]});
+    }
+    if (lens) {
+        // The crop is part of the lens table; the frame size doesn't change,
+        // so nothing needs renegotiating
+        const int *c = crop_values[zoom_level];
+        lens->set_crop({c[0], c[2], c[1], c[3]});
+        return;
+    }
+
     // Set crop properties based on the zoom level
     g_object_set(crop,
                  "left", crop_values[zoom_level][0],
@@ -256,18 +515,87 @@ void MainWindow::apply_zoom() {
                  "top", crop_values[zoom_level][2],
                  "bottom", crop_values[zoom_level][3],
                  nullptr);
+    if (stabilizer) {
+        // The zoom margin is what stabilization has to move in
+        const int *c = crop_values[zoom_level];
+        stabilizer->set_view({c[0], c[2], c[1], c[3]});
+    }
 
     // Restart pipeline to apply changes
-    gst_element_set_state(pipeline, GST_STATE_NULL);
-    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    camera->restart();
+}
+
+
+// Resizes arrive in bursts while the window is dragged; renegotiate once
+// they settle.
+void MainWindow::schedule_display_size() {
+    if (!scale_caps || display_size_pending) {
+        return;
+    }
+    display_size_pending = true;
+    Glib::signal_timeout().connect_once([this]() {
+        display_size_pending = false;
+        update_display_size();
+    }, 100);
 }
 
+// Scale to the drawing area's size in device pixels. Never upscale here: if
+// the window is larger than the frame, the sink scales on the GPU instead.
+// Only width and height are fixed, so videoscale picks the pixel aspect
+// ratio that keeps the picture's shape and the sink letterboxes it.
+void MainWindow::update_display_size() {
+    int factor = m_DrawingArea.get_scale_factor();
+    int width = (m_DrawingArea.get_allocated_width() * factor) & ~1;
+    int height = (m_DrawingArea.get_allocated_height() * factor) & ~1;
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    int source_width = 0, source_height = 0;
+    GstPad *pad = gst_element_get_static_pad(crop, "src");
+    if (GstCaps *current = gst_pad_get_current_caps(pad)) {
+        GstStructure *structure = gst_caps_get_structure(current, 0);
+        gst_structure_get_int(structure, "width", &source_width);
+        gst_structure_get_int(structure, "height", &source_height);
+        gst_caps_unref(current);
+    }
+    gst_object_unref(pad);
+    if (source_width <= 0) {
+        return; // not negotiated yet; retried on the first frame
+    }
+
+    GstCaps *caps;
+    // The lens remap already resampled the frame once; the sink scales it
+    if (lens || (width >= source_width && height >= source_height)) {
+        caps = gst_caps_new_empty_simple("video/x-raw");
+        width = height = 0;
+    } else {
+        caps = gst_caps_new_simple("video/x-raw",
+                                   "width", G_TYPE_INT, width,
+                                   "height", G_TYPE_INT, height,
+                                   NULL);
+    }
+    if (width == display_width && height == display_height) {
+        gst_caps_unref(caps);
+        return;
+    }
+    display_width = width;
+    display_height = height;
+    g_object_set(scale_caps, "caps", caps, nullptr);
+    gst_caps_unref(caps);
+    if (width) {
+        std::cout << "Display scaled to " << width << "x" << height << std::endl;
+    } else {
+        std::cout << "Display at capture resolution" << std::endl;
+    }
+}
 
 void MainWindow::on_drawing_area_realized() {
     Glib::signal_idle().connect(sigc::mem_fun(*this, &MainWindow::set_video_overlay));
 }
 
 bool MainWindow::set_video_overlay() {
+    StartupProfiler::Phase phase("overlay_handle");
     // Retrieve the GDK window for the drawing area
        auto gdk_window = m_DrawingArea.get_window();
     if (!gdk_window) {
@@ -277,6 +605,11 @@ bool MainWindow::set_video_overlay() {
     #ifdef GDK_WINDOWING_X11
         if (GDK_IS_X11_WINDOW(gdk_window->gobj())) {
             auto xid = GDK_WINDOW_XID(gdk_window->gobj());
+            {
+                std::lock_guard<std::mutex> lock(overlay_mutex);
+                window_handle = xid;
+            }
+            overlay_cv.notify_all();
             gst_video_overlay_set_window_handle(GST_VIDEO_OVERLAY(sink), xid);
             std::cout << "Video overlay set to GTK DrawingArea." << std::endl;
         }
@@ -284,7 +617,39 @@ bool MainWindow::set_video_overlay() {
     return false;
 }
 
+// Runs on the streaming thread. The sink blocks here until the drawing area has
+// a window, so pipeline preroll overlaps with window realization.
+GstBusSyncReply MainWindow::on_sync_message(GstMessage* message) {
+    if (!gst_is_video_overlay_prepare_window_handle_message(message)) {
+        return GST_BUS_PASS;
+    }
+    StartupProfiler::Phase phase("wait_window_handle");
+
+    std::unique_lock<std::mutex> lock(overlay_mutex);
+    overlay_cv.wait_for(lock, std::chrono::seconds(2), [this]() { return window_handle != 0; });
+    if (window_handle) {
+        gst_video_overlay_set_window_handle(GST_VIDEO_OVERLAY(GST_MESSAGE_SRC(message)), window_handle);
+    } else {
+        std::cerr << "Drawing area not realized in time, sink will open its own window." << std::endl;
+    }
+    gst_message_unref(message);
+    return GST_BUS_DROP;
+}
+
+GstPadProbeReturn MainWindow::on_first_frame(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    StartupProfiler::instance().mark_first_frame();
+    auto self = static_cast<MainWindow*>(user_data);
+    Glib::signal_idle().connect_once([self]() {
+        StartupProfiler::instance().report();
+        self->schedule_display_size();
+        // glimagesink renders on its own GL thread, which exists by now
+        ThreadPolicy::instance().adopt_by_name("render", "gstglcontext");
+    });
+    return GST_PAD_PROBE_REMOVE;
+}
+
 double MainWindow::awb_temperature(const std::string& imagePath) {
+    TraceSpan span("awb", "awb_estimate");
 // Load the image
     cv::Mat image = cv::imread(imagePath);
     if (image.empty()) {
@@ -313,3 +678,166 @@ double MainWindow::awb_temperature(const std::string& imagePath) {
     return colorTemperature;
 
 }
+
+// Capture-to-render latency: from the buffer's capture timestamp to when the
+// sink shows it. Without sync that is when it arrives here; with sync the sink
+// holds it until its timestamp plus the pipeline latency, if that is later.
+GstPadProbeReturn MainWindow::on_sink_buffer(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    auto self = static_cast<MainWindow*>(user_data);
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    double latency = 0;
+    int mode = self->display_mode;
+
+    GstClock *clock = gst_element_get_clock(self->sink);
+    if (clock && GST_BUFFER_PTS_IS_VALID(buffer)) {
+        GstClockTime pts = GST_BUFFER_PTS(buffer);
+        GstClockTime shown = gst_clock_get_time(clock) - gst_element_get_base_time(self->sink);
+        if (display_modes()[mode].sync) {
+            shown = std::max(shown, pts + gst_pipeline_get_latency(GST_PIPELINE(self->pipeline)));
+        }
+        if (shown > pts) {
+            latency = (shown - pts) / 1e6;
+        }
+    }
+    if (clock) {
+        gst_object_unref(clock);
+    }
+    self->camera->metrics().on_frame_rendered(latency);
+    self->mode_latency[mode].add(latency);
+    if (GST_BUFFER_OFFSET_IS_VALID(buffer)) {
+        self->camera->integrity().on_display(GST_BUFFER_OFFSET(buffer));
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+// Recorder, watchdog, errors and state changes are handled by CameraPipeline
+void MainWindow::on_pipeline_message(GstMessage* message) {
+    if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_QOS && GST_MESSAGE_SRC(message) == GST_OBJECT(sink)) {
+        GstFormat format;
+        guint64 processed, dropped;
+        gst_message_parse_qos_stats(message, &format, &processed, &dropped);
+        if (format == GST_FORMAT_BUFFERS) {
+            camera->metrics().frames_dropped = dropped;
+        }
+    }
+}
+
+// BGRx is only asked for while something has to read or replace pixels;
+// the capsfilter renegotiates on the next frame.
+void MainWindow::update_hud_format() {
+    bool rgb = (scope && (scope->view() != ScopeView::Off || scope->warning() != ExposureWarning::Off)) ||
+               (compare && compare->mode() != CompareMode::Off);
+    if (!hud_caps || rgb == hud_rgb_caps) {
+        return;
+    }
+    hud_rgb_caps = rgb;
+    GstCaps *caps = rgb ? gst_caps_from_string("video/x-raw,format=BGRx") : gst_caps_new_any();
+    g_object_set(hud_caps, "caps", caps, nullptr);
+    gst_caps_unref(caps);
+}
+
+GstPadProbeReturn MainWindow::on_hud_buffer(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    MainWindow *self = static_cast<MainWindow*>(user_data);
+    if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+        GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+        if (GST_EVENT_TYPE(event) == GST_EVENT_CAPS) {
+            GstCaps *caps = nullptr;
+            gst_event_parse_caps(event, &caps);
+            self->hud_rgb = gst_video_info_from_caps(&self->hud_info, caps) &&
+                            GST_VIDEO_INFO_FORMAT(&self->hud_info) == GST_VIDEO_FORMAT_BGRx;
+        }
+        return GST_PAD_PROBE_OK;
+    }
+
+    // Only the buffer's metadata has to be ours: on the YUY2 path this shares
+    // the memory with the tee's other branches rather than copying it.
+    GstBuffer *buffer = gst_buffer_make_writable(GST_PAD_PROBE_INFO_BUFFER(info));
+    GST_PAD_PROBE_INFO_DATA(info) = buffer;
+    if (!self->hud_rgb) {
+        if (GstVideoOverlayComposition *composition = self->hud.composition()) {
+            gst_buffer_add_video_overlay_composition_meta(buffer, composition);
+            gst_video_overlay_composition_unref(composition);
+        }
+        return GST_PAD_PROBE_OK;
+    }
+
+    // BGRx comes fresh from videoconvert, so mapping it for write is free
+    GstVideoFrame frame;
+    if (!gst_video_frame_map(&frame, &self->hud_info, buffer, GST_MAP_READWRITE)) {
+        return GST_PAD_PROBE_OK;
+    }
+    cairo_surface_t *surface = cairo_image_surface_create_for_data(
+        static_cast<unsigned char*>(GST_VIDEO_FRAME_PLANE_DATA(&frame, 0)), CAIRO_FORMAT_RGB24,
+        GST_VIDEO_FRAME_WIDTH(&frame), GST_VIDEO_FRAME_HEIGHT(&frame), GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 0));
+    cairo_t *cr = cairo_create(surface);
+    self->draw_hud(cr);
+    cairo_destroy(cr);
+    cairo_surface_finish(surface);
+    cairo_surface_destroy(surface);
+    gst_video_frame_unmap(&frame);
+    return GST_PAD_PROBE_OK;
+}
+
+void MainWindow::draw_hud(cairo_t* cr) {
+    if (scope) {
+        scope->measure(cr); // the live frame, before the comparison replaces any of it
+    }
+    int live_width = -1;
+    if (compare && compare->mode() != CompareMode::Off) {
+        cairo_surface_t *target = cairo_get_target(cr);
+        if (cairo_surface_get_type(target) == CAIRO_SURFACE_TYPE_IMAGE &&
+            (cairo_image_surface_get_format(target) == CAIRO_FORMAT_RGB24 ||
+             cairo_image_surface_get_format(target) == CAIRO_FORMAT_ARGB32)) {
+            cairo_surface_flush(target);
+            int width = cairo_image_surface_get_width(target), height = cairo_image_surface_get_height(target);
+            if (compare->apply(cairo_image_surface_get_data(target), cairo_image_surface_get_stride(target),
+                               width, height)) {
+                // Warnings only mean something on live pixels
+                live_width = compare->mode() == CompareMode::Split ? width / 2 : 0;
+            }
+            cairo_surface_mark_dirty(target);
+            if (live_width > 0) {
+                cairo_set_source_rgb(cr, 1, 1, 1);
+                cairo_set_line_width(cr, 2);
+                cairo_move_to(cr, width / 2, 0);
+                cairo_line_to(cr, width / 2, height);
+                cairo_stroke(cr);
+            }
+        }
+    }
+    if (scope) {
+        scope->draw(cr, live_width); // paints into the frame, so under the HUD text
+    }
+    hud.draw(cr);
+}
+
+bool MainWindow::update_hud() {
+    StatsOverlay::Values values;
+    PipelineMetrics& metrics = camera->metrics();
+    FrameIntegrity& integrity = camera->integrity();
+    values.fps = metrics.fps;
+    values.latency_ms = metrics.latency_ms;
+    values.dropped = metrics.frames_dropped;
+    values.sensor_drops = integrity.sensor_drops;
+    values.pipeline_drops = integrity.pipeline_drops;
+    values.zoom_level = zoom_level;
+    values.awb_enabled = awb_enabled;
+    values.temperature_k = awb_temperature_k;
+    values.display_mode = display_modes()[display_mode].name;
+    if (scope && (scope->view() != ScopeView::Off || scope->warning() != ExposureWarning::Off)) {
+        static const char* const views[] = {"-", "hist", "wave"};
+        static const char* const warnings[] = {"-", "zebra", "false"};
+        std::ostringstream text;
+        text << views[(int)scope->view()] << "+" << warnings[(int)scope->warning()] << " "
+             << std::fixed << std::setprecision(1) << scope->cost_ms() << " ms";
+        values.scope = text.str();
+    }
+    if (compare && compare->mode() != CompareMode::Off && compare->scored()) {
+        std::ostringstream text;
+        text << std::fixed << std::setprecision(1) << compare->psnr() << " dB " << std::setprecision(3)
+             << compare->ssim();
+        values.compare = text.str();
+    }
+    hud.update(values);
+    return true;
+}
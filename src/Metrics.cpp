@@ -0,0 +1,55 @@
+#include "Metrics.h"
+
+void PipelineMetrics::on_frame_rendered(double frame_latency_ms) {
+    frames_rendered++;
+    window_frames++;
+    latency_sum += frame_latency_ms;
+
+    // Publish averages once per second so readers see stable values
+    auto now = Clock::now();
+    double seconds = std::chrono::duration<double>(now - window_start).count();
+    if (seconds >= 1.0) {
+        fps = window_frames / seconds;
+        latency_ms = latency_sum / window_frames;
+        window_start = now;
+        window_frames = 0;
+        latency_sum = 0;
+    }
+}
+
+void LatencyHistogram::add(double ms) {
+    int bin = ms < 0 ? 0 : (ms >= bins - 1 ? bins - 1 : (int)ms);
+    counts[bin].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sum_us.fetch_add((uint64_t)(ms > 0 ? ms * 1000 : 0), std::memory_order_relaxed);
+}
+
+void LatencyHistogram::reset() {
+    for (auto& count : counts) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    total = 0;
+    sum_us = 0;
+}
+
+double LatencyHistogram::mean() const {
+    uint64_t n = count();
+    return n ? sum_us.load(std::memory_order_relaxed) / 1000.0 / n : 0;
+}
+
+// Upper edge of the bin holding the q-th frame
+double LatencyHistogram::percentile(double q) const {
+    uint64_t n = count();
+    if (!n) {
+        return 0;
+    }
+    uint64_t target = (uint64_t)(q * (n - 1)) + 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < bins; ++i) {
+        seen += counts[i].load(std::memory_order_relaxed);
+        if (seen >= target) {
+            return i + 1;
+        }
+    }
+    return bins;
+}
@@ -0,0 +1,283 @@
+#include "Mosaic.h"
+#include "FrameConvert.h"
+#include "MotionDetector.h"
+#include "MotionKernels.h"
+#include "Snapshot.h"
+#include "ThreadPolicy.h"
+#include "Tracer.h"
+
+#include <gst/video/video.h>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+
+const uint8_t changed_level = 8; // luma step for a registration cell to count as changed
+const double min_coverage = 0.2; // of the registration window already on the canvas
+
+} // namespace
+
+Mosaic::Mosaic(FrameMailbox& mailbox, const MosaicSettings& settings) : mailbox(mailbox), settings(settings) {
+    this->settings.downsample = std::max(8, settings.downsample / 8 * 8);
+    // Registration cells have to land on whole canvas pixels
+    step = std::max(1, (int)std::lround(settings.scale * this->settings.downsample));
+    this->settings.scale = (double)step / this->settings.downsample;
+    std::cout << "Mosaic started at " << this->settings.scale << "x" << std::endl;
+    thread = std::thread(&Mosaic::run, this);
+}
+
+Mosaic::~Mosaic() {
+    stop();
+}
+
+void Mosaic::stop() {
+    running = false;
+    if (thread.joinable()) {
+        thread.join();
+        std::cout << "Mosaic: " << placed << " frames placed, " << skipped << " unchanged, " << lost
+                  << " not registered" << std::endl;
+        if (processed) {
+            std::cout << "Mosaic: " << std::fixed << std::setprecision(2) << total_ms / processed
+                      << " ms mean, " << max_ms << " ms max per frame (analyse, register, place)" << std::endl;
+        }
+    }
+}
+
+bool Mosaic::preview(std::vector<uint8_t>& rgb, int* width, int* height, uint64_t* version) {
+    std::lock_guard<std::mutex> lock(preview_mutex);
+    if (preview_version == *version) {
+        return false;
+    }
+    rgb = preview_rgb;
+    *width = preview_width;
+    *height = preview_height;
+    *version = preview_version;
+    return true;
+}
+
+void Mosaic::run() {
+    ThreadPolicy::instance().adopt_current("mosaic");
+    uint64_t sequence = 0;
+    uint64_t brackets = 0;
+    uint64_t previewed = 0;
+    auto last_preview = std::chrono::steady_clock::now();
+
+    while (running) {
+        GstSample *sample = mailbox.wait(&sequence, 100);
+        if (!sample) {
+            continue;
+        }
+        if (mailbox.disturbed(&brackets)) {
+            // Bracketed exposures would be painted in and mis-registered; the
+            // canvas itself stays valid, only the motion estimate is dropped
+            velocity_x = velocity_y = 0;
+            gst_sample_unref(sample);
+            continue;
+        }
+        auto begin = std::chrono::steady_clock::now();
+        GstVideoInfo info;
+        if (analyse(sample, &info)) {
+            int x = 0, y = 0;
+            if (!have_position) {
+                place(sample, &info, 0, 0);
+            } else if (count_diff_above(luma.data(), last_luma.data(), luma.size(), changed_level) <
+                       settings.redundant * luma.size()) {
+                ++skipped;
+            } else if (register_frame(&x, &y)) {
+                place(sample, &info, x, y);
+            } else {
+                ++lost;
+                velocity_x = velocity_y = 0;
+                if (!warned_lost) {
+                    std::cout << "Mosaic lost its place; pan back over the covered area." << std::endl;
+                    warned_lost = true;
+                }
+            }
+        }
+        gst_sample_unref(sample);
+
+        auto now = std::chrono::steady_clock::now();
+        double took = std::chrono::duration<double, std::milli>(now - begin).count();
+        processed++;
+        total_ms += took;
+        max_ms = std::max(max_ms, took);
+        if (placed != previewed && now - last_preview >= std::chrono::milliseconds(500)) {
+            update_preview();
+            previewed = placed;
+            last_preview = now;
+        }
+    }
+}
+
+// 1/downsample luma of the frame into `luma`
+bool Mosaic::analyse(GstSample* sample, GstVideoInfo* info) {
+    TraceSpan span("mosaic", "mosaic_analyse");
+    LumaLayout layout;
+    if (!gst_video_info_from_caps(info, gst_sample_get_caps(sample)) || !find_luma_layout(info, &layout)) {
+        if (!warned_format) {
+            std::cerr << "Mosaic needs raw video frames." << std::endl;
+            warned_format = true;
+        }
+        return false;
+    }
+    int width = GST_VIDEO_INFO_WIDTH(info), height = GST_VIDEO_INFO_HEIGHT(info);
+    if (have_position && (width != frame_width || height != frame_height)) {
+        if (!warned_format) {
+            std::cerr << "Mosaic: resolution changed, frames ignored until restarted." << std::endl;
+            warned_format = true;
+        }
+        return false;
+    }
+    GstVideoFrame frame;
+    if (!gst_video_frame_map(&frame, info, gst_sample_get_buffer(sample), GST_MAP_READ)) {
+        return false;
+    }
+    if (width != frame_width || height != frame_height) {
+        frame_width = width;
+        frame_height = height;
+        cells_width = width / settings.downsample;
+        cells_height = height / settings.downsample;
+        size_t cells = (size_t)cells_width * cells_height;
+        luma.resize(cells);
+        region.resize(cells);
+        painted.resize(cells);
+        window.resize(cells);
+        cv::Mat hann(cells_height, cells_width, CV_32F, window.data());
+        cv::createHanningWindow(hann, hann.size(), CV_32F);
+    }
+    downsample_luma(static_cast<const uint8_t*>(GST_VIDEO_FRAME_PLANE_DATA(&frame, 0)),
+                    GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 0), width, height, layout, settings.downsample,
+                    luma.data());
+    gst_video_frame_unmap(&frame);
+    return true;
+}
+
+// Canvas position of the current frame: phase correlation between the frame
+// and the canvas where the frame is expected, at registration scale.
+bool Mosaic::register_frame(int* x, int* y) {
+    TraceSpan span("mosaic", "mosaic_register");
+    int predicted_x = position_x + velocity_x, predicted_y = position_y + velocity_y;
+    double coverage;
+    {
+        std::lock_guard<std::mutex> lock(canvas_mutex);
+        coverage = canvas.sample_luma(predicted_x, predicted_y, step, cells_width, cells_height, region.data(),
+                                      painted.data());
+    }
+    if (coverage < min_coverage) {
+        return false;
+    }
+    // Unpainted cells take the mean of the painted ones, so the edge of the
+    // canvas doesn't show up as a feature to lock on to
+    uint64_t sum = 0, count = 0;
+    for (size_t i = 0; i < region.size(); ++i) {
+        if (painted[i]) {
+            sum += region[i];
+            ++count;
+        }
+    }
+    uint8_t mean = (uint8_t)(sum / count);
+    std::vector<float> reference(region.size()), current(luma.begin(), luma.end());
+    for (size_t i = 0; i < region.size(); ++i) {
+        reference[i] = painted[i] ? region[i] : mean;
+    }
+
+    cv::Mat a(cells_height, cells_width, CV_32F, reference.data());
+    cv::Mat b(cells_height, cells_width, CV_32F, current.data());
+    cv::Mat hann(cells_height, cells_width, CV_32F, window.data());
+    double response = 0;
+    cv::Point2d shift = cv::phaseCorrelate(a, b, hann, &response);
+    if (response < settings.min_response) {
+        return false;
+    }
+    // The frame shows the canvas content `shift` cells further on, so it sits
+    // that much before the prediction
+    *x = predicted_x - (int)std::lround(shift.x * step);
+    *y = predicted_y - (int)std::lround(shift.y * step);
+    return true;
+}
+
+bool Mosaic::place(GstSample* sample, GstVideoInfo* info, int x, int y) {
+    TraceSpan span("mosaic", "mosaic_place");
+    GstVideoFrame frame;
+    if (!gst_video_frame_map(&frame, info, gst_sample_get_buffer(sample), GST_MAP_READ)) {
+        return false;
+    }
+    cv::Mat rgb, scaled;
+    bool converted = frame_to_rgb(frame, rgb);
+    gst_video_frame_unmap(&frame);
+    if (!converted) {
+        if (!warned_format) {
+            std::cerr << "Mosaic: no colour conversion for "
+                      << gst_video_format_to_string(GST_VIDEO_INFO_FORMAT(info)) << std::endl;
+            warned_format = true;
+        }
+        return false;
+    }
+    cv::resize(rgb, scaled, cv::Size((int)std::lround(frame_width * settings.scale),
+                                     (int)std::lround(frame_height * settings.scale)), 0, 0, cv::INTER_AREA);
+    {
+        std::lock_guard<std::mutex> lock(canvas_mutex);
+        canvas.blend(scaled.data, (int)scaled.step, scaled.cols, scaled.rows, x, y);
+    }
+    if (have_position) {
+        velocity_x = x - position_x;
+        velocity_y = y - position_y;
+    }
+    have_position = true;
+    position_x = x;
+    position_y = y;
+    last_luma = luma;
+    warned_lost = false;
+    ++placed;
+    return true;
+}
+
+void Mosaic::update_preview() {
+    TraceSpan span("mosaic", "mosaic_preview");
+    std::vector<uint8_t> rgb;
+    int width, height;
+    {
+        std::lock_guard<std::mutex> lock(canvas_mutex);
+        canvas.render(settings.preview_side, rgb, width, height);
+    }
+    std::lock_guard<std::mutex> lock(preview_mutex);
+    preview_rgb.swap(rgb);
+    preview_width = width;
+    preview_height = height;
+    ++preview_version;
+}
+
+std::string Mosaic::save(const std::string& directory) {
+    TraceSpan span("mosaic", "mosaic_save");
+    std::vector<uint8_t> rgb;
+    int width, height;
+    size_t tiles;
+    {
+        std::lock_guard<std::mutex> lock(canvas_mutex);
+        canvas.render(0, rgb, width, height);
+        tiles = canvas.tile_count();
+    }
+    if (rgb.empty()) {
+        std::cerr << "Mosaic is empty, nothing saved." << std::endl;
+        return "";
+    }
+    if (g_mkdir_with_parents(directory.c_str(), 0755) != 0) {
+        std::cerr << "Cannot create " << directory << std::endl;
+        return "";
+    }
+    cv::Mat bgr;
+    cv::cvtColor(cv::Mat(height, width, CV_8UC3, rgb.data()), bgr, cv::COLOR_RGB2BGR);
+    std::string path = capture_path(directory, "mosaic");
+    if (!cv::imwrite(path, bgr)) {
+        std::cerr << "Cannot write " << path << std::endl;
+        return "";
+    }
+    std::cout << "Mosaic " << width << "x" << height << " (" << tiles << " tiles) saved to " << path << std::endl;
+    return path;
+}
@@ -0,0 +1,139 @@
+#include "MosaicCanvas.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Rounds towards negative infinity, for tile indices left of / above 0
+inline int floor_div(int value, int divisor) {
+    return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+const uint8_t max_weight = 8; // later frames keep at least 1/8 of the say
+
+} // namespace
+
+MosaicCanvas::Tile* MosaicCanvas::tile_at(int tx, int ty, bool create) {
+    auto it = tiles.find(key(tx, ty));
+    if (it != tiles.end()) {
+        return it->second.get();
+    }
+    if (!create) {
+        return nullptr;
+    }
+    auto tile = std::make_unique<Tile>();
+    std::memset(tile->rgb, 0, sizeof(tile->rgb));
+    std::memset(tile->weight, 0, sizeof(tile->weight));
+    Tile *raw = tile.get();
+    tiles.emplace(key(tx, ty), std::move(tile));
+    return raw;
+}
+
+const MosaicCanvas::Tile* MosaicCanvas::tile_at(int tx, int ty) const {
+    auto it = tiles.find(key(tx, ty));
+    return it != tiles.end() ? it->second.get() : nullptr;
+}
+
+void MosaicCanvas::blend(const uint8_t* rgb, int stride, int width, int height, int x, int y) {
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+    if (extent.empty()) {
+        extent = {x, y, x + width, y + height};
+    } else {
+        extent = {std::min(extent.x0, x), std::min(extent.y0, y), std::max(extent.x1, x + width),
+                  std::max(extent.y1, y + height)};
+    }
+
+    // Tile by tile, so each tile is looked up once per frame
+    for (int ty = floor_div(y, tile_size); ty * tile_size < y + height; ++ty) {
+        for (int tx = floor_div(x, tile_size); tx * tile_size < x + width; ++tx) {
+            Tile *tile = tile_at(tx, ty, true);
+            int cx0 = std::max(x, tx * tile_size), cx1 = std::min(x + width, (tx + 1) * tile_size);
+            int cy0 = std::max(y, ty * tile_size), cy1 = std::min(y + height, (ty + 1) * tile_size);
+            for (int cy = cy0; cy < cy1; ++cy) {
+                const uint8_t *src = rgb + (size_t)(cy - y) * stride + (size_t)(cx0 - x) * 3;
+                size_t offset = (size_t)(cy - ty * tile_size) * tile_size + (cx0 - tx * tile_size);
+                uint8_t *dst = tile->rgb + offset * 3;
+                uint8_t *weight = tile->weight + offset;
+                for (int cx = cx0; cx < cx1; ++cx, src += 3, dst += 3, ++weight) {
+                    unsigned w = *weight;
+                    for (int c = 0; c < 3; ++c) {
+                        dst[c] = (uint8_t)((dst[c] * w + src[c] + w / 2) / (w + 1));
+                    }
+                    if (w < max_weight) {
+                        *weight = (uint8_t)(w + 1);
+                    }
+                }
+            }
+        }
+    }
+}
+
+double MosaicCanvas::sample_luma(int x, int y, int step, int width, int height, uint8_t* out,
+                                 uint8_t* painted_mask) const {
+    size_t painted = 0;
+    for (int row = 0; row < height; ++row) {
+        int cy = y + row * step;
+        int ty = floor_div(cy, tile_size);
+        const Tile *tile = nullptr;
+        int current_tx = 0;
+        bool looked_up = false;
+        for (int col = 0; col < width; ++col) {
+            int cx = x + col * step;
+            int tx = floor_div(cx, tile_size);
+            if (!looked_up || tx != current_tx) {
+                tile = tile_at(tx, ty);
+                current_tx = tx;
+                looked_up = true;
+            }
+            uint8_t value = 0, is_painted = 0;
+            if (tile) {
+                size_t offset = (size_t)(cy - ty * tile_size) * tile_size + (cx - tx * tile_size);
+                if (tile->weight[offset]) {
+                    const uint8_t *p = tile->rgb + offset * 3;
+                    value = (uint8_t)((p[0] + 2 * p[1] + p[2]) >> 2);
+                    is_painted = 1;
+                    ++painted;
+                }
+            }
+            out[(size_t)row * width + col] = value;
+            if (painted_mask) {
+                painted_mask[(size_t)row * width + col] = is_painted;
+            }
+        }
+    }
+    return width > 0 && height > 0 ? (double)painted / ((size_t)width * height) : 0;
+}
+
+void MosaicCanvas::render(int max_side, std::vector<uint8_t>& rgb, int& width, int& height) const {
+    int full_width = extent.x1 - extent.x0, full_height = extent.y1 - extent.y0;
+    if (extent.empty()) {
+        width = height = 0;
+        rgb.clear();
+        return;
+    }
+    double scale = 1;
+    if (max_side > 0 && std::max(full_width, full_height) > max_side) {
+        scale = (double)max_side / std::max(full_width, full_height);
+    }
+    width = std::max(1, (int)(full_width * scale));
+    height = std::max(1, (int)(full_height * scale));
+    rgb.assign((size_t)width * height * 3, 0);
+
+    for (int row = 0; row < height; ++row) {
+        int cy = extent.y0 + (int)(row / scale);
+        int ty = floor_div(cy, tile_size);
+        for (int col = 0; col < width; ++col) {
+            int cx = extent.x0 + (int)(col / scale);
+            int tx = floor_div(cx, tile_size);
+            const Tile *tile = tile_at(tx, ty);
+            if (!tile) {
+                continue;
+            }
+            size_t offset = (size_t)(cy - ty * tile_size) * tile_size + (cx - tx * tile_size);
+            std::memcpy(&rgb[((size_t)row * width + col) * 3], tile->rgb + offset * 3, 3);
+        }
+    }
+}
@@ -0,0 +1,37 @@
+#include "MosaicWindow.h"
+
+#include <cstring>
+#include <sstream>
+
+MosaicWindow::MosaicWindow(Mosaic& mosaic) : mosaic(mosaic), box(Gtk::ORIENTATION_VERTICAL) {
+    set_title("Mosaic");
+    set_default_size(660, 420);
+    box.pack_start(image, Gtk::PACK_EXPAND_WIDGET);
+    box.pack_start(status, Gtk::PACK_SHRINK);
+    add(box);
+    refresh_timer = Glib::signal_timeout().connect(sigc::mem_fun(*this, &MosaicWindow::on_refresh), 500);
+    show_all_children();
+}
+
+MosaicWindow::~MosaicWindow() {
+    refresh_timer.disconnect();
+}
+
+bool MosaicWindow::on_refresh() {
+    std::ostringstream text;
+    text << mosaic.frames_placed() << " frames placed, " << mosaic.frames_skipped() << " unchanged, "
+         << mosaic.frames_lost() << " not registered";
+    status.set_text(text.str());
+
+    int width = 0, height = 0;
+    if (!mosaic.preview(rgb, &width, &height, &version) || rgb.empty()) {
+        return true;
+    }
+    auto pixbuf = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, false, 8, width, height);
+    for (int y = 0; y < height; ++y) {
+        std::memcpy(pixbuf->get_pixels() + (size_t)y * pixbuf->get_rowstride(), rgb.data() + (size_t)y * width * 3,
+                    (size_t)width * 3);
+    }
+    image.set(pixbuf);
+    return true;
+}
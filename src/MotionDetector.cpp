@@ -0,0 +1,139 @@
+#include "MotionDetector.h"
+#include "MotionKernels.h"
+#include "ThreadPolicy.h"
+#include "Tracer.h"
+
+#include <gst/video/video.h>
+
+#include <algorithm>
+#include <ctime>
+#include <iostream>
+
+MotionDetector::MotionDetector(FrameMailbox& mailbox, const MotionSettings& settings)
+    : mailbox(mailbox), settings(settings) {
+    // Compared as a byte, so out-of-range values would wrap (300 -> 44)
+    int threshold = std::min(std::max(settings.pixel_threshold, 0), 255);
+    if (threshold != settings.pixel_threshold) {
+        std::cerr << "Motion threshold " << settings.pixel_threshold << " is outside 0-255, using " << threshold
+                  << "." << std::endl;
+        this->settings.pixel_threshold = threshold;
+    }
+    thread = std::thread(&MotionDetector::run, this);
+}
+
+MotionDetector::~MotionDetector() {
+    running = false;
+    thread.join();
+}
+
+double MotionDetector::cpu_percent() const {
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return wall > 0 ? 100.0 * cpu_seconds / wall : 0;
+}
+
+void MotionDetector::run() {
+    ThreadPolicy::instance().adopt_current("motion");
+    auto period = std::chrono::microseconds(1000000 / std::max(1, settings.analysis_fps));
+    auto next = std::chrono::steady_clock::now();
+    auto next_report = next + std::chrono::seconds(60);
+    uint64_t sequence = 0;
+    uint64_t brackets = 0;
+
+    while (running) {
+        next += period;
+        std::this_thread::sleep_until(next);
+
+        if (mailbox.disturbed(&brackets)) {
+            background.clear(); // exposure steps would read as motion everywhere
+            continue;
+        }
+        if (GstSample *sample = mailbox.take(&sequence)) {
+            analyse(sample);
+            gst_sample_unref(sample);
+        }
+
+        timespec cpu;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+        cpu_seconds = cpu.tv_sec + cpu.tv_nsec / 1e9;
+        if (std::chrono::steady_clock::now() >= next_report) {
+            next_report += std::chrono::seconds(60);
+            std::cout << "Motion detector: " << cpu_percent() << "% of a core" << std::endl;
+        }
+    }
+}
+
+bool find_luma_layout(const GstVideoInfo* info, LumaLayout* layout) {
+    switch (GST_VIDEO_INFO_FORMAT(info)) {
+    case GST_VIDEO_FORMAT_YUY2:
+    case GST_VIDEO_FORMAT_YVYU:
+        *layout = LumaLayout::YUYV;
+        return true;
+    case GST_VIDEO_FORMAT_UYVY:
+        *layout = LumaLayout::UYVY;
+        return true;
+    case GST_VIDEO_FORMAT_RGBx:
+    case GST_VIDEO_FORMAT_BGRx:
+    case GST_VIDEO_FORMAT_xRGB:
+    case GST_VIDEO_FORMAT_xBGR:
+    case GST_VIDEO_FORMAT_RGBA:
+    case GST_VIDEO_FORMAT_BGRA:
+        *layout = LumaLayout::Packed4;
+        return true;
+    default:
+        // I420, NV12, GRAY8, ...
+        *layout = LumaLayout::Planar;
+        return (GST_VIDEO_FORMAT_INFO_IS_YUV(info->finfo) || GST_VIDEO_FORMAT_INFO_IS_GRAY(info->finfo)) &&
+               GST_VIDEO_INFO_COMP_PSTRIDE(info, 0) == 1;
+    }
+}
+
+bool MotionDetector::analyse(GstSample* sample) {
+    TraceSpan span("motion", "motion_analyse");
+    GstVideoInfo info;
+    if (!gst_video_info_from_caps(&info, gst_sample_get_caps(sample))) {
+        if (!warned_format) {
+            std::cerr << "Motion detection needs raw video; MJPEG capture is not analysed." << std::endl;
+            warned_format = true;
+        }
+        return false;
+    }
+
+    LumaLayout layout;
+    if (!find_luma_layout(&info, &layout)) {
+        if (!warned_format) {
+            std::cerr << "Motion detection does not handle " << gst_video_format_to_string(GST_VIDEO_INFO_FORMAT(&info))
+                      << std::endl;
+            warned_format = true;
+        }
+        return false;
+    }
+
+    GstVideoFrame frame;
+    if (!gst_video_frame_map(&frame, &info, gst_sample_get_buffer(sample), GST_MAP_READ)) {
+        return false;
+    }
+    int width = GST_VIDEO_INFO_WIDTH(&info);
+    int height = GST_VIDEO_INFO_HEIGHT(&info);
+    int factor = settings.downsample;
+    if (width / factor != cells_width || height / factor != cells_height) {
+        cells_width = width / factor;
+        cells_height = height / factor;
+        current.assign((size_t)cells_width * cells_height, 0);
+        background.clear(); // new resolution, start over
+    }
+    downsample_luma(static_cast<const uint8_t*>(GST_VIDEO_FRAME_PLANE_DATA(&frame, 0)),
+                    GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 0), width, height, layout, factor, current.data());
+    gst_video_frame_unmap(&frame);
+
+    if (background.empty()) {
+        background = current;
+        return true;
+    }
+    size_t count = count_diff_above(current.data(), background.data(), current.size(), (uint8_t)settings.pixel_threshold);
+    double percent = 100.0 * count / current.size();
+    blend_background(background.data(), current.data(), current.size());
+
+    changed = percent;
+    in_motion = percent >= settings.area_percent;
+    return true;
+}
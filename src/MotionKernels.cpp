@@ -0,0 +1,167 @@
+#include "MotionKernels.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+inline uint8_t abs_diff(uint8_t a, uint8_t b) {
+    return a > b ? a - b : b - a;
+}
+
+inline uint8_t avg_round(uint8_t a, uint8_t b) {
+    return (uint8_t)((a + b + 1) >> 1); // same rounding as pavgb / vrhadd
+}
+
+#if defined(__ARM_NEON)
+// Horizontal adds: vaddlv/vaddv only exist on AArch64; 32-bit ARM folds
+// with pairwise widening adds instead.
+inline uint32_t add_lanes(uint8x8_t v) {
+#if defined(__aarch64__)
+    return vaddlv_u8(v);
+#else
+    return (uint32_t)vget_lane_u64(vpaddl_u32(vpaddl_u16(vpaddl_u8(v))), 0);
+#endif
+}
+
+inline uint32_t add_lanes(uint8x16_t v) {
+#if defined(__aarch64__)
+    return vaddlvq_u8(v);
+#else
+    uint64x2_t sum = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(v)));
+    return (uint32_t)(vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1));
+#endif
+}
+#endif
+
+// Sum of 8 luma samples starting at x (in pixels) of a row
+inline uint32_t sum8(const uint8_t* row, int x, LumaLayout layout) {
+    uint32_t sum = 0;
+    switch (layout) {
+    case LumaLayout::Planar: {
+#if defined(__SSE2__)
+        __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + x));
+        return (uint32_t)_mm_cvtsi128_si32(_mm_sad_epu8(v, _mm_setzero_si128()));
+#elif defined(__ARM_NEON)
+        return add_lanes(vld1_u8(row + x));
+#else
+        for (int i = 0; i < 8; ++i) sum += row[x + i];
+        return sum;
+#endif
+    }
+    case LumaLayout::YUYV:
+    case LumaLayout::UYVY: {
+        const uint8_t *p = row + x * 2 + (layout == LumaLayout::UYVY ? 1 : 0);
+#if defined(__SSE2__)
+        // Mask the chroma bytes away and let psadbw add up the rest
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        v = _mm_and_si128(v, _mm_set1_epi16(0x00FF));
+        __m128i s = _mm_sad_epu8(v, _mm_setzero_si128());
+        return (uint32_t)(_mm_cvtsi128_si32(s) + _mm_cvtsi128_si32(_mm_srli_si128(s, 8)));
+#elif defined(__ARM_NEON)
+        return add_lanes(vld2_u8(p).val[0]);
+#else
+        for (int i = 0; i < 8; ++i) sum += p[i * 2];
+        return sum;
+#endif
+    }
+    case LumaLayout::Packed4:
+        for (int i = 0; i < 8; ++i) sum += row[(x + i) * 4 + 1];
+        return sum;
+    }
+    return sum;
+}
+
+// One luma sample at x (in pixels), for factors sum8 can't cover
+inline uint8_t luma_at(const uint8_t* row, int x, LumaLayout layout) {
+    switch (layout) {
+    case LumaLayout::Planar: return row[x];
+    case LumaLayout::YUYV: return row[x * 2];
+    case LumaLayout::UYVY: return row[x * 2 + 1];
+    case LumaLayout::Packed4: return row[x * 4 + 1];
+    }
+    return 0;
+}
+
+} // namespace
+
+void downsample_luma(const uint8_t* data, int stride, int width, int height, LumaLayout layout, int factor,
+                     uint8_t* out) {
+    int out_width = width / factor;
+    int out_height = height / factor;
+    if (factor % 8 != 0) {
+        // sum8 would read past the factor (and the row end) here
+        for (int y = 0; y < out_height; ++y) {
+            const uint8_t *row = data + (size_t)(y * factor + factor / 2) * stride;
+            for (int x = 0; x < out_width; ++x) {
+                uint32_t sum = 0;
+                for (int i = 0; i < factor; ++i) {
+                    sum += luma_at(row, x * factor + i, layout);
+                }
+                out[(size_t)y * out_width + x] = (uint8_t)(sum / factor);
+            }
+        }
+        return;
+    }
+    int groups = factor / 8; // sum8 calls per output pixel
+    for (int y = 0; y < out_height; ++y) {
+        const uint8_t *row = data + (size_t)(y * factor + factor / 2) * stride;
+        for (int x = 0; x < out_width; ++x) {
+            uint32_t sum = 0;
+            for (int g = 0; g < groups; ++g) {
+                sum += sum8(row, x * factor + g * 8, layout);
+            }
+            out[(size_t)y * out_width + x] = (uint8_t)(sum / (groups * 8));
+        }
+    }
+}
+
+size_t count_diff_above(const uint8_t* a, const uint8_t* b, size_t n, uint8_t threshold) {
+    size_t count = 0;
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i limit = _mm_set1_epi8((char)threshold);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        __m128i diff = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+        // diff > threshold  <=>  saturating diff - threshold is non-zero
+        __m128i over = _mm_cmpeq_epi8(_mm_subs_epu8(diff, limit), zero);
+        count += 16 - __builtin_popcount(_mm_movemask_epi8(over));
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t limit = vdupq_n_u8(threshold);
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t diff = vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+        uint8x16_t over = vshrq_n_u8(vcgtq_u8(diff, limit), 7); // 1 where above
+        count += add_lanes(over);
+    }
+#endif
+    for (; i < n; ++i) {
+        count += abs_diff(a[i], b[i]) > threshold;
+    }
+    return count;
+}
+
+void blend_background(uint8_t* background, const uint8_t* current, size_t n) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= n; i += 16) {
+        __m128i bg = _mm_loadu_si128(reinterpret_cast<const __m128i*>(background + i));
+        __m128i cur = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(background + i), _mm_avg_epu8(bg, _mm_avg_epu8(bg, cur)));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t bg = vld1q_u8(background + i);
+        vst1q_u8(background + i, vrhaddq_u8(bg, vrhaddq_u8(bg, vld1q_u8(current + i))));
+    }
+#endif
+    for (; i < n; ++i) {
+        background[i] = avg_round(background[i], avg_round(background[i], current[i]));
+    }
+}
@@ -0,0 +1,71 @@
+#include "MotionTrigger.h"
+#include "Tracer.h"
+
+#include <iostream>
+
+MotionTrigger::MotionTrigger(Recorder& recorder, FrameMailbox& mailbox, const MotionSettings& settings,
+                             int post_roll_seconds)
+    : recorder(recorder),
+      detector(std::make_unique<MotionDetector>(mailbox, settings)),
+      post_roll(post_roll_seconds) {
+    tick_id = g_timeout_add(100, &MotionTrigger::on_tick, this);
+}
+
+MotionTrigger::~MotionTrigger() {
+    if (tick_id) {
+        g_source_remove(tick_id);
+    }
+    std::cout << "Motion detector used " << detector->cpu_percent() << "% of a core" << std::endl;
+}
+
+gboolean MotionTrigger::on_tick(gpointer user_data) {
+    static_cast<MotionTrigger*>(user_data)->tick();
+    return G_SOURCE_CONTINUE;
+}
+
+void MotionTrigger::tick() {
+    auto now = std::chrono::steady_clock::now();
+    bool moving = detector->motion();
+    if (moving) {
+        last_motion = now;
+    }
+
+    switch (state) {
+    case State::Arming:
+        if (!recorder.recording() && recorder.start()) {
+            state = State::Armed;
+        }
+        break;
+    case State::Armed:
+        if (!recorder.recording()) {
+            state = State::Arming;
+        } else if (moving) {
+            Tracer::instance().instant("motion", "motion_start");
+            std::cout << "Motion detected (" << detector->changed_percent() << "% changed), recording" << std::endl;
+            event_start = now;
+            recorder.open_gate();
+            state = State::Recording;
+        }
+        break;
+    case State::Recording:
+        if (!recorder.recording()) {
+            state = State::Arming; // stopped elsewhere
+        } else if (now - last_motion > post_roll) {
+            Tracer::instance().instant("motion", "motion_end");
+            std::cout << "Motion ended after "
+                      << std::chrono::duration_cast<std::chrono::seconds>(now - event_start).count()
+                      << " s, stopping recording" << std::endl;
+            recorder.stop();
+            state = State::Stopping;
+        } else if (!recorder.gate_open()) {
+            recorder.open_gate(); // the branch was restarted (encoder retune) mid-event
+        }
+        break;
+    case State::Stopping:
+        // The segment is finalised asynchronously; re-arm once it is closed
+        if (!recorder.recording()) {
+            state = State::Arming;
+        }
+        break;
+    }
+}
@@ -0,0 +1,120 @@
+#include "RawCapture.h"
+#include "Tracer.h"
+
+#include <cstring>
+#include <iostream>
+
+RawCapture::RawCapture(GstPad* pad, const std::string& path, uint64_t capacity)
+    : pad(GST_PAD(gst_object_ref(pad))),
+      writer(std::make_unique<FrameStoreWriter>(path, capacity, staging_depth)) {
+    if (GstCaps *caps = gst_pad_get_current_caps(pad)) {
+        set_caps(caps);
+        gst_caps_unref(caps);
+    }
+    probe_id = gst_pad_add_probe(pad,
+        static_cast<GstPadProbeType>(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM),
+        &RawCapture::on_data, this, nullptr);
+}
+
+RawCapture::~RawCapture() {
+    gst_pad_remove_probe(pad, probe_id);
+    gst_object_unref(pad);
+    writer->close(); // hands back every staging buffer
+}
+
+GstPadProbeReturn RawCapture::on_data(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    auto self = static_cast<RawCapture*>(user_data);
+    if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+        GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+        if (GST_EVENT_TYPE(event) == GST_EVENT_CAPS) {
+            GstCaps *caps = nullptr;
+            gst_event_parse_caps(event, &caps);
+            self->set_caps(caps);
+        }
+        return GST_PAD_PROBE_OK;
+    }
+    self->on_buffer(GST_PAD_PROBE_INFO_BUFFER(info));
+    return GST_PAD_PROBE_OK;
+}
+
+void RawCapture::set_caps(GstCaps* caps) {
+    GstStructure *s = caps ? gst_caps_get_structure(caps, 0) : nullptr;
+    if (!s || !gst_structure_has_name(s, "video/x-raw") || !gst_video_info_from_caps(&video, caps)) {
+        if (!warned_format) {
+            std::cerr << "Raw capture: " << (s ? gst_structure_get_name(s) : "unknown caps")
+                      << " is not supported, only uncompressed video is stored. Nothing is written"
+                      << " until the camera delivers a raw format (e.g. YUY2)." << std::endl;
+            warned_format = true;
+        }
+        have_video = false;
+        return;
+    }
+    have_video = true;
+    warned_format = false;
+}
+
+void RawCapture::on_buffer(GstBuffer* buffer) {
+    if (!have_video) {
+        return;
+    }
+    TraceSpan span("raw", "raw_copy");
+
+    GstMapInfo mapped;
+    if (!gst_buffer_map(buffer, &mapped, GST_MAP_READ)) {
+        return;
+    }
+    std::vector<uint8_t> *staging = take_staging(mapped.size);
+    if (!staging) {
+        gst_buffer_unmap(buffer, &mapped);
+        dropped_staging++;
+        return;
+    }
+    std::memcpy(staging->data(), mapped.data, mapped.size);
+    gst_buffer_unmap(buffer, &mapped);
+
+    // v4l2src puts the driver's frame sequence number in the buffer offset
+    uint64_t sequence = GST_BUFFER_OFFSET_IS_VALID(buffer) ? GST_BUFFER_OFFSET(buffer) : next_sequence;
+    next_sequence = sequence + 1;
+
+    FrameStoreWriter::Frame frame;
+    frame.data = staging->data();
+    frame.size = staging->size();
+    frame.width = GST_VIDEO_INFO_WIDTH(&video);
+    frame.height = GST_VIDEO_INFO_HEIGHT(&video);
+    frame.fourcc = gst_video_format_to_fourcc(GST_VIDEO_INFO_FORMAT(&video));
+    frame.timestamp_ns = GST_BUFFER_PTS_IS_VALID(buffer) ? GST_BUFFER_PTS(buffer) : 0;
+    frame.sequence = sequence;
+    frame.release = [this, staging]() { return_staging(staging); };
+    writer->submit(std::move(frame));
+}
+
+// At most staging_depth buffers exist per frame size; when all of them are
+// with the writer the frame is dropped rather than allocated for.
+std::vector<uint8_t>* RawCapture::take_staging(size_t size) {
+    std::lock_guard<std::mutex> lock(staging_mutex);
+    if (size != staging_size) {
+        free_staging.clear(); // new caps; buffers still out are freed on return
+        staging_size = size;
+    }
+    std::vector<uint8_t> *staging = nullptr;
+    if (!free_staging.empty()) {
+        staging = free_staging.back().release();
+        free_staging.pop_back();
+    } else if (staging_out < staging_depth) {
+        staging = new std::vector<uint8_t>(size);
+    } else {
+        return nullptr;
+    }
+    staging_out++;
+    return staging;
+}
+
+void RawCapture::return_staging(std::vector<uint8_t>* staging) {
+    std::lock_guard<std::mutex> lock(staging_mutex);
+    staging_out--;
+    if (staging->size() == staging_size) {
+        free_staging.emplace_back(staging);
+    } else {
+        delete staging;
+    }
+}
@@ -0,0 +1,383 @@
+#include "Recorder.h"
+#include "Tracer.h"
+
+#include <algorithm>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static const char* segment_prefix = "mivo_";
+static const char* segment_suffix = ".mp4";
+static const int keyframe_interval = 60; // frames
+
+Recorder::Recorder(GstElement* pipeline, GstElement* tee, const RecorderSettings& settings)
+    : pipeline(pipeline), tee(tee), settings(settings) {}
+
+Recorder::~Recorder() {
+    if (bin) {
+        teardown();
+    }
+}
+
+GstElement* Recorder::build_branch() {
+    GstElement *branch = gst_bin_new("recorder");
+    GstElement *queue = gst_element_factory_make("queue", "record_queue");
+    GstElement *convert = gst_element_factory_make("videoconvert", "record_convert");
+    GstElement *encoder = gst_element_factory_make("x264enc", "record_encoder");
+    GstElement *parse = gst_element_factory_make("h264parse", "record_parse");
+    GstElement *mux = gst_element_factory_make("mp4mux", "record_mux");
+    GstElement *sink = gst_element_factory_make("splitmuxsink", "record_sink");
+
+    if (!queue || !convert || !encoder || !parse || !mux || !sink) {
+        std::cerr << "Failed to create recording elements." << std::endl;
+        for (GstElement *e : {queue, convert, encoder, parse, mux, sink}) {
+            if (e) gst_object_unref(e);
+        }
+        gst_object_unref(branch);
+        return nullptr;
+    }
+
+    // Forward the branch's EOS to the bus so stop() knows when the last
+    // segment has been finalised.
+    g_object_set(branch, "message-forward", TRUE, nullptr);
+
+    // Leaky so a slow encoder drops recorded frames instead of blocking the tee
+    // (and with it the live display).
+    g_object_set(queue, "leaky", 2, "max-size-buffers", 0, "max-size-bytes", 0,
+                 "max-size-time", (guint64)(2 * GST_SECOND), nullptr);
+
+    g_object_set(encoder, "tune", 4, "speed-preset", settings.speed_preset, "threads", settings.threads,
+                 "bitrate", settings.bitrate_kbps, "key-int-max", keyframe_interval, nullptr);
+
+    // Fragmented MP4: the moov is written up front and each one-second moof is
+    // complete on its own, so nothing depends on the index written at EOS.
+    g_object_set(mux, "fragment-duration", 1000, nullptr);
+
+    g_object_set(sink, "muxer", mux,
+                 "max-size-time", (guint64)settings.segment_seconds * GST_SECOND,
+                 "send-keyframe-requests", TRUE, nullptr);
+    g_signal_connect(sink, "format-location", G_CALLBACK(&Recorder::on_format_location), this);
+
+    gst_bin_add_many(GST_BIN(branch), queue, convert, encoder, parse, sink, nullptr);
+    GstElement *last = parse;
+    GstElement *preroll = nullptr;
+    if (settings.preroll_seconds > 0) {
+        // Encoded video is small (a few MB for several seconds), raw is not
+        preroll = gst_element_factory_make("queue", "record_preroll");
+        // Room for one more GOP (at 30 fps, plus slack) so the oldest keyframe
+        // held is at least preroll_seconds back
+        guint64 gop = (guint64)(keyframe_interval / 30 + 1) * GST_SECOND;
+        g_object_set(preroll, "leaky", 2, "max-size-buffers", 0, "max-size-bytes", 0,
+                     "max-size-time", (guint64)settings.preroll_seconds * GST_SECOND + gop, nullptr);
+        gst_bin_add(GST_BIN(branch), preroll);
+        gst_element_link(parse, preroll);
+        last = preroll;
+    }
+    if (!gst_element_link_many(queue, convert, encoder, parse, nullptr) || !gst_element_link(last, sink)) {
+        std::cerr << "Failed to link recording elements." << std::endl;
+        gst_object_unref(branch);
+        return nullptr;
+    }
+    if (preroll) {
+        // Closed gate: buffers pile up in the leaky queue, oldest dropped first
+        GstPad *src = gst_element_get_static_pad(preroll, "src");
+        gate_probe = gst_pad_add_probe(src, (GstPadProbeType)(GST_PAD_PROBE_TYPE_BLOCK | GST_PAD_PROBE_TYPE_BUFFER),
+                                       &Recorder::on_gate_blocked, nullptr, nullptr);
+        gst_object_unref(src);
+    }
+
+    // Counted per branch; EncoderTuner sees them drop and starts over
+    frames_offered = 0;
+    frames_encoded = 0;
+    GstPad *pad = gst_element_get_static_pad(queue, "sink");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, &Recorder::on_count_buffer, &frames_offered, nullptr);
+    gst_element_add_pad(branch, gst_ghost_pad_new("sink", pad));
+    gst_object_unref(pad);
+
+    pad = gst_element_get_static_pad(encoder, "src");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, &Recorder::on_count_buffer, &frames_encoded, nullptr);
+    gst_object_unref(pad);
+
+    splitmux = sink;
+    this->queue = queue;
+    this->encoder = encoder;
+    this->preroll = preroll;
+    return branch;
+}
+
+bool Recorder::start() {
+    if (bin) {
+        return true;
+    }
+    if (g_mkdir_with_parents(settings.directory.c_str(), 0755) != 0) {
+        std::cerr << "Cannot create recording directory " << settings.directory << std::endl;
+        return false;
+    }
+
+    char stamp[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", std::localtime(&now));
+    session = stamp;
+
+    bin = build_branch();
+    if (!bin) {
+        return false;
+    }
+    gst_bin_add(GST_BIN(pipeline), bin);
+    gst_element_sync_state_with_parent(bin);
+
+#if GST_CHECK_VERSION(1, 20, 0)
+    tee_pad = gst_element_request_pad_simple(tee, "src_%u");
+#else
+    tee_pad = gst_element_get_request_pad(tee, "src_%u");
+#endif
+    GstPad *sink_pad = gst_element_get_static_pad(bin, "sink");
+    GstPadLinkReturn linked = gst_pad_link(tee_pad, sink_pad);
+    gst_object_unref(sink_pad);
+
+    if (linked != GST_PAD_LINK_OK) {
+        std::cerr << "Failed to attach recording branch." << std::endl;
+        gst_element_release_request_pad(tee, tee_pad);
+        gst_object_unref(tee_pad);
+        tee_pad = nullptr;
+        teardown();
+        return false;
+    }
+
+    std::cout << "Recording to " << settings.directory << " in " << settings.segment_seconds
+              << " s segments." << std::endl;
+    return true;
+}
+
+GstPadProbeReturn Recorder::on_gate_blocked(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    return GST_PAD_PROBE_OK; // stay blocked until the probe is removed
+}
+
+// The leaky queue may have dropped the start of the oldest GOP
+GstPadProbeReturn Recorder::on_until_keyframe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+        return GST_PAD_PROBE_DROP;
+    }
+    return GST_PAD_PROBE_REMOVE;
+}
+
+void Recorder::open_gate() {
+    if (!preroll || !gate_probe) {
+        return;
+    }
+    Tracer::instance().instant("record", "gate_open");
+    GstPad *src = gst_element_get_static_pad(preroll, "src");
+    gst_pad_add_probe(src, GST_PAD_PROBE_TYPE_BUFFER, &Recorder::on_until_keyframe, nullptr, nullptr);
+    gst_pad_remove_probe(src, gate_probe);
+    gst_object_unref(src);
+    gate_probe = 0;
+    std::cout << "Recording gate opened with up to " << settings.preroll_seconds << " s of pre-roll." << std::endl;
+}
+
+void Recorder::stop() {
+    if (!bin || stopping.exchange(true)) {
+        return;
+    }
+    if (gate_probe) {
+        // Nothing was written; the blocked queue would hold back the EOS
+        teardown();
+        return;
+    }
+    Tracer::instance().instant("record", "stop_requested");
+    gst_pad_add_probe(tee_pad, GST_PAD_PROBE_TYPE_IDLE, &Recorder::on_tee_pad_idle, this, nullptr);
+}
+
+// Detach from the tee between buffers, then push EOS through the branch so
+// splitmuxsink finalises the open segment.
+GstPadProbeReturn Recorder::on_tee_pad_idle(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    auto self = static_cast<Recorder*>(user_data);
+
+    GstPad *sink_pad = gst_element_get_static_pad(self->bin, "sink");
+    gst_pad_unlink(pad, sink_pad);
+    gst_pad_send_event(sink_pad, gst_event_new_eos());
+    gst_object_unref(sink_pad);
+
+    gst_element_release_request_pad(self->tee, pad);
+    gst_object_unref(self->tee_pad);
+    self->tee_pad = nullptr;
+    return GST_PAD_PROBE_REMOVE;
+}
+
+void Recorder::stop_blocking(GstClockTime timeout) {
+    if (!bin) {
+        return;
+    }
+    restart_pending = false;
+    stop();
+
+    GstBus *bus = gst_element_get_bus(pipeline);
+    while (bin) {
+        GstMessage *message = gst_bus_timed_pop_filtered(bus, timeout,
+            (GstMessageType)(GST_MESSAGE_ELEMENT | GST_MESSAGE_ERROR));
+        if (!message) {
+            std::cerr << "Timed out finalising recording, last segment is left fragmented." << std::endl;
+            teardown();
+            break;
+        }
+        handle_message(message);
+        gst_message_unref(message);
+    }
+    gst_object_unref(bus);
+}
+
+void Recorder::teardown() {
+    if (tee_pad) {
+        gst_element_release_request_pad(tee, tee_pad);
+        gst_object_unref(tee_pad);
+        tee_pad = nullptr;
+    }
+    gst_element_set_state(bin, GST_STATE_NULL);
+    gst_bin_remove(GST_BIN(pipeline), bin);
+    bin = nullptr;
+    splitmux = nullptr;
+    queue = nullptr;
+    encoder = nullptr;
+    preroll = nullptr;
+    gate_probe = 0;
+    stopping = false;
+    std::cout << "Recording stopped." << std::endl;
+
+    if (restart_pending) {
+        restart_pending = false;
+        start();
+    }
+}
+
+GstPadProbeReturn Recorder::on_count_buffer(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    (*static_cast<std::atomic<uint64_t>*>(user_data))++;
+    return GST_PAD_PROBE_OK;
+}
+
+double Recorder::queue_fill() const {
+    if (!queue) {
+        return 0;
+    }
+    guint64 level = 0, limit = 0;
+    g_object_get(queue, "current-level-time", &level, "max-size-time", &limit, nullptr);
+    return limit ? (double)level / limit : 0;
+}
+
+void Recorder::set_bitrate(int kbps) {
+    settings.bitrate_kbps = kbps;
+    if (encoder) {
+        g_object_set(encoder, "bitrate", kbps, nullptr);
+    }
+}
+
+// x264enc only accepts preset and thread changes in READY, so the branch is
+// rebuilt once the current one has drained.
+void Recorder::reconfigure(int speed_preset, int threads) {
+    settings.speed_preset = speed_preset;
+    settings.threads = threads;
+    if (bin) {
+        restart_pending = true;
+        stop();
+    }
+}
+
+bool Recorder::handle_message(GstMessage* message) {
+    if (!bin || GST_MESSAGE_TYPE(message) != GST_MESSAGE_ELEMENT) {
+        return false;
+    }
+    const GstStructure *s = gst_message_get_structure(message);
+
+    if (GST_MESSAGE_SRC(message) == GST_OBJECT(bin) && gst_structure_has_name(s, "GstBinForwarded")) {
+        GstMessage *forwarded = nullptr;
+        gst_structure_get(s, "message", GST_TYPE_MESSAGE, &forwarded, nullptr);
+        if (forwarded && GST_MESSAGE_TYPE(forwarded) == GST_MESSAGE_EOS) {
+            teardown();
+        }
+        if (forwarded) {
+            gst_message_unref(forwarded);
+        }
+        return true;
+    }
+
+    if (GST_MESSAGE_SRC(message) == GST_OBJECT(splitmux) &&
+        gst_structure_has_name(s, "splitmuxsink-fragment-closed")) {
+        const char *location = gst_structure_get_string(s, "location");
+        std::cout << "Segment closed: " << location << std::endl;
+        log_integrity(location);
+        return true;
+    }
+    return false;
+}
+
+void Recorder::log_integrity(const char* location) {
+    if (!integrity || !location) {
+        return;
+    }
+    fs::path csv = fs::path(settings.directory) / "integrity.csv";
+    bool fresh = !fs::exists(csv);
+    std::ofstream out(csv, std::ios::app);
+    if (fresh) {
+        out << "segment,captured,sensor_drops,pipeline_drops,duplicates" << std::endl;
+    }
+
+    uint64_t captured = integrity->captured, sensor = integrity->sensor_drops;
+    uint64_t pipeline = integrity->pipeline_drops, duplicates = integrity->duplicates;
+    out << fs::path(location).filename().string() << ',' << captured - logged_captured << ','
+        << sensor - logged_sensor << ',' << pipeline - logged_pipeline << ','
+        << duplicates - logged_duplicates << std::endl;
+
+    logged_captured = captured;
+    logged_sensor = sensor;
+    logged_pipeline = pipeline;
+    logged_duplicates = duplicates;
+}
+
+// Deletes the oldest segments until the new one fits in the quota. Segment
+// names start with a timestamp, so name order is age order.
+void Recorder::enforce_quota(uint64_t incoming_bytes) {
+    std::vector<std::pair<fs::path, uint64_t>> segments;
+    uint64_t total = 0;
+    std::error_code ec;
+
+    for (const auto& entry : fs::directory_iterator(settings.directory, ec)) {
+        std::string name = entry.path().filename().string();
+        if (!entry.is_regular_file(ec) || name.rfind(segment_prefix, 0) != 0 ||
+            entry.path().extension() != segment_suffix) {
+            continue;
+        }
+        uint64_t size = entry.file_size(ec);
+        segments.emplace_back(entry.path(), size);
+        total += size;
+    }
+    std::sort(segments.begin(), segments.end());
+
+    for (const auto& segment : segments) {
+        if (total + incoming_bytes <= settings.quota_bytes) {
+            break;
+        }
+        if (fs::remove(segment.first, ec)) {
+            total -= segment.second;
+            std::cout << "Quota reached, deleted " << segment.first.filename().string() << std::endl;
+        }
+    }
+}
+
+// Called on the streaming thread each time splitmuxsink opens a new segment.
+gchar* Recorder::on_format_location(GstElement* splitmux, guint fragment_id, gpointer user_data) {
+    auto self = static_cast<Recorder*>(user_data);
+    TraceSpan span("record", "segment_open");
+
+    uint64_t expected = (uint64_t)self->settings.bitrate_kbps * 1000 / 8 * self->settings.segment_seconds;
+    self->enforce_quota(expected);
+
+    // fragment_id starts over whenever splitmuxsink goes through READY, and
+    // a session stamp can repeat within the same second
+    gchar *location = g_strdup_printf("%s/%s%s_%05u%s", self->settings.directory.c_str(), segment_prefix,
+                                      self->session.c_str(), self->next_segment++, segment_suffix);
+    std::cout << "Recording segment " << location << std::endl;
+    return location;
+}
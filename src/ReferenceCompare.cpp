@@ -0,0 +1,255 @@
+#include "ReferenceCompare.h"
+#include "CompareKernels.h"
+#include "MotionDetector.h"
+#include "ThreadPolicy.h"
+#include "Tracer.h"
+
+#include <gst/video/video.h>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+const int score_downsample = 8;
+const int difference_gain_shift = 2; // differences x4, so small ones show
+
+} // namespace
+
+ReferenceCompare::ReferenceCompare(FrameMailbox& mailbox) : mailbox(mailbox) {
+    thread = std::thread(&ReferenceCompare::run, this);
+}
+
+ReferenceCompare::~ReferenceCompare() {
+    running = false;
+    thread.join();
+}
+
+bool ReferenceCompare::load(const std::string& path) {
+    cv::Mat bgr = cv::imread(path, cv::IMREAD_COLOR);
+    if (bgr.empty()) {
+        std::cerr << "Cannot read reference image " << path << std::endl;
+        return false;
+    }
+    auto rgb = std::make_shared<cv::Mat>();
+    cv::cvtColor(bgr, *rgb, cv::COLOR_BGR2RGB);
+    std::cout << "Reference " << path << " (" << rgb->cols << "x" << rgb->rows << ")" << std::endl;
+    std::lock_guard<std::mutex> lock(reference_mutex);
+    reference = rgb;
+    ++reference_id;
+    ++generation;
+    return true;
+}
+
+bool ReferenceCompare::loaded() const {
+    std::lock_guard<std::mutex> lock(reference_mutex);
+    return reference != nullptr;
+}
+
+const char* ReferenceCompare::name(CompareMode mode) {
+    switch (mode) {
+    case CompareMode::Split: return "split";
+    case CompareMode::Difference: return "difference";
+    default: return "off";
+    }
+}
+
+void ReferenceCompare::set_view(const ViewCrop& view) {
+    std::lock_guard<std::mutex> lock(reference_mutex);
+    this->view = view;
+    ++generation;
+}
+
+bool ReferenceCompare::apply(uint8_t* bgrx, int stride, int width, int height) {
+    CompareMode mode = mode_;
+    if (mode == CompareMode::Off) {
+        return false;
+    }
+    uint64_t current;
+    {
+        std::lock_guard<std::mutex> lock(reference_mutex);
+        current = generation;
+    }
+    std::shared_ptr<const cv::Mat> image;
+    {
+        std::lock_guard<std::mutex> lock(display_mutex);
+        wanted_width = width;
+        wanted_height = height;
+        if (ready && ready_generation == current && ready_width == width && ready_height == height) {
+            image = ready;
+        }
+    }
+    if (!image) {
+        return false; // being prepared on the worker
+    }
+    TraceSpan span("display", "reference_compare");
+    if (mode == CompareMode::Split) {
+        int half = width / 2;
+        for (int row = 0; row < height; ++row) {
+            std::memcpy(bgrx + (size_t)row * stride + (size_t)half * 4, image->ptr(row) + (size_t)half * 4,
+                        (size_t)(width - half) * 4);
+        }
+    } else {
+        for (int row = 0; row < height; ++row) {
+            diff_bgrx_row(bgrx + (size_t)row * stride, image->ptr(row), width, difference_gain_shift);
+        }
+    }
+    return true;
+}
+
+void ReferenceCompare::run() {
+    ThreadPolicy::instance().adopt_current("compare");
+    uint64_t sequence = 0;
+    while (running) {
+        if (mode_ == CompareMode::Off || !loaded()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            continue;
+        }
+        prepare_display();
+        GstSample *sample = mailbox.take(&sequence);
+        if (!sample) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            continue;
+        }
+        score(sample);
+        gst_sample_unref(sample);
+    }
+}
+
+// PSNR and SSIM of this frame's 1/8-scale luma against the reference's
+void ReferenceCompare::score(GstSample* sample) {
+    TraceSpan span("compare", "reference_score");
+    GstVideoInfo info;
+    LumaLayout layout;
+    if (!gst_video_info_from_caps(&info, gst_sample_get_caps(sample)) || !find_luma_layout(&info, &layout)) {
+        if (!warned_format) {
+            std::cerr << "Reference scoring needs raw video frames." << std::endl;
+            warned_format = true;
+        }
+        return;
+    }
+    int width = GST_VIDEO_INFO_WIDTH(&info), height = GST_VIDEO_INFO_HEIGHT(&info);
+    capture_width = width;
+    capture_height = height;
+
+    std::shared_ptr<const cv::Mat> image;
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(reference_mutex);
+        image = reference;
+        id = reference_id;
+    }
+    // YUV from cameras is normally limited range (16-235), the reference's
+    // gray is full range; left as is, identical scenes would score a bias
+    bool limited = layout != LumaLayout::Packed4 &&
+                   GST_VIDEO_INFO_COLORIMETRY(&info).range == GST_VIDEO_COLOR_RANGE_16_235;
+    int cells_width = width / score_downsample, cells_height = height / score_downsample;
+    if (id != luma_reference || width != luma_width || height != luma_height || layout != luma_layout ||
+        limited != luma_limited) {
+        // The reference as the live frame would have delivered it: capture
+        // size, the same "luma" (green for RGB formats) and range, same
+        // downsampling
+        cv::Mat sized, gray;
+        cv::resize(*image, sized, cv::Size(width, height), 0, 0, cv::INTER_AREA);
+        if (layout == LumaLayout::Packed4) {
+            cv::extractChannel(sized, gray, 1);
+        } else {
+            cv::cvtColor(sized, gray, cv::COLOR_RGB2GRAY);
+        }
+        if (limited) {
+            gray.convertTo(gray, CV_8U, 219.0 / 255.0, 16); // 16 + Y * 219 / 255
+        }
+        reference_luma.resize((size_t)cells_width * cells_height);
+        downsample_luma(gray.data, (int)gray.step, width, height, LumaLayout::Planar, score_downsample,
+                        reference_luma.data());
+        live_luma.resize(reference_luma.size());
+        luma_reference = id;
+        luma_width = width;
+        luma_height = height;
+        luma_layout = layout;
+        luma_limited = limited;
+    }
+
+    GstVideoFrame frame;
+    if (!gst_video_frame_map(&frame, &info, gst_sample_get_buffer(sample), GST_MAP_READ)) {
+        return;
+    }
+    downsample_luma(static_cast<const uint8_t*>(GST_VIDEO_FRAME_PLANE_DATA(&frame, 0)),
+                    GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 0), width, height, layout, score_downsample,
+                    live_luma.data());
+    gst_video_frame_unmap(&frame);
+
+    uint64_t ssd = sum_squared_diff(live_luma.data(), reference_luma.data(), live_luma.size());
+    psnr_db.store(psnr_from_ssd(ssd, live_luma.size()), std::memory_order_relaxed);
+    ssim_value.store(mean_ssim(live_luma.data(), reference_luma.data(), cells_width, cells_height),
+                     std::memory_order_relaxed);
+    ++scored_frames;
+}
+
+// Reference cropped like the live view and scaled to the displayed size,
+// as BGRx; from the cache when this size and zoom were shown before.
+void ReferenceCompare::prepare_display() {
+    int width, height, have_width, have_height;
+    uint64_t have_generation;
+    {
+        std::lock_guard<std::mutex> lock(display_mutex);
+        width = wanted_width;
+        height = wanted_height;
+        have_width = ready ? ready_width : 0;
+        have_height = ready ? ready_height : 0;
+        have_generation = ready_generation;
+    }
+    if (width <= 0 || height <= 0 || capture_width <= 0) {
+        return; // nothing displayed yet, or no frame to map the zoom crop with
+    }
+    std::shared_ptr<const cv::Mat> image;
+    uint64_t id, current;
+    ViewCrop crop;
+    {
+        std::lock_guard<std::mutex> lock(reference_mutex);
+        image = reference;
+        id = reference_id;
+        current = generation;
+        crop = view;
+    }
+    if (width == have_width && height == have_height && current == have_generation) {
+        return;
+    }
+    if (id != cache_reference) {
+        display_cache.clear();
+        cache_reference = id;
+    }
+
+    std::string key = std::to_string(width) + "x" + std::to_string(height) + " of " + std::to_string(capture_width) +
+                      "x" + std::to_string(capture_height) + " crop " + std::to_string(crop.left) + "," +
+                      std::to_string(crop.top) + "," + std::to_string(crop.right) + "," + std::to_string(crop.bottom);
+    std::shared_ptr<const cv::Mat> converted;
+    if (auto *hit = display_cache.get(key)) {
+        converted = *hit;
+    } else {
+        TraceSpan span("compare", "reference_convert");
+        // Crop in capture pixels, mapped onto the reference
+        double sx = (double)image->cols / capture_width, sy = (double)image->rows / capture_height;
+        int x0 = std::min((int)(crop.left * sx), image->cols - 1);
+        int y0 = std::min((int)(crop.top * sy), image->rows - 1);
+        int x1 = std::max((int)(image->cols - crop.right * sx), x0 + 1);
+        int y1 = std::max((int)(image->rows - crop.bottom * sy), y0 + 1);
+        cv::Mat sized;
+        auto result = std::make_shared<cv::Mat>();
+        cv::resize((*image)(cv::Rect(x0, y0, x1 - x0, y1 - y0)), sized, cv::Size(width, height), 0, 0,
+                   cv::INTER_AREA);
+        cv::cvtColor(sized, *result, cv::COLOR_RGB2BGRA); // opaque alpha
+        converted = result;
+        display_cache.put(key, converted, result->total() * result->elemSize());
+    }
+
+    std::lock_guard<std::mutex> lock(display_mutex);
+    ready = converted;
+    ready_width = width;
+    ready_height = height;
+    ready_generation = current;
+}
@@ -0,0 +1,46 @@
+#include "ResourceUsage.h"
+#include "StartupProfiler.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <sys/resource.h>
+
+ResourceUsage ResourceUsage::sample() {
+    ResourceUsage usage;
+    usage.wall_s = StartupProfiler::instance().elapsed_ms() / 1000.0;
+
+    rusage self;
+    if (getrusage(RUSAGE_SELF, &self) == 0) {
+        usage.cpu_s = self.ru_utime.tv_sec + self.ru_utime.tv_usec / 1e6 +
+                      self.ru_stime.tv_sec + self.ru_stime.tv_usec / 1e6;
+        usage.peak_rss_kb = self.ru_maxrss;
+    }
+
+    FILE *status = fopen("/proc/self/status", "r");
+    if (status) {
+        char line[256];
+        while (fgets(line, sizeof(line), status)) {
+            if (strncmp(line, "VmRSS:", 6) == 0) {
+                usage.rss_kb = strtol(line + 6, nullptr, 10);
+            } else if (strncmp(line, "Threads:", 8) == 0) {
+                usage.threads = (int)strtol(line + 8, nullptr, 10);
+            }
+        }
+        fclose(status);
+    }
+    return usage;
+}
+
+std::string ResourceUsage::summary() const {
+    char text[192];
+    snprintf(text, sizeof(text), "wall %.1f s, CPU %.1f s (%.1f%% of one core), RSS %.1f MB (peak %.1f MB), %d threads",
+             wall_s, cpu_s, wall_s > 0 ? 100.0 * cpu_s / wall_s : 0.0,
+             rss_kb / 1024.0, peak_rss_kb / 1024.0, threads);
+    return text;
+}
+
+void print_resource_usage(const std::string& label) {
+    std::cout << "Resource usage (" << label << "): " << ResourceUsage::sample().summary() << std::endl;
+}
@@ -0,0 +1,140 @@
+#include "ScopeKernels.h"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+void ScopeHistogram::clear() {
+    std::memset(this, 0, sizeof(*this));
+}
+
+void ScopeHistogram::add(const ScopeHistogram& other) {
+    for (int i = 0; i < 256; ++i) {
+        red[i] += other.red[i];
+        green[i] += other.green[i];
+        blue[i] += other.blue[i];
+        luma[i] += other.luma[i];
+    }
+}
+
+void accumulate_scope(const uint8_t* bgrx, int stride, int width, int first_row, int last_row,
+                      ScopeHistogram& histogram, uint32_t* waveform) {
+    static thread_local ScopeHistogram lanes[4];
+    for (auto& lane : lanes) {
+        lane.clear();
+    }
+    // Column to waveform bin in 16.16 fixed point
+    uint32_t column_scale = width > 0 ? (uint32_t)(((uint64_t)scope_waveform_width << 16) / width) : 0;
+    const int level_shift = 8 - 6; // 256 luma values onto 64 levels
+    static_assert(scope_waveform_levels == 64, "level_shift assumes 64 levels");
+
+    for (int row = first_row + (first_row & 1); row < last_row; row += 2) {
+        const uint8_t *p = bgrx + (size_t)row * stride;
+        int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            for (int lane = 0; lane < 4; ++lane) {
+                const uint8_t *px = p + (size_t)(x + 2 * lane) * 4;
+                uint8_t y = scope_luma(px[2], px[1], px[0]);
+                ScopeHistogram& h = lanes[lane];
+                ++h.blue[px[0]];
+                ++h.green[px[1]];
+                ++h.red[px[2]];
+                ++h.luma[y];
+                if (waveform) {
+                    ++waveform[(y >> level_shift) * scope_waveform_width + (((x + 2 * lane) * column_scale) >> 16)];
+                }
+            }
+        }
+        for (; x < width; x += 2) {
+            const uint8_t *px = p + (size_t)x * 4;
+            uint8_t y = scope_luma(px[2], px[1], px[0]);
+            ++lanes[0].blue[px[0]];
+            ++lanes[0].green[px[1]];
+            ++lanes[0].red[px[2]];
+            ++lanes[0].luma[y];
+            if (waveform) {
+                ++waveform[(y >> level_shift) * scope_waveform_width + ((x * column_scale) >> 16)];
+            }
+        }
+    }
+    for (const auto& lane : lanes) {
+        histogram.add(lane);
+    }
+}
+
+namespace {
+
+inline bool stripe(int x, int offset) {
+    return ((x + offset) >> 3) & 1;
+}
+
+inline void zebra_pixel(uint8_t* px, int x, int offset, uint8_t level) {
+    uint8_t m = px[0] > px[1] ? px[0] : px[1];
+    m = m > px[2] ? m : px[2];
+    if (m >= level && stripe(x, offset)) {
+        px[0] = px[1] = px[2] = 0;
+    }
+}
+
+} // namespace
+
+void apply_zebra(uint8_t* bgrx, int stride, int width, int first_row, int last_row, uint8_t level, int phase) {
+    for (int row = first_row; row < last_row; ++row) {
+        uint8_t *p = bgrx + (size_t)row * stride;
+        // Stripes run diagonally: the offset grows by one per row
+        int offset = row + phase;
+        int x = 0;
+#if defined(__SSE2__)
+        // 4 pixels per 16 bytes; each 32-bit lane is one pixel
+        const __m128i low_byte = _mm_set1_epi32(0xFF);
+        const __m128i threshold = _mm_set1_epi32(level - 1);
+        const __m128i colour = _mm_set1_epi32(0x00FFFFFF);
+        const __m128i one = _mm_set1_epi32(1);
+        __m128i columns = _mm_add_epi32(_mm_set_epi32(3, 2, 1, 0), _mm_set1_epi32(offset));
+        for (; x + 4 <= width; x += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + (size_t)x * 4));
+            __m128i m = _mm_max_epu8(v, _mm_srli_epi32(v, 8));
+            m = _mm_and_si128(_mm_max_epu8(m, _mm_srli_epi32(v, 16)), low_byte);
+            __m128i clipped = _mm_cmpgt_epi32(m, threshold);
+            __m128i striped = _mm_cmpeq_epi32(_mm_and_si128(_mm_srli_epi32(columns, 3), one), one);
+            __m128i clear = _mm_and_si128(_mm_and_si128(clipped, striped), colour);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(p + (size_t)x * 4), _mm_andnot_si128(clear, v));
+            columns = _mm_add_epi32(columns, _mm_set1_epi32(4));
+        }
+#elif defined(__ARM_NEON)
+        // 8 pixels per iteration, channels deinterleaved
+        uint8x8_t limit = vdup_n_u8(level);
+        for (; x + 8 <= width; x += 8) {
+            uint8x8x4_t v = vld4_u8(p + (size_t)x * 4);
+            uint8x8_t m = vmax_u8(vmax_u8(v.val[0], v.val[1]), v.val[2]);
+            uint8_t stripes[8];
+            for (int i = 0; i < 8; ++i) {
+                stripes[i] = stripe(x + i, offset) ? 0xFF : 0;
+            }
+            uint8x8_t clear = vand_u8(vcge_u8(m, limit), vld1_u8(stripes));
+            v.val[0] = vbic_u8(v.val[0], clear);
+            v.val[1] = vbic_u8(v.val[1], clear);
+            v.val[2] = vbic_u8(v.val[2], clear);
+            vst4_u8(p + (size_t)x * 4, v);
+        }
+#endif
+        for (; x < width; ++x) {
+            zebra_pixel(p + (size_t)x * 4, x, offset, level);
+        }
+    }
+}
+
+void apply_false_colour(uint8_t* bgrx, int stride, int width, int first_row, int last_row,
+                        const uint32_t* palette) {
+    for (int row = first_row; row < last_row; ++row) {
+        uint8_t *p = bgrx + (size_t)row * stride;
+        uint32_t *out = reinterpret_cast<uint32_t*>(p);
+        for (int x = 0; x < width; ++x, p += 4) {
+            out[x] = palette[scope_luma(p[2], p[1], p[0])];
+        }
+    }
+}
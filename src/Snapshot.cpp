@@ -0,0 +1,68 @@
+#include "Snapshot.h"
+#include "Tracer.h"
+
+#include <gst/video/video.h>
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+
+std::string capture_path(const std::string& directory, const char* prefix) {
+    auto now = std::chrono::system_clock::now();
+    std::time_t seconds = std::chrono::system_clock::to_time_t(now);
+    int millis = (int)(std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000);
+    std::tm local;
+    localtime_r(&seconds, &local);
+    char name[64];
+    snprintf(name, sizeof(name), "%s_%04d%02d%02d_%02d%02d%02d_%03d.jpg", prefix,
+             local.tm_year + 1900, local.tm_mon + 1, local.tm_mday,
+             local.tm_hour, local.tm_min, local.tm_sec, millis);
+    return directory + "/" + name;
+}
+
+namespace {
+
+bool write_buffer(GstBuffer* buffer, const std::string& path) {
+    GstMapInfo map;
+    if (!gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+        return false;
+    }
+    FILE *file = fopen(path.c_str(), "wb");
+    bool ok = file && fwrite(map.data, 1, map.size, file) == map.size;
+    if (file) {
+        ok = (fclose(file) == 0) && ok;
+    }
+    gst_buffer_unmap(buffer, &map);
+    return ok;
+}
+
+} // namespace
+
+std::string save_snapshot(GstSample* sample, const std::string& directory) {
+    TraceSpan span("snapshot", "snapshot_encode");
+    GstCaps *caps = gst_sample_get_caps(sample);
+    GstBuffer *buffer = gst_sample_get_buffer(sample);
+    if (!caps || !buffer) {
+        return "";
+    }
+    std::string path = capture_path(directory, "mivo");
+
+    GstStructure *structure = gst_caps_get_structure(caps, 0);
+    if (gst_structure_has_name(structure, "image/jpeg")) {
+        return write_buffer(buffer, path) ? path : "";
+    }
+
+    GstCaps *jpeg = gst_caps_new_empty_simple("image/jpeg");
+    GError *error = nullptr;
+    GstSample *encoded = gst_video_convert_sample(sample, jpeg, 5 * GST_SECOND, &error);
+    gst_caps_unref(jpeg);
+    if (!encoded) {
+        std::cerr << "Snapshot encode failed: " << (error ? error->message : "unknown") << std::endl;
+        g_clear_error(&error);
+        return "";
+    }
+    bool ok = write_buffer(gst_sample_get_buffer(encoded), path);
+    gst_sample_unref(encoded);
+    return ok ? path : "";
+}
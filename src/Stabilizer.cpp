@@ -0,0 +1,179 @@
+#include "Stabilizer.h"
+#include "MotionDetector.h"
+#include "ThreadPolicy.h"
+#include "Tracer.h"
+
+#include <gst/video/video.h>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+Stabilizer::Stabilizer(FrameMailbox& mailbox, GstElement* crop, const StabilizerSettings& settings)
+    : mailbox(mailbox), crop(GST_ELEMENT(gst_object_ref(crop))), settings(settings) {
+    thread = std::thread(&Stabilizer::run, this);
+}
+
+Stabilizer::~Stabilizer() {
+    running = false;
+    thread.join();
+    gst_object_unref(crop);
+    if (analysed) {
+        std::cout << "Stabilization: " << analysed << " frames analysed, " << std::fixed << std::setprecision(2)
+                  << total_analyse_ms / analysed << " ms mean, " << max_analyse_ms << " ms max" << std::endl;
+    }
+}
+
+void Stabilizer::set_view(const ViewCrop& view) {
+    std::lock_guard<std::mutex> lock(view_mutex);
+    this->view = view;
+    view_changed = true;
+}
+
+void Stabilizer::set_enabled(bool enabled) {
+    active = enabled;
+    std::lock_guard<std::mutex> lock(view_mutex);
+    view_changed = true; // back to the centred crop, path restarted
+    std::cout << "Stabilization " << (enabled ? "on" : "off") << std::endl;
+}
+
+void Stabilizer::run() {
+    ThreadPolicy::instance().adopt_current("stabilize");
+    uint64_t sequence = 0;
+    uint64_t brackets = 0;
+
+    while (running) {
+        bool restart;
+        {
+            std::lock_guard<std::mutex> lock(view_mutex);
+            restart = view_changed;
+            view_changed = false;
+        }
+        if (restart) {
+            raw_x = raw_y = smooth_x = smooth_y = 0;
+            previous.clear();
+            apply(0, 0);
+        }
+
+        // Blocks until the next frame; the timeout only bounds shutdown
+        GstSample *sample = mailbox.wait(&sequence, 100);
+        if (!sample) {
+            continue;
+        }
+        if (mailbox.disturbed(&brackets)) {
+            // Exposure steps confuse the phase correlation; hold the crop and
+            // measure afresh from the first steady frame
+            previous.clear();
+            gst_sample_unref(sample);
+            continue;
+        }
+        if (!active) {
+            gst_sample_unref(sample);
+            continue;
+        }
+        double dx = 0, dy = 0;
+        bool measured = measure(sample, &dx, &dy);
+        gst_sample_unref(sample);
+        if (!measured) {
+            continue;
+        }
+
+        ViewCrop current;
+        {
+            std::lock_guard<std::mutex> lock(view_mutex);
+            current = view;
+        }
+        // Content moved by (dx, dy): the crop follows the shake, the smoothed
+        // path follows the intended motion
+        raw_x += dx;
+        raw_y += dy;
+        smooth_x = settings.smoothing * smooth_x + (1 - settings.smoothing) * raw_x;
+        smooth_y = settings.smoothing * smooth_y + (1 - settings.smoothing) * raw_y;
+
+        // Past the margin the view can't follow; drag the smoothed path along
+        // so it doesn't sit against the edge
+        double min_x = -current.left, max_x = current.right;
+        double min_y = -current.top, max_y = current.bottom;
+        smooth_x = std::min(std::max(smooth_x, raw_x - max_x), raw_x - min_x);
+        smooth_y = std::min(std::max(smooth_y, raw_y - max_y), raw_y - min_y);
+        apply((int)std::lround(raw_x - smooth_x), (int)std::lround(raw_y - smooth_y));
+    }
+}
+
+// Shift of this frame against the previous analysed one, in full-size pixels
+bool Stabilizer::measure(GstSample* sample, double* dx, double* dy) {
+    TraceSpan span("stabilize", "stabilize_measure");
+    auto begin = std::chrono::steady_clock::now();
+
+    GstVideoInfo info;
+    LumaLayout layout;
+    if (!gst_video_info_from_caps(&info, gst_sample_get_caps(sample)) || !find_luma_layout(&info, &layout)) {
+        if (!warned_format) {
+            std::cerr << "Stabilization needs raw video frames." << std::endl;
+            warned_format = true;
+        }
+        return false;
+    }
+    GstVideoFrame frame;
+    if (!gst_video_frame_map(&frame, &info, gst_sample_get_buffer(sample), GST_MAP_READ)) {
+        return false;
+    }
+    int factor = settings.downsample;
+    int width = GST_VIDEO_INFO_WIDTH(&info) / factor, height = GST_VIDEO_INFO_HEIGHT(&info) / factor;
+    if (width != cells_width || height != cells_height) {
+        cells_width = width;
+        cells_height = height;
+        luma.resize((size_t)width * height);
+        window.resize(luma.size());
+        cv::Mat hann(height, width, CV_32F, window.data());
+        cv::createHanningWindow(hann, hann.size(), CV_32F);
+        previous.clear();
+    }
+    downsample_luma(static_cast<const uint8_t*>(GST_VIDEO_FRAME_PLANE_DATA(&frame, 0)),
+                    GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 0), GST_VIDEO_INFO_WIDTH(&info), GST_VIDEO_INFO_HEIGHT(&info),
+                    layout, factor, luma.data());
+    gst_video_frame_unmap(&frame);
+
+    std::vector<float> current(luma.begin(), luma.end());
+    bool have_previous = !previous.empty();
+    if (have_previous) {
+        cv::Mat a(height, width, CV_32F, previous.data());
+        cv::Mat b(height, width, CV_32F, current.data());
+        cv::Mat hann(height, width, CV_32F, window.data());
+        double response = 0;
+        cv::Point2d shift = cv::phaseCorrelate(a, b, hann, &response);
+        // A weak peak means no reliable match (blur, blank field): hold still
+        if (response >= settings.min_response) {
+            *dx = shift.x * factor;
+            *dy = shift.y * factor;
+        }
+    }
+    previous.swap(current);
+    double took = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    last_analyse_ms.store(took, std::memory_order_relaxed);
+    analysed++;
+    total_analyse_ms += took;
+    max_analyse_ms = std::max(max_analyse_ms, took);
+    return have_previous;
+}
+
+// Moves the crop window by the offset, keeping its size, so videocrop's
+// output caps stay the same and nothing downstream renegotiates.
+void Stabilizer::apply(int offset_x, int offset_y) {
+    offset_x &= ~1; // 4:2:2 chroma pairs
+    if (offset_x == applied_x && offset_y == applied_y) {
+        return;
+    }
+    applied_x = offset_x;
+    applied_y = offset_y;
+    ViewCrop current;
+    {
+        std::lock_guard<std::mutex> lock(view_mutex);
+        current = view;
+    }
+    g_object_set(crop, "left", current.left + offset_x, "right", current.right - offset_x,
+                 "top", current.top + offset_y, "bottom", current.bottom - offset_y, nullptr);
+}
@@ -0,0 +1,67 @@
+#include "StartupProfiler.h"
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+StartupProfiler& StartupProfiler::instance() {
+    static StartupProfiler profiler;
+    return profiler;
+}
+
+StartupProfiler::StartupProfiler() : origin(Clock::now()) {}
+
+StartupProfiler::Phase::Phase(const std::string& name) : name(name), begin(Clock::now()) {}
+
+StartupProfiler::Phase::~Phase() {
+    StartupProfiler::instance().record(name, begin, Clock::now());
+}
+
+void StartupProfiler::record(const std::string& name, Clock::time_point begin, Clock::time_point end) {
+    std::ostringstream thread;
+    thread << std::this_thread::get_id();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.push_back({name,
+                       std::chrono::duration<double, std::milli>(begin - origin).count(),
+                       std::chrono::duration<double, std::milli>(end - begin).count(),
+                       thread.str()});
+}
+
+void StartupProfiler::mark_first_frame() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (first_frame_ms < 0) {
+        first_frame_ms = elapsed_ms();
+    }
+}
+
+double StartupProfiler::elapsed_ms() const {
+    return std::chrono::duration<double, std::milli>(Clock::now() - origin).count();
+}
+
+// Prints the phase table once, after the first frame has been seen.
+void StartupProfiler::report() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (reported) {
+        return;
+    }
+    reported = true;
+
+    std::cout << "Startup phases (ms since launch):" << std::endl;
+    for (const auto& e : entries) {
+        std::cout << "  " << std::left << std::setw(24) << e.name
+                  << std::right << std::fixed << std::setprecision(1)
+                  << " start " << std::setw(8) << e.start_ms
+                  << "  took " << std::setw(8) << e.duration_ms
+                  << "  [thread " << e.thread << "]" << std::endl;
+    }
+
+    if (first_frame_ms < 0) {
+        std::cout << "First frame: not yet received" << std::endl;
+        return;
+    }
+    std::cout << "First frame after " << std::fixed << std::setprecision(1) << first_frame_ms << " ms"
+              << (first_frame_ms <= first_frame_target_ms ? " (within " : " (over ")
+              << first_frame_target_ms << " ms target)" << std::endl;
+}
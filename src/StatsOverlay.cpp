@@ -0,0 +1,132 @@
+#include "StatsOverlay.h"
+
+#include <iomanip>
+#include <sstream>
+
+StatsOverlay::~StatsOverlay() {
+    if (cached) {
+        gst_video_overlay_composition_unref(cached);
+    }
+}
+
+std::vector<std::string> StatsOverlay::format(const Values& values) const {
+    std::vector<std::string> out;
+    std::ostringstream line;
+
+    line << std::fixed << std::setprecision(1) << "FPS      " << values.fps;
+    out.push_back(line.str());
+    line.str("");
+    line << std::fixed << std::setprecision(0) << "Latency  " << values.latency_ms << " ms";
+    out.push_back(line.str());
+    line.str("");
+    line << "Dropped  " << values.dropped << " late";
+    out.push_back(line.str());
+    line.str("");
+    line << "Lost     " << values.sensor_drops << " cam / " << values.pipeline_drops << " pipe";
+    out.push_back(line.str());
+    line.str("");
+    line << "Zoom     " << values.zoom_level;
+    out.push_back(line.str());
+    line.str("");
+    line << "AWB      " << (values.awb_enabled ? "auto" : "manual");
+    out.push_back(line.str());
+    line.str("");
+    line << "Temp     ";
+    if (values.temperature_k < 0) {
+        line << "--";
+    } else {
+        line << static_cast<int>(values.temperature_k) << " K";
+    }
+    out.push_back(line.str());
+    line.str("");
+    line << "Mode     " << values.display_mode;
+    out.push_back(line.str());
+    if (!values.scope.empty()) {
+        line.str("");
+        line << "Scope    " << values.scope;
+        out.push_back(line.str());
+    }
+    if (!values.compare.empty()) {
+        line.str("");
+        line << "A/B      " << values.compare;
+        out.push_back(line.str());
+    }
+    return out;
+}
+
+// Values are compared in their displayed form, so jitter below the shown
+// precision does not cause a redraw.
+void StatsOverlay::update(const Values& values) {
+    auto next = format(values);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (next != lines) {
+        lines = std::move(next);
+        dirty = true;
+    }
+}
+
+void StatsOverlay::render() {
+    int height = line_height * static_cast<int>(lines.size()) + 10;
+    if (!surface || surface->get_height() != height) {
+        surface = Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, width, height);
+    }
+
+    auto cr = Cairo::Context::create(surface);
+    cr->set_operator(Cairo::OPERATOR_SOURCE);
+    cr->set_source_rgba(0.0, 0.0, 0.0, 0.55);
+    cr->paint();
+    cr->set_operator(Cairo::OPERATOR_OVER);
+
+    cr->select_font_face("monospace", Cairo::FONT_SLANT_NORMAL, Cairo::FONT_WEIGHT_BOLD);
+    cr->set_font_size(14);
+    cr->set_source_rgb(1.0, 1.0, 1.0);
+    for (size_t i = 0; i < lines.size(); ++i) {
+        cr->move_to(8, line_height * (i + 1));
+        cr->show_text(lines[i]);
+    }
+    surface->flush();
+    dirty = false;
+    if (cached) {
+        gst_video_overlay_composition_unref(cached);
+        cached = nullptr;
+    }
+}
+
+void StatsOverlay::draw(cairo_t* cr) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (lines.empty()) {
+        return;
+    }
+    if (dirty) {
+        render();
+    }
+    cairo_set_source_surface(cr, surface->cobj(), 10, 10);
+    cairo_paint(cr);
+}
+
+// Cairo's ARGB32 is premultiplied, native-endian ARGB, which is the overlay
+// rectangle's native format, so this is a plain copy.
+GstVideoOverlayComposition* StatsOverlay::composition() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (lines.empty()) {
+        return nullptr;
+    }
+    if (dirty) {
+        render();
+    }
+    if (!cached) {
+        int height = surface->get_height(), stride = surface->get_stride();
+        GstBuffer *pixels = gst_buffer_new_allocate(nullptr, (gsize)stride * height, nullptr);
+        gst_buffer_fill(pixels, 0, surface->get_data(), (gsize)stride * height);
+        gsize offsets[GST_VIDEO_MAX_PLANES] = {0};
+        gint strides[GST_VIDEO_MAX_PLANES] = {stride};
+        gst_buffer_add_video_meta_full(pixels, GST_VIDEO_FRAME_FLAG_NONE, GST_VIDEO_OVERLAY_COMPOSITION_FORMAT_RGB,
+                                       width, height, 1, offsets, strides);
+        GstVideoOverlayRectangle *rectangle = gst_video_overlay_rectangle_new_raw(
+            pixels, 10, 10, width, height, GST_VIDEO_OVERLAY_FORMAT_FLAG_PREMULTIPLIED_ALPHA);
+        gst_buffer_unref(pixels);
+        cached = gst_video_overlay_composition_new(rectangle);
+        gst_video_overlay_rectangle_unref(rectangle);
+    }
+    return gst_video_overlay_composition_ref(cached);
+}
@@ -0,0 +1,190 @@
+#include "ThreadPolicy.h"
+
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+ThreadPolicy& ThreadPolicy::instance() {
+    static ThreadPolicy policy;
+    return policy;
+}
+
+// Both specs are comma-separated role=value lists.
+void ThreadPolicy::configure(const std::string& cpus, const std::string& priorities) {
+    std::lock_guard<std::mutex> lock(mutex);
+    CPU_ZERO(&default_cpus);
+    sched_getaffinity(0, sizeof(default_cpus), &default_cpus);
+    default_nice = getpriority(PRIO_PROCESS, 0);
+    std::stringstream cpu_list(cpus);
+    std::string item;
+    while (std::getline(cpu_list, item, ',')) {
+        size_t eq = item.find('=');
+        if (eq != std::string::npos) {
+            rules[item.substr(0, eq)].cpu = std::atoi(item.c_str() + eq + 1);
+        }
+    }
+
+    std::stringstream prio_list(priorities);
+    while (std::getline(prio_list, item, ',')) {
+        size_t eq = item.find('=');
+        size_t colon = item.find(':', eq);
+        if (eq == std::string::npos || colon == std::string::npos) {
+            continue;
+        }
+        Rule& rule = rules[item.substr(0, eq)];
+        std::string kind = item.substr(eq + 1, colon - eq - 1);
+        rule.value = std::atoi(item.c_str() + colon + 1);
+        if (kind == "fifo") {
+            rule.kind = Rule::Kind::Fifo;
+        } else if (kind == "nice") {
+            rule.kind = Rule::Kind::Nice;
+        } else {
+            std::cerr << "Unknown scheduling '" << kind << "' for " << item.substr(0, eq) << std::endl;
+        }
+    }
+}
+
+void ThreadPolicy::adopt_current(const std::string& role) {
+    int tid = static_cast<int>(syscall(SYS_gettid));
+    if (tid != getpid()) {
+        std::string name = ("mivo-" + role).substr(0, 15);
+        pthread_setname_np(pthread_self(), name.c_str());
+    }
+    apply(role, tid);
+}
+
+bool ThreadPolicy::adopt_by_name(const std::string& role, const std::string& comm) {
+    DIR *dir = opendir("/proc/self/task");
+    if (!dir) {
+        return false;
+    }
+    bool found = false;
+    while (struct dirent *entry = readdir(dir)) {
+        int tid = std::atoi(entry->d_name);
+        if (tid <= 0) {
+            continue;
+        }
+        std::ifstream in("/proc/self/task/" + std::string(entry->d_name) + "/comm");
+        std::string name;
+        std::getline(in, name);
+        if (name.compare(0, comm.size(), comm) == 0) {
+            apply(role, tid);
+            found = true;
+        }
+    }
+    closedir(dir);
+    return found;
+}
+
+void ThreadPolicy::apply(const std::string& role, int tid) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Tracked& tracked = threads[tid];
+    tracked.role = role;
+    tracked.last_ticks = cpu_ticks(tid);
+
+    if (rules.empty()) {
+        return; // nothing was changed, so nothing can have been inherited
+    }
+    auto it = rules.find(role);
+    const Rule rule = it != rules.end() ? it->second : Rule();
+
+    // Without a CPU of its own the thread gets the process's set back, rather
+    // than whatever its creator was pinned to
+    if (rule.cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(rule.cpu, &set);
+        if (sched_setaffinity(tid, sizeof(set), &set) != 0) {
+            std::cerr << "Cannot pin " << role << " thread to CPU " << rule.cpu << ": " << strerror(errno) << std::endl;
+        }
+    } else {
+        sched_setaffinity(tid, sizeof(default_cpus), &default_cpus);
+    }
+
+    int result = 0;
+    struct sched_param param = {};
+    if (rule.kind == Rule::Kind::Fifo) {
+        param.sched_priority = rule.value;
+        result = sched_setscheduler(tid, SCHED_FIFO | SCHED_RESET_ON_FORK, &param);
+    } else if (rule.kind == Rule::Kind::Nice) {
+        result = sched_setscheduler(tid, SCHED_OTHER | SCHED_RESET_ON_FORK, &param);
+        if (result == 0) {
+            result = setpriority(PRIO_PROCESS, tid, rule.value);
+        }
+    } else {
+        // Back to the defaults; going down from an inherited priority needs
+        // no privilege, and an inherited nice the thread can't undo stays
+        sched_setscheduler(tid, SCHED_OTHER, &param);
+        setpriority(PRIO_PROCESS, tid, default_nice);
+    }
+    if (result != 0) {
+        if (errno == EPERM || errno == EACCES) {
+            if (!warned_permission) {
+                std::cerr << "Thread priorities not permitted (needs CAP_SYS_NICE), keeping defaults." << std::endl;
+                warned_permission = true;
+            }
+        } else {
+            std::cerr << "Cannot set priority of " << role << " thread: " << strerror(errno) << std::endl;
+        }
+    }
+    if (it == rules.end()) {
+        return;
+    }
+    std::cout << "Thread " << tid << " (" << role << ")"
+              << (rule.cpu >= 0 ? " pinned to CPU " + std::to_string(rule.cpu) : std::string())
+              << std::endl;
+}
+
+// utime + stime from /proc/self/task/<tid>/stat, fields 14 and 15.
+unsigned long long ThreadPolicy::cpu_ticks(int tid) {
+    std::ifstream in("/proc/self/task/" + std::to_string(tid) + "/stat");
+    std::string stat;
+    std::getline(in, stat);
+    size_t end = stat.rfind(')');   // comm may contain spaces
+    if (end == std::string::npos) {
+        return 0;
+    }
+    std::istringstream fields(stat.substr(end + 2));
+    std::string field;
+    unsigned long long utime = 0, stime = 0;
+    for (int i = 3; i <= 15 && fields >> field; ++i) {
+        if (i == 14) utime = std::stoull(field);
+        if (i == 15) stime = std::stoull(field);
+    }
+    return utime + stime;
+}
+
+void ThreadPolicy::report() {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - last_report).count();
+    last_report = now;
+    if (seconds <= 0) {
+        return;
+    }
+    double ticks_per_second = sysconf(_SC_CLK_TCK);
+
+    std::cout << "Thread CPU usage:";
+    for (auto it = threads.begin(); it != threads.end();) {
+        if (access(("/proc/self/task/" + std::to_string(it->first)).c_str(), F_OK) != 0) {
+            it = threads.erase(it);     // thread has exited
+            continue;
+        }
+        unsigned long long ticks = cpu_ticks(it->first);
+        double percent = (ticks - it->second.last_ticks) / ticks_per_second / seconds * 100;
+        it->second.last_ticks = ticks;
+        std::cout << "  " << it->second.role << "[" << it->first << "] " << std::fixed << std::setprecision(1)
+                  << percent << "%";
+        ++it;
+    }
+    std::cout << std::endl;
+}
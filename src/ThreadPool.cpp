@@ -0,0 +1,97 @@
+#include "ThreadPool.h"
+#include "ThreadPolicy.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(std::size_t threads, const std::string& role) {
+    if (threads == 0) {
+        unsigned hardware = std::thread::hardware_concurrency();
+        threads = hardware > 1 ? hardware - 1 : 1;
+    }
+    for (std::size_t i = 0; i < threads; ++i) {
+        workers.emplace_back(&ThreadPool::run, this, role);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        tasks.clear();
+    }
+    cv.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    cv.notify_one();
+}
+
+void ThreadPool::parallel_for(std::size_t count, const std::function<void(std::size_t)>& body) {
+    struct Batch {
+        std::atomic<std::size_t> next{0};
+        std::size_t done = 0;
+        std::mutex mutex;
+        std::condition_variable cv;
+    };
+    auto batch = std::make_shared<Batch>();
+    // A helper that starts after the last index was claimed touches only the
+    // batch, never body, which may be gone by then.
+    auto work = [batch, count, &body]() {
+        std::size_t i, finished = 0;
+        while ((i = batch->next.fetch_add(1)) < count) {
+            body(i);
+            ++finished;
+        }
+        if (finished) {
+            std::lock_guard<std::mutex> lock(batch->mutex);
+            batch->done += finished;
+            if (batch->done == count) {
+                batch->cv.notify_all();
+            }
+        }
+    };
+
+    std::size_t helpers = std::min(workers.size(), count ? count - 1 : 0);
+    for (std::size_t i = 0; i < helpers; ++i) {
+        submit(work);
+    }
+    work();
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->cv.wait(lock, [&]() { return batch->done == count; });
+}
+
+void ThreadPool::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks.clear();
+}
+
+std::size_t ThreadPool::pending() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return tasks.size();
+}
+
+void ThreadPool::run(const std::string& role) {
+    ThreadPolicy::instance().adopt_current(role);
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (stopping) {
+                return;
+            }
+            task = std::move(tasks.back());
+            tasks.pop_back();
+        }
+        task();
+    }
+}
@@ -0,0 +1,158 @@
+#include "Thumbnail.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <vector>
+#include <jpeglib.h>
+
+namespace {
+
+std::string extension(const std::string& path) {
+    auto dot = path.rfind('.');
+    if (dot == std::string::npos) {
+        return "";
+    }
+    std::string ext = path.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext;
+}
+
+// libjpeg's default error handler calls exit(); jump back out instead
+struct JpegError {
+    jpeg_error_mgr base;
+    jmp_buf jump;
+};
+
+void on_jpeg_error(j_common_ptr info) {
+    longjmp(reinterpret_cast<JpegError*>(info->err)->jump, 1);
+}
+
+// Owns the file and the decompressor, however decoding ends: an error
+// longjmp, an exception from an allocation, or success
+struct JpegReader {
+    FILE* file = nullptr;
+    jpeg_decompress_struct info;
+    JpegError error;
+    bool created = false;
+
+    ~JpegReader() {
+        if (created) {
+            jpeg_destroy_decompress(&info);
+        }
+        if (file) {
+            fclose(file);
+        }
+    }
+};
+
+// Everything libjpeg can jump out of. No local here has a destructor, so the
+// longjmp skips nothing; the pixels belong to the caller.
+bool decode_jpeg(JpegReader& reader, int max_side, std::vector<uint8_t>& pixels, int& width, int& height) {
+    jpeg_decompress_struct& info = reader.info;
+    info.err = jpeg_std_error(&reader.error.base);
+    reader.error.base.error_exit = on_jpeg_error;
+    if (setjmp(reader.error.jump)) {
+        return false;
+    }
+
+    jpeg_create_decompress(&info);
+    reader.created = true;
+    jpeg_stdio_src(&info, reader.file);
+    jpeg_read_header(&info, TRUE);
+
+    // Largest power-of-two reduction that still covers max_side
+    unsigned denom = 1;
+    unsigned long longest = std::max(info.image_width, info.image_height);
+    while (denom < 8 && longest / (denom * 2) >= (unsigned long)max_side) {
+        denom *= 2;
+    }
+    info.scale_num = 1;
+    info.scale_denom = denom;
+    info.out_color_space = JCS_RGB;
+    info.dct_method = JDCT_IFAST;
+    info.do_fancy_upsampling = FALSE;
+
+    jpeg_start_decompress(&info);
+    width = info.output_width;
+    height = info.output_height;
+    size_t stride = (size_t)width * 3;
+    pixels.resize(stride * height);
+    while (info.output_scanline < info.output_height) {
+        JSAMPROW row = pixels.data() + stride * info.output_scanline;
+        jpeg_read_scanlines(&info, &row, 1);
+    }
+    jpeg_finish_decompress(&info);
+    return true;
+}
+
+// Fit an RGB image of any size into max_side, with area averaging
+void fit(const cv::Mat& rgb, int max_side, Thumbnail& out) {
+    double scale = std::min(1.0, (double)max_side / std::max(rgb.cols, rgb.rows));
+    cv::Mat small;
+    if (scale < 1.0) {
+        cv::resize(rgb, small, cv::Size(std::max(1, (int)(rgb.cols * scale)), std::max(1, (int)(rgb.rows * scale))),
+                   0, 0, cv::INTER_AREA);
+    } else {
+        small = rgb;
+    }
+    out.width = small.cols;
+    out.height = small.rows;
+    out.rgb.resize((size_t)small.cols * small.rows * 3);
+    for (int y = 0; y < small.rows; ++y) {
+        std::copy_n(small.ptr<uint8_t>(y), small.cols * 3, out.rgb.data() + (size_t)y * small.cols * 3);
+    }
+}
+
+} // namespace
+
+bool is_image_file(const std::string& path) {
+    std::string ext = extension(path);
+    return ext == "jpg" || ext == "jpeg";
+}
+
+bool is_video_file(const std::string& path) {
+    std::string ext = extension(path);
+    return ext == "mp4" || ext == "mkv" || ext == "avi";
+}
+
+bool load_thumbnail(const std::string& path, int max_side, Thumbnail& out) {
+    if (is_image_file(path)) {
+        return load_jpeg_thumbnail(path, max_side, out);
+    }
+    if (is_video_file(path)) {
+        return load_video_thumbnail(path, max_side, out);
+    }
+    return false;
+}
+
+bool load_jpeg_thumbnail(const std::string& path, int max_side, Thumbnail& out) {
+    JpegReader reader;
+    reader.file = fopen(path.c_str(), "rb");
+    if (!reader.file) {
+        return false;
+    }
+    std::vector<uint8_t> pixels;
+    int width = 0, height = 0;
+    if (!decode_jpeg(reader, max_side, pixels, width, height)) {
+        return false;
+    }
+
+    cv::Mat decoded(height, width, CV_8UC3, pixels.data());
+    fit(decoded, max_side, out);
+    return true;
+}
+
+bool load_video_thumbnail(const std::string& path, int max_side, Thumbnail& out) {
+    cv::VideoCapture video(path);
+    cv::Mat frame;
+    if (!video.isOpened() || !video.read(frame) || frame.empty()) {
+        return false;
+    }
+    cv::Mat rgb;
+    cv::cvtColor(frame, rgb, cv::COLOR_BGR2RGB);
+    fit(rgb, max_side, out);
+    return true;
+}
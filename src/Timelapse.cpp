@@ -0,0 +1,235 @@
+#include "Timelapse.h"
+
+#include <ctime>
+#include <iostream>
+
+Timelapse::Timelapse(GstElement* pipeline, GstElement* tee, GstPad* capture_pad, const TimelapseSettings& settings)
+    : pipeline(pipeline), tee(tee), capture_pad(capture_pad), settings(settings) {}
+
+Timelapse::~Timelapse() {
+    if (capture_probe) {
+        gst_pad_remove_probe(capture_pad, capture_probe);
+    }
+    if (bin) {
+        teardown();
+    }
+}
+
+GstElement* Timelapse::build_branch() {
+    char stamp[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", std::localtime(&now));
+    // A restart can come within the same second as the previous file
+    std::string name = std::string("/timelapse_") + stamp;
+    if (++files > 1) {
+        name += "_" + std::to_string(files);
+    }
+
+    GstElement *branch = gst_bin_new("timelapse");
+    GstElement *queue = gst_element_factory_make("queue", "timelapse_queue");
+    GstElement *convert = gst_element_factory_make("videoconvert", "timelapse_convert");
+    GstElement *encoder, *parse = nullptr, *mux = nullptr, *sink;
+    std::string location;
+
+    if (settings.images) {
+        encoder = gst_element_factory_make("jpegenc", "timelapse_encoder");
+        sink = gst_element_factory_make("multifilesink", "timelapse_sink");
+        location = settings.directory + name + "_%06d.jpg";
+    } else {
+        encoder = gst_element_factory_make("x264enc", "timelapse_encoder");
+        parse = gst_element_factory_make("h264parse", "timelapse_parse");
+        mux = gst_element_factory_make("mp4mux", "timelapse_mux");
+        sink = gst_element_factory_make("filesink", "timelapse_sink");
+        location = settings.directory + name + ".mp4";
+    }
+
+    if (!queue || !convert || !encoder || !sink || (!settings.images && (!parse || !mux))) {
+        std::cerr << "Failed to create timelapse elements." << std::endl;
+        for (GstElement *e : {queue, convert, encoder, parse, mux, sink}) {
+            if (e) gst_object_unref(e);
+        }
+        gst_object_unref(branch);
+        return nullptr;
+    }
+
+    g_object_set(branch, "message-forward", TRUE, nullptr);
+    // Frames arrive seconds apart; the queue only decouples the encoder from
+    // the capture thread and must never block it.
+    g_object_set(queue, "leaky", 2, "max-size-buffers", 2, "max-size-bytes", 0, "max-size-time", (guint64)0, nullptr);
+    g_object_set(sink, "location", location.c_str(), nullptr);
+
+    if (settings.images) {
+        g_object_set(encoder, "quality", 90, nullptr);
+        gst_bin_add_many(GST_BIN(branch), queue, convert, encoder, sink, nullptr);
+    } else {
+        // Constant quality: the rate control would otherwise budget bits for
+        // the camera's frame rate, not the playback rate.
+        g_object_set(encoder, "tune", 4, "speed-preset", 3, "pass", 5, "quantizer", 21,
+                     "key-int-max", settings.playback_fps * 2, nullptr);
+        g_object_set(mux, "fragment-duration", 1000, nullptr);
+        gst_bin_add_many(GST_BIN(branch), queue, convert, encoder, parse, mux, sink, nullptr);
+    }
+
+    bool linked = settings.images ? gst_element_link_many(queue, convert, encoder, sink, nullptr)
+                                  : gst_element_link_many(queue, convert, encoder, parse, mux, sink, nullptr);
+    if (!linked) {
+        std::cerr << "Failed to link timelapse elements." << std::endl;
+        gst_object_unref(branch);
+        return nullptr;
+    }
+
+    GstPad *pad = gst_element_get_static_pad(queue, "sink");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, &Timelapse::on_branch_buffer, this, nullptr);
+    gst_element_add_pad(branch, gst_ghost_pad_new("sink", pad));
+    gst_object_unref(pad);
+
+    std::cout << "Timelapse: one frame every " << settings.interval_seconds << " s to " << location << std::endl;
+    return branch;
+}
+
+bool Timelapse::start() {
+    if (bin) {
+        return true;
+    }
+    if (g_mkdir_with_parents(settings.directory.c_str(), 0755) != 0) {
+        std::cerr << "Cannot create timelapse directory " << settings.directory << std::endl;
+        return false;
+    }
+    if (!attach_branch()) {
+        return false;
+    }
+
+    // Added last, after the metrics, integrity and watchdog probes, so those
+    // still see every frame the camera delivers.
+    capture_probe = gst_pad_add_probe(capture_pad, GST_PAD_PROBE_TYPE_BUFFER, &Timelapse::on_capture_buffer, this, nullptr);
+    return true;
+}
+
+bool Timelapse::attach_branch() {
+    bin = build_branch();
+    if (!bin) {
+        return false;
+    }
+    written = 0; // the branch isn't streaming yet
+    gst_bin_add(GST_BIN(pipeline), bin);
+    gst_element_sync_state_with_parent(bin);
+
+#if GST_CHECK_VERSION(1, 20, 0)
+    tee_pad = gst_element_request_pad_simple(tee, "src_%u");
+#else
+    tee_pad = gst_element_get_request_pad(tee, "src_%u");
+#endif
+    GstPad *sink_pad = gst_element_get_static_pad(bin, "sink");
+    GstPadLinkReturn linked = gst_pad_link(tee_pad, sink_pad);
+    gst_object_unref(sink_pad);
+    if (linked != GST_PAD_LINK_OK) {
+        std::cerr << "Failed to attach timelapse branch." << std::endl;
+        teardown();
+        return false;
+    }
+    return true;
+}
+
+GstPadProbeReturn Timelapse::on_capture_buffer(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    auto self = static_cast<Timelapse*>(user_data);
+    int64_t now = g_get_monotonic_time();
+    if (now < self->next_due_us) {
+        self->dropped++;
+        return GST_PAD_PROBE_DROP;
+    }
+    // After a stall, restart the schedule rather than catching up in a burst
+    int64_t interval = (int64_t)self->settings.interval_seconds * G_USEC_PER_SEC;
+    self->next_due_us = self->next_due_us + interval > now ? self->next_due_us + interval : now + interval;
+    self->kept++;
+    return GST_PAD_PROBE_OK;
+}
+
+// The display still wants real timestamps, so the video's are only rewritten
+// inside the branch: frame n plays at n / playback_fps.
+GstPadProbeReturn Timelapse::on_branch_buffer(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    auto self = static_cast<Timelapse*>(user_data);
+    if (self->settings.images) {
+        return GST_PAD_PROBE_OK;
+    }
+    // Shared with the other tee branches; this copies the metadata, not the pixels
+    GstBuffer *buffer = gst_buffer_make_writable(GST_PAD_PROBE_INFO_BUFFER(info));
+    GstClockTime duration = gst_util_uint64_scale_int(GST_SECOND, 1, self->settings.playback_fps);
+    GST_BUFFER_PTS(buffer) = self->written * duration;
+    GST_BUFFER_DTS(buffer) = GST_CLOCK_TIME_NONE;
+    GST_BUFFER_DURATION(buffer) = duration;
+    GST_PAD_PROBE_INFO_DATA(info) = buffer;
+    self->written++;
+    return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn Timelapse::on_tee_pad_idle(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    auto self = static_cast<Timelapse*>(user_data);
+    GstPad *sink_pad = gst_element_get_static_pad(self->bin, "sink");
+    gst_pad_unlink(pad, sink_pad);
+    gst_pad_send_event(sink_pad, gst_event_new_eos());
+    gst_object_unref(sink_pad);
+    return GST_PAD_PROBE_REMOVE;
+}
+
+void Timelapse::stop_blocking(GstClockTime timeout) {
+    if (capture_probe) {
+        gst_pad_remove_probe(capture_pad, capture_probe);
+        capture_probe = 0;
+    }
+    finish_file(timeout);
+}
+
+// The capture probe stays, so frames keep being dropped on schedule and it
+// keeps its place ahead of the flat-field probe.
+bool Timelapse::next_file() {
+    if (!capture_probe || bin) {
+        return bin != nullptr; // stopped, or the file was never closed
+    }
+    return attach_branch();
+}
+
+void Timelapse::finish_file(GstClockTime timeout) {
+    if (!bin) {
+        return;
+    }
+    gst_pad_add_probe(tee_pad, GST_PAD_PROBE_TYPE_IDLE, &Timelapse::on_tee_pad_idle, this, nullptr);
+
+    // Wait for the branch's EOS, forwarded by the bin, so the MP4 is complete
+    GstBus *bus = gst_element_get_bus(pipeline);
+    for (;;) {
+        GstMessage *message = gst_bus_timed_pop_filtered(bus, timeout, GST_MESSAGE_ELEMENT);
+        if (!message) {
+            std::cerr << "Timed out finalising timelapse, the file is left fragmented." << std::endl;
+            break;
+        }
+        bool done = false;
+        const GstStructure *s = gst_message_get_structure(message);
+        if (GST_MESSAGE_SRC(message) == GST_OBJECT(bin) && gst_structure_has_name(s, "GstBinForwarded")) {
+            GstMessage *forwarded = nullptr;
+            gst_structure_get(s, "message", GST_TYPE_MESSAGE, &forwarded, nullptr);
+            done = forwarded && GST_MESSAGE_TYPE(forwarded) == GST_MESSAGE_EOS;
+            if (forwarded) {
+                gst_message_unref(forwarded);
+            }
+        }
+        gst_message_unref(message);
+        if (done) {
+            break;
+        }
+    }
+    gst_object_unref(bus);
+    teardown();
+}
+
+void Timelapse::teardown() {
+    if (tee_pad) {
+        gst_element_release_request_pad(tee, tee_pad);
+        gst_object_unref(tee_pad);
+        tee_pad = nullptr;
+    }
+    gst_element_set_state(bin, GST_STATE_NULL);
+    gst_bin_remove(GST_BIN(pipeline), bin);
+    bin = nullptr;
+    std::cout << "Timelapse stopped: " << kept.load() << " frames kept, " << dropped.load()
+              << " dropped at the source." << std::endl;
+}
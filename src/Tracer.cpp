@@ -0,0 +1,129 @@
+#include "Tracer.h"
+
+#include <fstream>
+#include <iostream>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+Tracer& Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+Tracer::Tracer() : origin(std::chrono::steady_clock::now()) {}
+
+void Tracer::enable(const std::string& output_path) {
+    path = output_path;
+    active = true;
+    std::cout << "Tracing enabled, timeline will be written to " << path << std::endl;
+}
+
+const char* Tracer::intern(const std::string& text) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return strings.insert(text).first->c_str();
+}
+
+// Offset by one so a zero timestamp can mean "not recording" in TraceSpan.
+uint64_t Tracer::now_us() const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - origin).count() + 1;
+}
+
+Tracer::ThreadRing* Tracer::ring() {
+    thread_local ThreadRing* local = nullptr;
+    if (!local) {
+        auto fresh = std::make_unique<ThreadRing>();
+        fresh->tid = static_cast<int>(syscall(SYS_gettid));
+        char name[16] = {0};
+        pthread_getname_np(pthread_self(), name, sizeof(name));
+        fresh->name = name;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        local = fresh.get();
+        rings.push_back(std::move(fresh));
+    }
+    return local;
+}
+
+// Single writer per ring: the oldest events are overwritten once it wraps.
+void Tracer::push(const Event& event) {
+    ThreadRing* r = ring();
+    uint64_t head = r->head.load(std::memory_order_relaxed);
+    r->events[head % ring_size] = event;
+    r->head.store(head + 1, std::memory_order_release);
+}
+
+void Tracer::complete(const char* category, const char* name, uint64_t begin_us, uint64_t end_us) {
+    if (!enabled()) {
+        return;
+    }
+    push({category, name, begin_us, end_us - begin_us, 'X'});
+}
+
+void Tracer::instant(const char* category, const char* name) {
+    if (!enabled()) {
+        return;
+    }
+    push({category, name, now_us(), 0, 'i'});
+}
+
+static void write_json_string(std::ostream& out, const char* text) {
+    out << '"';
+    for (const char* c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            out << '\\';
+        }
+        out << *c;
+    }
+    out << '"';
+}
+
+// Meant to be called at shutdown, once the streaming threads have stopped.
+bool Tracer::dump() {
+    if (!enabled()) {
+        return false;
+    }
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Failed to write trace to " << path << std::endl;
+        return false;
+    }
+
+    int pid = static_cast<int>(getpid());
+    size_t count = 0;
+    bool first = true;
+    out << "{\"traceEvents\":[\n";
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& r : rings) {
+        if (!first) out << ",\n";
+        first = false;
+        out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid << ",\"tid\":" << r->tid
+            << ",\"args\":{\"name\":";
+        write_json_string(out, r->name.empty() ? "thread" : r->name.c_str());
+        out << "}}";
+
+        uint64_t head = r->head.load(std::memory_order_acquire);
+        uint64_t begin = head > ring_size ? head - ring_size : 0;
+        for (uint64_t i = begin; i < head; ++i) {
+            const Event& e = r->events[i % ring_size];
+            out << ",\n{\"ph\":\"" << e.phase << "\",\"cat\":";
+            write_json_string(out, e.category);
+            out << ",\"name\":";
+            write_json_string(out, e.name);
+            out << ",\"pid\":" << pid << ",\"tid\":" << r->tid << ",\"ts\":" << e.ts_us;
+            if (e.phase == 'X') {
+                out << ",\"dur\":" << e.dur_us;
+            } else {
+                out << ",\"s\":\"t\"";
+            }
+            out << "}";
+            count++;
+        }
+    }
+    out << "\n]}\n";
+
+    std::cout << "Wrote " << count << " trace events to " << path << std::endl;
+    return true;
+}
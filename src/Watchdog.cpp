@@ -0,0 +1,130 @@
+#include "Watchdog.h"
+#include "Tracer.h"
+
+#include <algorithm>
+#include <iostream>
+
+PipelineWatchdog::PipelineWatchdog(GstElement* pipeline, CameraSource& source, int stall_ms)
+    : pipeline(pipeline), source(source), stall_ms(stall_ms) {
+    probe_id = gst_pad_add_probe(source.src_pad(), GST_PAD_PROBE_TYPE_BUFFER, &PipelineWatchdog::on_buffer,
+                                 this, nullptr);
+    eos_probe_id = gst_pad_add_probe(source.src_pad(), GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+                                     &PipelineWatchdog::on_source_eos, this, nullptr);
+    armed_since_ms = now_ms();
+    check_id = g_timeout_add(check_interval_ms, &PipelineWatchdog::on_check, this);
+}
+
+PipelineWatchdog::~PipelineWatchdog() {
+    gst_pad_remove_probe(source.src_pad(), probe_id);
+    gst_pad_remove_probe(source.src_pad(), eos_probe_id);
+    if (check_id) {
+        g_source_remove(check_id);
+    }
+    if (retry_id) {
+        g_source_remove(retry_id);
+    }
+}
+
+int64_t PipelineWatchdog::now_ms() {
+    return g_get_monotonic_time() / 1000;
+}
+
+GstPadProbeReturn PipelineWatchdog::on_buffer(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    static_cast<PipelineWatchdog*>(user_data)->last_buffer_ms.store(now_ms(), std::memory_order_relaxed);
+    return GST_PAD_PROBE_OK;
+}
+
+// Nothing else ends the stream at the source, so an EOS here is always the
+// device giving up. The stall check notices the silence and rebuilds it.
+GstPadProbeReturn PipelineWatchdog::on_source_eos(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) != GST_EVENT_EOS) {
+        return GST_PAD_PROBE_OK;
+    }
+    std::cout << "Watchdog: capture source ended, keeping the branches open for the rebuild." << std::endl;
+    Tracer::instance().instant("watchdog", "source_eos");
+    return GST_PAD_PROBE_DROP;
+}
+
+gboolean PipelineWatchdog::on_check(gpointer user_data) {
+    static_cast<PipelineWatchdog*>(user_data)->check();
+    return G_SOURCE_CONTINUE;
+}
+
+gboolean PipelineWatchdog::on_retry(gpointer user_data) {
+    auto self = static_cast<PipelineWatchdog*>(user_data);
+    self->retry_id = 0;
+    self->retry();
+    return G_SOURCE_REMOVE;
+}
+
+void PipelineWatchdog::check() {
+    // Paused or restarting on purpose: nothing is expected to flow
+    GstState state = GST_STATE_NULL;
+    gst_element_get_state(pipeline, &state, nullptr, 0);
+    if (state != GST_STATE_PLAYING) {
+        armed_since_ms = now_ms();
+        return;
+    }
+
+    int64_t now = now_ms();
+    int64_t last = std::max(last_buffer_ms.load(std::memory_order_relaxed), armed_since_ms);
+
+    if (fault_ms) {
+        // Recovered once a buffer arrives after the rebuild
+        if (last_buffer_ms > fault_ms && !retry_id) {
+            double took = double(now - fault_ms);
+            last_recovery_ms = took;
+            recoveries++;
+            std::cout << "Watchdog: capture recovered in " << took << " ms after " << attempts
+                      << " attempt(s)." << std::endl;
+            Tracer::instance().instant("watchdog", "recovered");
+            fault_ms = 0;
+            attempts = 0;
+            backoff_ms = initial_backoff_ms;
+        } else if (!retry_id && now - last > stall_ms) {
+            fault("still no buffers after restart");
+        }
+        return;
+    }
+
+    if (now - last > stall_ms) {
+        fault("no buffers");
+    }
+}
+
+void PipelineWatchdog::fault(const char* reason) {
+    if (retry_id) {
+        return;     // a rebuild is already scheduled
+    }
+    int64_t now = now_ms();
+    if (!fault_ms) {
+        fault_ms = now;
+    }
+    std::cout << "Watchdog: " << reason << ", rebuilding capture source in " << backoff_ms << " ms." << std::endl;
+    Tracer::instance().instant("watchdog", "fault");
+    retry_id = g_timeout_add(backoff_ms, &PipelineWatchdog::on_retry, this);
+    backoff_ms = std::min(backoff_ms * 2, max_backoff_ms);
+}
+
+void PipelineWatchdog::retry() {
+    TraceSpan span("watchdog", "rebuild_source");
+    attempts++;
+    armed_since_ms = now_ms();
+    if (!source.rebuild()) {
+        fault("rebuild failed");
+    }
+}
+
+bool PipelineWatchdog::handle_message(GstMessage* message) {
+    if (GST_MESSAGE_TYPE(message) != GST_MESSAGE_ERROR || !source.owns(GST_MESSAGE_SRC(message))) {
+        return false;
+    }
+    GError *error = nullptr;
+    gst_message_parse_error(message, &error, nullptr);
+    std::cerr << "Capture error: " << (error ? error->message : "unknown") << std::endl;
+    if (error) {
+        g_error_free(error);
+    }
+    fault("source error");
+    return true;
+}
@@ -1,12 +1,45 @@
 
 
+#include "Config.h"
+#include "HeadlessStation.h"
+#include "StartupProfiler.h"
+#ifndef MIVO_HEADLESS_ONLY
 #include "MainWindow.h"
+#endif
 // #include "KeyPad.h"
 
+#include <cstring>
+
 
 
 int main(int argc, char* argv[]) {
+    StartupProfiler::instance(); // start the launch clock
+    AppConfig config = AppConfig::from_env();
+
+    // --headless is ours, not GTK's; take it out before Gtk::Application sees it
+    int kept = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            config.headless = true;
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    argc = kept;
+
+#ifdef MIVO_HEADLESS_ONLY
+    config.headless = true;
+#endif
+    if (config.headless) {
+        HeadlessStation station(config);
+        return station.run();
+    }
+
+#ifndef MIVO_HEADLESS_ONLY
     auto app = Gtk::Application::create(argc, argv, "org.gtkmm.example");
     MainWindow window;
     return app->run(window);
+#else
+    return 0;
+#endif
 }